@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include <alsa/asoundlib.h>
+
+// Records interleaved 16-bit frames from an ALSA capture device, blocking until done. Used for latency calibration.
+//
+// Sets `firstFrameTime` to the monotonic time, in nanoseconds, at which the first frame was captured, as estimated
+// from the device's timestamp and delay after the first read. On failure, returns a negative error code, and sets
+// `errorMessage`. An overrun is a failure, since the frames would no longer be contiguous in time.
+int CaptureFrames(const std::string& deviceName, int64_t sampleRate, int64_t channelCount, int64_t frameCount, std::vector<int16_t>& samples, int64_t& firstFrameTime, std::string& errorMessage) {
+	snd_pcm_t* pcmHandle;
+
+	auto err = snd_pcm_open(&pcmHandle, deviceName.c_str(), SND_PCM_STREAM_CAPTURE, 0);
+
+	if (err < 0) {
+		errorMessage = "Failed to open capture device '" + deviceName + "': " + snd_strerror(err);
+
+		return err;
+	}
+
+	auto fail = [&](const char* operation, int errorCode) {
+		errorMessage = "Error " + std::to_string(errorCode) + " occurred while " + operation + ": " + snd_strerror(errorCode);
+
+		snd_pcm_close(pcmHandle);
+
+		return errorCode;
+	};
+
+	// 100ms of buffering, without resampling, so captured frames map exactly to the device's clock
+	err = snd_pcm_set_params(pcmHandle, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, static_cast<unsigned int>(channelCount), static_cast<unsigned int>(sampleRate), 0, 100 * 1000);
+
+	if (err < 0) {
+		return fail("setting capture parameters", err);
+	}
+
+	// Request timestamps. Whether they are taken from the monotonic clock depends on the driver and ALSA version,
+	// so they are checked before use.
+	{
+		snd_pcm_sw_params_t* swParams;
+		snd_pcm_sw_params_alloca(&swParams);
+
+		snd_pcm_sw_params_current(pcmHandle, swParams);
+		snd_pcm_sw_params_set_tstamp_mode(pcmHandle, swParams, SND_PCM_TSTAMP_ENABLE);
+		snd_pcm_sw_params(pcmHandle, swParams);
+	}
+
+	samples.assign(frameCount * channelCount, 0);
+
+	err = snd_pcm_start(pcmHandle);
+
+	if (err < 0) {
+		return fail("starting capture", err);
+	}
+
+	int64_t framesRead = 0;
+	firstFrameTime = -1;
+
+	while (framesRead < frameCount) {
+		auto readResult = snd_pcm_readi(pcmHandle, samples.data() + (framesRead * channelCount), frameCount - framesRead);
+
+		if (readResult < 0) {
+			return fail("capturing", int(readResult));
+		}
+
+		framesRead += readResult;
+
+		if (firstFrameTime < 0 && framesRead > 0) {
+			snd_pcm_status_t* status;
+			snd_pcm_status_alloca(&status);
+
+			err = snd_pcm_status(pcmHandle, status);
+
+			if (err < 0) {
+				return fail("reading capture status", err);
+			}
+
+			snd_htimestamp_t timestamp;
+			snd_pcm_status_get_htstamp(status, &timestamp);
+
+			auto statusTime = (int64_t(timestamp.tv_sec) * 1000000000) + timestamp.tv_nsec;
+
+			// If the driver's timestamp isn't plausibly from the monotonic clock, use the current time
+			timespec currentTimespec;
+			clock_gettime(CLOCK_MONOTONIC, &currentTimespec);
+
+			auto currentTime = (int64_t(currentTimespec.tv_sec) * 1000000000) + currentTimespec.tv_nsec;
+
+			if (statusTime <= 0 || statusTime > currentTime || currentTime - statusTime > 1000000000) {
+				statusTime = currentTime;
+			}
+
+			// At the time of the status, the frames read, and the frames captured but not yet read, were captured
+			auto capturedFrameCount = framesRead + snd_pcm_status_get_delay(status);
+
+			firstFrameTime = statusTime - ((capturedFrameCount * 1000000000) / sampleRate);
+		}
+	}
+
+	snd_pcm_close(pcmHandle);
+
+	return 0;
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <alsa/asoundlib.h>
+
+#include <string>
+
+#include "OutputBackend.h"
+#include "RealtimeGuard.h"
+#include "Utils.h"
+
+// Output backend playing through an ALSA device, by default, the `default` device.
+//
+// Every ALSA call made by the output thread leaves its realtime section: with a hardware device, ALSA only makes
+// system calls, but plugins, like those of sound servers, may allocate or lock, which is outside our control.
+class AlsaOutputBackend : public OutputBackend {
+protected:
+	snd_pcm_t* pcmHandle = nullptr;
+
+private:
+	std::string deviceName;
+
+	int64_t sampleRate = 0;
+	int64_t bufferFrameCount = 0;
+	int64_t periodFrameCount = 0;
+	bool canPause = false;
+
+public:
+	AlsaOutputBackend(const std::string& deviceName = "default") : deviceName(deviceName) {
+	}
+
+	int Open(int64_t requestedSampleRate, int64_t channelCount, int64_t writeFrameCount, std::string& errorMessage) override {
+		int err;
+
+		err = this->OpenDevice(requestedSampleRate, channelCount, writeFrameCount);
+
+		if (err < 0) {
+			errorMessage = "Failed to open audio device '" + this->deviceName + "'";
+
+			return err;
+		}
+
+		// Allocate a hardware parameters object
+		snd_pcm_hw_params_t* params;
+
+		snd_pcm_hw_params_malloc(&params);
+		snd_pcm_hw_params_any(this->pcmHandle, params);
+
+		// Set sample rate
+		auto targetSampleRate = static_cast<unsigned int>(requestedSampleRate);
+		snd_pcm_hw_params_set_rate_near(this->pcmHandle, params, &targetSampleRate, 0);
+
+		// Set channel count
+		auto targetChannelCount = static_cast<unsigned int>(channelCount);
+		snd_pcm_hw_params_set_channels(this->pcmHandle, params, targetChannelCount);
+
+		// Set format
+		snd_pcm_hw_params_set_format(this->pcmHandle, params, SND_PCM_FORMAT_S16_LE);
+
+		// Set PCM access type
+		snd_pcm_hw_params_set_access(this->pcmHandle, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+
+		// Set period time
+		{
+			unsigned int targetPeriodTime = 10 * 1000; // 10ms
+			int targetPeriodTimeDirection = 0;
+			snd_pcm_hw_params_set_period_time_near(this->pcmHandle, params, &targetPeriodTime, &targetPeriodTimeDirection);
+		}
+
+		// Write the parameters to the driver
+		err = snd_pcm_hw_params(this->pcmHandle, params);
+
+		// If failed
+		if (err < 0) {
+			errorMessage = "Error " + std::to_string(err) + " occurred while initializing ALSA output: " + snd_strerror(err);
+
+			snd_pcm_close(this->pcmHandle);
+			snd_pcm_hw_params_free(params);
+
+			return err;
+		}
+
+		trace("ALSA output initialized\n");
+
+		// Check if the device supports pausing
+		this->canPause = snd_pcm_hw_params_can_pause(params) == 1;
+
+		snd_pcm_hw_params_free(params);
+
+		// Get ALSA buffer size (frames) and period size (frames)
+		snd_pcm_uframes_t alsaBufferFrameCount;
+		snd_pcm_uframes_t alsaPeriodFrameCount;
+		err = snd_pcm_get_params(this->pcmHandle, &alsaBufferFrameCount, &alsaPeriodFrameCount);
+
+		if (err < 0) {
+			errorMessage = "Error " + std::to_string(err) + " occurred while reading ALSA parameters: " + snd_strerror(err);
+
+			snd_pcm_close(this->pcmHandle);
+
+			return err;
+		}
+
+		trace("ALSA buffer frame count: %d, ALSA period frame count: %d\n", alsaBufferFrameCount, alsaPeriodFrameCount);
+
+		this->sampleRate = targetSampleRate;
+		this->bufferFrameCount = alsaBufferFrameCount;
+		this->periodFrameCount = alsaPeriodFrameCount;
+
+		return 0;
+	}
+
+	int Close() override {
+		return snd_pcm_close(this->pcmHandle);
+	}
+
+	// Also describes ALSA specific error codes
+	const char* GetErrorDescription(int errorCode) const override {
+		return snd_strerror(errorCode);
+	}
+
+	int64_t GetSampleRate() const override {
+		return this->sampleRate;
+	}
+
+	int64_t GetBufferFrameCount() const override {
+		return this->bufferFrameCount;
+	}
+
+	int64_t GetPeriodFrameCount() const override {
+		return this->periodFrameCount;
+	}
+
+	bool CanPause() const override {
+		return this->canPause;
+	}
+
+	int GetAvailableAndDelay(int64_t& availableFrameCount, int64_t& delayFrameCount) override {
+		RealtimeSectionSuspension suspension;
+
+		snd_pcm_sframes_t available;
+		snd_pcm_sframes_t delay;
+
+		auto result = snd_pcm_avail_delay(this->pcmHandle, &available, &delay);
+
+		availableFrameCount = available;
+		delayFrameCount = delay;
+
+		return result;
+	}
+
+	int GetStatus(BackendStatus& status) override {
+		RealtimeSectionSuspension suspension;
+
+		snd_pcm_status_t* alsaStatus;
+		snd_pcm_status_alloca(&alsaStatus);
+
+		auto statusResult = snd_pcm_status(this->pcmHandle, alsaStatus);
+
+		if (statusResult < 0) {
+			return statusResult;
+		}
+
+		status.state = ConvertState(snd_pcm_status_get_state(alsaStatus));
+		status.delayFrameCount = snd_pcm_status_get_delay(alsaStatus);
+		status.availableFrameCount = snd_pcm_status_get_avail(alsaStatus);
+
+		// The driver's timestamp may or may not be taken from the monotonic clock (depends on the driver and
+		// ALSA version). The engine checks if it's plausible.
+		snd_htimestamp_t driverTimestamp;
+		snd_pcm_status_get_htstamp(alsaStatus, &driverTimestamp);
+
+		status.timestamp = (int64_t(driverTimestamp.tv_sec) * 1000000000) + driverTimestamp.tv_nsec;
+
+		return 0;
+	}
+
+	BackendState GetState() override {
+		RealtimeSectionSuspension suspension;
+
+		return ConvertState(snd_pcm_state(this->pcmHandle));
+	}
+
+	int64_t Write(const int16_t* samples, int64_t frameCount) override {
+		RealtimeSectionSuspension suspension;
+
+		return snd_pcm_writei(this->pcmHandle, samples, frameCount);
+	}
+
+	int Recover(int errorCode) override {
+		RealtimeSectionSuspension suspension;
+
+		return snd_pcm_recover(this->pcmHandle, errorCode, 1);
+	}
+
+	int Prepare() override {
+		return snd_pcm_prepare(this->pcmHandle);
+	}
+
+	int Drain() override {
+		return snd_pcm_drain(this->pcmHandle);
+	}
+
+	int Drop() override {
+		return snd_pcm_drop(this->pcmHandle);
+	}
+
+	int Pause(bool enable) override {
+		return snd_pcm_pause(this->pcmHandle, enable ? 1 : 0);
+	}
+
+	int64_t GetRewindableFrameCount() override {
+		return snd_pcm_rewindable(this->pcmHandle);
+	}
+
+	int64_t Rewind(int64_t frameCount) override {
+		return snd_pcm_rewind(this->pcmHandle, frameCount);
+	}
+
+protected:
+	// Opens the PCM, setting `pcmHandle`
+	virtual int OpenDevice(int64_t requestedSampleRate, int64_t channelCount, int64_t writeFrameCount) {
+		return snd_pcm_open(&this->pcmHandle, this->deviceName.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+	}
+
+private:
+	static BackendState ConvertState(snd_pcm_state_t state) {
+		switch (state) {
+			case SND_PCM_STATE_PREPARED:
+				return BackendState::Prepared;
+			case SND_PCM_STATE_RUNNING:
+				return BackendState::Running;
+			case SND_PCM_STATE_PAUSED:
+				return BackendState::Paused;
+			case SND_PCM_STATE_XRUN:
+				return BackendState::Xrun;
+			default:
+				return BackendState::Setup;
+		}
+	}
+};
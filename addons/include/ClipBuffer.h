@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "SampleSource.h"
+
+// A fixed buffer of interleaved samples, played from a movable read position.
+//
+// The samples are copied when the buffer is created, and never modified after. The read position is
+// only changed by the consumer (the audio thread), but can be read from any thread.
+class ClipBuffer : public SampleSource {
+private:
+	std::vector<int16_t> samples;
+	int64_t channelCount;
+	int64_t frameCount;
+
+	std::atomic<int64_t> readOffset{0};
+
+public:
+	ClipBuffer(const int16_t* samples, int64_t sampleCount, int64_t channelCount)
+		: samples(samples, samples + sampleCount), channelCount(channelCount), frameCount(sampleCount / channelCount) {
+	}
+
+	int64_t GetHeldByteCount() const override {
+		return sizeof(ClipBuffer) + (samples.capacity() * sizeof(int16_t));
+	}
+
+	// Consumer only
+	int64_t Read(int16_t* target, int64_t sampleCount) override {
+		auto currentReadOffset = readOffset.load(std::memory_order_relaxed);
+		auto samplesToCopy = std::max(std::min(sampleCount, int64_t(samples.size()) - currentReadOffset), int64_t(0));
+
+		memcpy(target, samples.data() + currentReadOffset, samplesToCopy * sizeof(int16_t));
+
+		readOffset.store(currentReadOffset + samplesToCopy, std::memory_order_release);
+
+		return samplesToCopy;
+	}
+
+	int64_t GetReadOffset() const override {
+		return readOffset.load(std::memory_order_acquire);
+	}
+
+	bool IsExhausted() const override {
+		return readOffset.load(std::memory_order_acquire) >= int64_t(samples.size());
+	}
+
+	// Consumer only. The frame index is clamped to the clip's range.
+	void SetFramePosition(int64_t frameIndex) {
+		frameIndex = std::max(std::min(frameIndex, frameCount), int64_t(0));
+
+		readOffset.store(frameIndex * channelCount, std::memory_order_release);
+	}
+
+	int64_t GetFramePosition() const {
+		return readOffset.load(std::memory_order_acquire) / channelCount;
+	}
+
+	int64_t GetFrameCount() const {
+		return frameCount;
+	}
+};
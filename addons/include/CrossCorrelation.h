@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+#include <complex>
+#include <vector>
+
+// In-place iterative radix-2 FFT. The size must be a power of 2.
+void ComputeFft(std::vector<std::complex<double>>& values, bool inverse) {
+	auto size = values.size();
+
+	// Bit reversal permutation
+	for (size_t i = 1, j = 0; i < size; i++) {
+		auto bit = size >> 1;
+
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+
+		j ^= bit;
+
+		if (i < j) {
+			std::swap(values[i], values[j]);
+		}
+	}
+
+	for (size_t length = 2; length <= size; length <<= 1) {
+		auto angle = (2 * M_PI / double(length)) * (inverse ? 1 : -1);
+		std::complex<double> rootStep(cos(angle), sin(angle));
+
+		for (size_t start = 0; start < size; start += length) {
+			std::complex<double> root(1, 0);
+
+			for (size_t k = 0; k < length / 2; k++) {
+				auto even = values[start + k];
+				auto odd = values[start + k + (length / 2)] * root;
+
+				values[start + k] = even + odd;
+				values[start + k + (length / 2)] = even - odd;
+
+				root *= rootStep;
+			}
+		}
+	}
+
+	if (inverse) {
+		for (auto& value : values) {
+			value /= double(size);
+		}
+	}
+}
+
+// Computes the cross-correlation of a signal with a shorter reference, for every offset at which the reference
+// fits entirely within the signal: result[k] = sum(signal[k + i] * reference[i]).
+void CrossCorrelate(const int16_t* signal, int64_t signalLength, const int16_t* reference, int64_t referenceLength, std::vector<double>& result) {
+	if (referenceLength <= 0 || referenceLength > signalLength) {
+		result.clear();
+
+		return;
+	}
+
+	size_t fftSize = 1;
+
+	while (fftSize < size_t(signalLength + referenceLength)) {
+		fftSize <<= 1;
+	}
+
+	std::vector<std::complex<double>> signalSpectrum(fftSize);
+	std::vector<std::complex<double>> referenceSpectrum(fftSize);
+
+	for (int64_t i = 0; i < signalLength; i++) {
+		signalSpectrum[i] = double(signal[i]);
+	}
+
+	for (int64_t i = 0; i < referenceLength; i++) {
+		referenceSpectrum[i] = double(reference[i]);
+	}
+
+	ComputeFft(signalSpectrum, false);
+	ComputeFft(referenceSpectrum, false);
+
+	for (size_t i = 0; i < fftSize; i++) {
+		signalSpectrum[i] *= std::conj(referenceSpectrum[i]);
+	}
+
+	ComputeFft(signalSpectrum, true);
+
+	result.resize(signalLength - referenceLength + 1);
+
+	for (size_t k = 0; k < result.size(); k++) {
+		result[k] = signalSpectrum[k].real();
+	}
+}
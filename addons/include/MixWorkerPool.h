@@ -0,0 +1,200 @@
+#pragma once
+
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Processes an item, as one of the participants of a run. Participant 0 is the thread calling `Run`.
+typedef void (*MixWorkFunction)(void* context, int64_t participantIndex, int64_t itemIndex);
+
+// A fixed pool of threads, which process the items of a run together with the thread calling `Run`, like the
+// sources of a mix, once per period.
+//
+// The items are split into a contiguous range per participant. Each participant claims items from its own range,
+// then steals the remaining items of the others', by atomically advancing the range's cursor. Participants are
+// started by incrementing a per-thread signal, and the caller waits for a countdown of the participants still
+// working, so a run never locks or allocates. Waiting threads spin briefly, then sleep on a futex.
+class MixWorkerPool {
+private:
+	// Items still unclaimed in a participant's range. Padded to a cache line, since it's written by every claim.
+	struct alignas(64) Range {
+		std::atomic<int64_t> next { 0 };
+		int64_t end = 0;
+	};
+
+	// Incremented to start a worker thread, which waits on it
+	struct alignas(64) Signal {
+		std::atomic<int32_t> value { 0 };
+	};
+
+	int64_t threadCount; // Worker threads, not including the caller
+	std::vector<std::thread> threads;
+
+	std::unique_ptr<Range[]> ranges;
+	std::unique_ptr<Signal[]> signals;
+
+	// Set by the caller before starting the workers, which read them after being signaled
+	int64_t participantCount = 1;
+	MixWorkFunction function = nullptr;
+	void* context = nullptr;
+
+	alignas(64) std::atomic<int32_t> remainingWorkerCount { 0 };
+	std::atomic<bool> stopRequested { false };
+
+	// Number of checks of a signal, or of the countdown, before sleeping
+	static const int spinCount = 4000;
+
+public:
+	// Creates `threadCount` worker threads
+	MixWorkerPool(int64_t threadCount)
+		: threadCount(threadCount), ranges(new Range[threadCount + 1]), signals(new Signal[threadCount + 1]) {
+
+		for (int64_t workerIndex = 1; workerIndex <= threadCount; workerIndex++) {
+			this->threads.emplace_back([this, workerIndex]() { this->WorkerLoop(workerIndex); });
+		}
+	}
+
+	~MixWorkerPool() {
+		this->stopRequested.store(true, std::memory_order_release);
+
+		for (int64_t workerIndex = 1; workerIndex <= this->threadCount; workerIndex++) {
+			this->signals[workerIndex].value.fetch_add(1, std::memory_order_release);
+
+			WakeFutex(&this->signals[workerIndex].value);
+		}
+
+		for (auto& thread : this->threads) {
+			thread.join();
+		}
+	}
+
+	// Maximum number of participants in a run, including the caller
+	int64_t GetMaxParticipantCount() const {
+		return this->threadCount + 1;
+	}
+
+	// Calls `function` for each of `itemCount` items, from the calling thread and `participantCount - 1` worker
+	// threads, and returns once all items were processed. With a single participant, no thread is woken.
+	void Run(int64_t participantCount, int64_t itemCount, MixWorkFunction function, void* context) {
+		participantCount = std::min(std::max(participantCount, int64_t(1)), this->threadCount + 1);
+
+		this->participantCount = participantCount;
+		this->function = function;
+		this->context = context;
+
+		for (int64_t participantIndex = 0; participantIndex < participantCount; participantIndex++) {
+			auto& range = this->ranges[participantIndex];
+
+			range.next.store((itemCount * participantIndex) / participantCount, std::memory_order_relaxed);
+			range.end = (itemCount * (participantIndex + 1)) / participantCount;
+		}
+
+		this->remainingWorkerCount.store(int32_t(participantCount - 1), std::memory_order_relaxed);
+
+		for (int64_t workerIndex = 1; workerIndex < participantCount; workerIndex++) {
+			this->signals[workerIndex].value.fetch_add(1, std::memory_order_release);
+
+			WakeFutex(&this->signals[workerIndex].value);
+		}
+
+		this->ProcessItems(0);
+
+		// Wait for the workers still processing their last item
+		int32_t remainingWorkerCount;
+
+		for (int spin = 0; (remainingWorkerCount = this->remainingWorkerCount.load(std::memory_order_acquire)) > 0; spin++) {
+			if (spin < spinCount) {
+				Pause();
+			} else {
+				WaitFutex(&this->remainingWorkerCount, remainingWorkerCount);
+			}
+		}
+	}
+
+private:
+	void WorkerLoop(int64_t workerIndex) {
+		auto& signal = this->signals[workerIndex].value;
+
+		// Signals start at 0. The initial value isn't read here, since a run, or the destructor, may have already
+		// incremented it before the thread started.
+		int32_t lastSignal = 0;
+
+		while (true) {
+			// Wait for the next run
+			int32_t currentSignal;
+
+			for (int spin = 0; (currentSignal = signal.load(std::memory_order_acquire)) == lastSignal; spin++) {
+				if (spin < spinCount) {
+					Pause();
+				} else {
+					WaitFutex(&signal, lastSignal);
+				}
+			}
+
+			lastSignal = currentSignal;
+
+			if (this->stopRequested.load(std::memory_order_acquire)) {
+				return;
+			}
+
+			this->ProcessItems(workerIndex);
+
+			// The last worker to finish wakes the caller, in case it's sleeping
+			if (this->remainingWorkerCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				WakeFutex(&this->remainingWorkerCount);
+			}
+		}
+	}
+
+	// Processes the items of the participant's own range, then steals from the other ranges
+	void ProcessItems(int64_t participantIndex) {
+		auto participantCount = this->participantCount;
+
+		for (int64_t offset = 0; offset < participantCount; offset++) {
+			auto& range = this->ranges[(participantIndex + offset) % participantCount];
+
+			while (true) {
+				// Skip the atomic increment once the range is known to be exhausted
+				if (range.next.load(std::memory_order_relaxed) >= range.end) {
+					break;
+				}
+
+				auto itemIndex = range.next.fetch_add(1, std::memory_order_relaxed);
+
+				if (itemIndex >= range.end) {
+					break;
+				}
+
+				this->function(this->context, participantIndex, itemIndex);
+			}
+		}
+	}
+
+	static void Pause() {
+#if defined(__x86_64__) || defined(_M_X64)
+		_mm_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+
+	static void WaitFutex(std::atomic<int32_t>* address, int32_t expectedValue) {
+		syscall(SYS_futex, reinterpret_cast<int32_t*>(address), FUTEX_WAIT_PRIVATE, expectedValue, nullptr, nullptr, 0);
+	}
+
+	static void WakeFutex(std::atomic<int32_t>* address) {
+		syscall(SYS_futex, reinterpret_cast<int32_t*>(address), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+	}
+};
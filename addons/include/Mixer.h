@@ -0,0 +1,527 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "SampleSource.h"
+#include "StreamBuffer.h"
+#include "SampleKernels.h"
+#include "MixWorkerPool.h"
+
+const int64_t maxMixerChannelCount = 8;
+
+// Number of steps a gain change is ramped over, within a single mix
+const int64_t mixerGainRampStepCount = 8;
+
+// Minimum number of active sources per mixing thread. With fewer sources, fewer threads take part in a mix,
+// down to the output thread alone, since waking a thread costs more than mixing a few sources.
+const int64_t minSourcesPerMixThread = 16;
+
+// State of a mixer source slot.
+//
+// Only the JavaScript thread activates a free slot, and frees a finished one. Only the audio thread finishes an
+// active slot, once its source is exhausted, or its removal was requested.
+enum class MixerSlotState : int {
+	Free = 0,
+	Active = 1,
+	Finished = 2,
+};
+
+struct MixerSlot {
+	std::atomic<int> state { int(MixerSlotState::Free) };
+	std::atomic<bool> removeRequested { false };
+
+	// Incremented every time the slot is freed, so identifiers of sources that were removed aren't reused
+	uint32_t generation = 0;
+
+	// Set by the JavaScript thread before the slot is activated
+	SampleSource* source = nullptr;
+	StreamBuffer* streamBuffer = nullptr; // Only set for stream sources
+	int64_t channelCount = 0;
+	double step = 1.0; // Source frames per output frame
+	std::vector<int16_t> inputFrames; // Preallocated for the largest mix
+
+	// Set by the JavaScript thread at any time
+	std::atomic<float> gain { 1.0f };
+	std::atomic<float> pan { 0.0f };
+	std::atomic<int32_t> priority { 0 };
+
+	// Audio thread only
+	float channelGains[maxMixerChannelCount];
+	float duckingLevel = 0.0f; // Current attenuation by ducking, in decibels (0 or negative)
+	int64_t inputFrameCount = 0; // Frames in `inputFrames` not consumed yet
+	double position = 0.0; // Position of the next output frame, in frames of `inputFrames`
+	bool isEnding = false;
+
+	std::atomic<int64_t> mixedFrameCount { 0 };
+};
+
+// A sample source mixing many sources, each with its own gain, pan and sample rate, into the frames of a single
+// output. Sources are added and removed by the JavaScript thread, without locking, through a fixed number of slots.
+//
+// While a source is playing, sources of lower priority are ducked: attenuated by the ducking depth, reached
+// linearly in decibels over the attack time, and recovered over the release time once no higher priority source
+// is playing. The attenuation is updated once per mix, and ramped within it, like gain changes.
+//
+// Frames are accumulated in floating point, and saturated when converted to 16 bits. Sources whose sample rate
+// differs from the output's are resampled by linear interpolation.
+//
+// With more than one thread, sources are mixed in parallel by a worker pool, each thread into its own
+// accumulator, and the partial mixes are then summed by the output thread.
+class Mixer : public SampleSource {
+private:
+	int64_t channelCount;
+	int64_t sampleRate;
+	int64_t maxFrameCount;
+
+	int64_t slotCount;
+	std::unique_ptr<MixerSlot[]> slots;
+
+	// Buffers of a thread taking part in a mix
+	struct ThreadBuffers {
+		std::vector<float> accumulator;
+		std::vector<float> resampledFrames;
+	};
+
+	// Audio thread and mix workers only. Buffers are indexed by participant, with the output thread first.
+	std::vector<ThreadBuffers> threadBuffers;
+	std::unique_ptr<MixWorkerPool> workerPool; // Only created with more than one thread
+	int64_t mixFrameCount = 0; // Frame count of the current mix, set before workers are started
+	int32_t mixMaxPriority = 0; // Highest priority of the sources playing in the current mix
+
+	// Ducking parameters. Times are in milliseconds, and the depth in decibels (0 or negative).
+	std::atomic<float> duckingAttack { 20.0f };
+	std::atomic<float> duckingRelease { 300.0f };
+	std::atomic<float> duckingDepth { -12.0f };
+
+	std::atomic<int64_t> readOffset { 0 };
+	std::atomic<int64_t> activeSourceCount { 0 };
+	std::atomic<bool> hasFinishedSources { false };
+
+public:
+	// `threadCount` is the maximum number of threads mixing, including the output thread. It's limited to the
+	// number of cores, since a mix waits for all of its threads.
+	Mixer(int64_t channelCount, int64_t sampleRate, int64_t maxFrameCount, int64_t slotCount, int64_t threadCount = 1)
+		: channelCount(channelCount), sampleRate(sampleRate), maxFrameCount(maxFrameCount), slotCount(slotCount), slots(new MixerSlot[slotCount]) {
+
+		threadCount = std::min(threadCount, std::max(int64_t(std::thread::hardware_concurrency()), int64_t(1)));
+
+		this->threadBuffers.resize(std::max(threadCount, int64_t(1)));
+
+		for (auto& buffers : this->threadBuffers) {
+			buffers.accumulator.resize(maxFrameCount * channelCount);
+			buffers.resampledFrames.resize(maxFrameCount * channelCount);
+		}
+
+		if (threadCount > 1) {
+			this->workerPool.reset(new MixWorkerPool(threadCount - 1));
+		}
+	}
+
+	~Mixer() {
+		// Join the workers first
+		this->workerPool.reset();
+
+		for (int64_t i = 0; i < this->slotCount; i++) {
+			delete this->slots[i].source;
+		}
+	}
+
+	// JavaScript thread only.
+	//
+	// Adds a source, taking ownership of it, and returns its identifier, or -1 if all slots are taken. For stream
+	// sources, `streamBuffer` is the same object as `source`.
+	int64_t AddSource(SampleSource* source, StreamBuffer* streamBuffer, int64_t sourceChannelCount, int64_t sourceSampleRate, float gain, float pan, int32_t priority = 0) {
+		for (int64_t slotIndex = 0; slotIndex < this->slotCount; slotIndex++) {
+			auto& slot = this->slots[slotIndex];
+
+			if (slot.state.load(std::memory_order_acquire) != int(MixerSlotState::Free)) {
+				continue;
+			}
+
+			slot.source = source;
+			slot.streamBuffer = streamBuffer;
+			slot.channelCount = sourceChannelCount;
+			slot.step = double(sourceSampleRate) / double(this->sampleRate);
+
+			// Resampling reads up to two frames beyond the mixed ones, and may carry one over from the previous mix
+			auto maxInputFrameCount = int64_t(ceil(double(this->maxFrameCount) * slot.step)) + 3;
+
+			slot.inputFrames.assign(maxInputFrameCount * sourceChannelCount, 0);
+			slot.inputFrameCount = 0;
+			slot.position = 0.0;
+			slot.isEnding = false;
+
+			slot.gain.store(gain, std::memory_order_relaxed);
+			slot.pan.store(pan, std::memory_order_relaxed);
+			slot.priority.store(priority, std::memory_order_relaxed);
+			slot.duckingLevel = 0.0f;
+			this->GetTargetGains(slot, slot.channelGains);
+
+			slot.mixedFrameCount.store(0, std::memory_order_relaxed);
+			slot.removeRequested.store(false, std::memory_order_relaxed);
+
+			this->activeSourceCount++;
+
+			slot.state.store(int(MixerSlotState::Active), std::memory_order_release);
+
+			return this->GetSourceId(slotIndex);
+		}
+
+		return -1;
+	}
+
+	// JavaScript thread only. Returns the slot of an active or finished source, or nullptr if it was freed.
+	MixerSlot* GetSlot(int64_t sourceId) {
+		if (sourceId < 0) {
+			return nullptr;
+		}
+
+		auto slotIndex = sourceId % this->slotCount;
+		auto& slot = this->slots[slotIndex];
+
+		if (slot.state.load(std::memory_order_acquire) == int(MixerSlotState::Free) || this->GetSourceId(slotIndex) != sourceId) {
+			return nullptr;
+		}
+
+		return &slot;
+	}
+
+	// Sets the ducking parameters, taking effect from the next mix
+	void SetDucking(float attack, float release, float depth) {
+		this->duckingAttack.store(std::max(attack, 0.0f), std::memory_order_relaxed);
+		this->duckingRelease.store(std::max(release, 0.0f), std::memory_order_relaxed);
+		this->duckingDepth.store(std::min(depth, 0.0f), std::memory_order_relaxed);
+	}
+
+	// JavaScript thread only. The source is faded out over the next mix, then finished.
+	void RequestRemove(int64_t sourceId) {
+		auto slot = this->GetSlot(sourceId);
+
+		if (slot != nullptr) {
+			slot->removeRequested.store(true, std::memory_order_release);
+		}
+	}
+
+	// JavaScript thread only.
+	//
+	// Frees the sources that have finished since the last call, and appends their identifiers to `finishedSourceIds`.
+	void CollectFinishedSources(std::vector<int64_t>& finishedSourceIds) {
+		for (int64_t slotIndex = 0; slotIndex < this->slotCount; slotIndex++) {
+			auto& slot = this->slots[slotIndex];
+
+			if (slot.state.load(std::memory_order_acquire) != int(MixerSlotState::Finished)) {
+				continue;
+			}
+
+			finishedSourceIds.push_back(this->GetSourceId(slotIndex));
+
+			delete slot.source;
+
+			slot.source = nullptr;
+			slot.streamBuffer = nullptr;
+			slot.generation++;
+
+			this->activeSourceCount--;
+
+			slot.state.store(int(MixerSlotState::Free), std::memory_order_release);
+		}
+	}
+
+	// Audio thread only. Returns true, once, after any source has finished.
+	bool TakeFinishedNotification() {
+		return this->hasFinishedSources.load(std::memory_order_relaxed) && this->hasFinishedSources.exchange(false);
+	}
+
+	// Audio thread only. Mixes the active sources into `target`. Never returns fewer samples than requested.
+	int64_t Read(int16_t* target, int64_t sampleCount) override {
+		auto frameCount = std::min(sampleCount / this->channelCount, this->maxFrameCount);
+		auto mixSampleCount = frameCount * this->channelCount;
+
+		auto participantCount = int64_t(1);
+
+		if (this->workerPool) {
+			auto activeSourceCount = this->activeSourceCount.load(std::memory_order_relaxed);
+
+			participantCount = std::min(std::max(activeSourceCount / minSourcesPerMixThread, int64_t(1)), this->workerPool->GetMaxParticipantCount());
+		}
+
+		for (int64_t participantIndex = 0; participantIndex < participantCount; participantIndex++) {
+			std::fill_n(this->threadBuffers[participantIndex].accumulator.data(), mixSampleCount, 0.0f);
+		}
+
+		this->mixFrameCount = frameCount;
+		this->mixMaxPriority = this->GetMaxActivePriority();
+
+		if (participantCount > 1) {
+			this->workerPool->Run(participantCount, this->slotCount, MixSlotItem, this);
+
+			// Sum the partial mixes into the output thread's accumulator
+			for (int64_t participantIndex = 1; participantIndex < participantCount; participantIndex++) {
+				AddFloat(this->threadBuffers[participantIndex].accumulator.data(), this->threadBuffers[0].accumulator.data(), mixSampleCount);
+			}
+		} else {
+			for (int64_t slotIndex = 0; slotIndex < this->slotCount; slotIndex++) {
+				this->MixSlot(slotIndex, 0);
+			}
+		}
+
+		ConvertFloatToInt16(this->threadBuffers[0].accumulator.data(), target, mixSampleCount);
+
+		this->readOffset.fetch_add(mixSampleCount, std::memory_order_release);
+
+		return mixSampleCount;
+	}
+
+	// The mix never ends by itself
+	bool IsExhausted() const override {
+		return false;
+	}
+
+	int64_t GetReadOffset() const override {
+		return this->readOffset.load(std::memory_order_acquire);
+	}
+
+	// JavaScript thread only
+	int64_t GetHeldByteCount() const override {
+		auto byteCount = int64_t(sizeof(Mixer));
+
+		byteCount += this->slotCount * sizeof(MixerSlot);
+
+		for (auto& buffers : this->threadBuffers) {
+			byteCount += (buffers.accumulator.capacity() + buffers.resampledFrames.capacity()) * sizeof(float);
+		}
+
+		for (int64_t i = 0; i < this->slotCount; i++) {
+			auto& slot = this->slots[i];
+
+			byteCount += slot.inputFrames.capacity() * sizeof(int16_t);
+
+			if (slot.source != nullptr) {
+				byteCount += slot.source->GetHeldByteCount();
+			}
+		}
+
+		return byteCount;
+	}
+
+	int64_t GetActiveSourceCount() const {
+		return this->activeSourceCount.load(std::memory_order_relaxed);
+	}
+
+	int64_t GetSlotCount() const {
+		return this->slotCount;
+	}
+
+private:
+	int64_t GetSourceId(int64_t slotIndex) const {
+		return (int64_t(this->slots[slotIndex].generation) * this->slotCount) + slotIndex;
+	}
+
+	// Computes the gain of each output channel. A mono source is panned with equal power. A source with as many
+	// channels as the output is balanced, by attenuating the channel opposite the pan. Pan only applies to
+	// stereo outputs.
+	void GetTargetGains(const MixerSlot& slot, float* channelGains) const {
+		auto gain = slot.gain.load(std::memory_order_relaxed);
+		auto pan = std::min(std::max(slot.pan.load(std::memory_order_relaxed), -1.0f), 1.0f);
+
+		for (int64_t channelIndex = 0; channelIndex < this->channelCount; channelIndex++) {
+			channelGains[channelIndex] = gain;
+		}
+
+		if (this->channelCount != 2) {
+			return;
+		}
+
+		if (slot.channelCount == 1) {
+			auto angle = (pan + 1.0f) * float(M_PI / 4.0);
+
+			channelGains[0] = gain * cosf(angle);
+			channelGains[1] = gain * sinf(angle);
+		} else {
+			channelGains[0] = gain * std::min(1.0f - pan, 1.0f);
+			channelGains[1] = gain * std::min(1.0f + pan, 1.0f);
+		}
+	}
+
+	// Returns the highest priority of the sources that are playing, and not being removed
+	int32_t GetMaxActivePriority() const {
+		auto maxPriority = std::numeric_limits<int32_t>::min();
+
+		for (int64_t slotIndex = 0; slotIndex < this->slotCount; slotIndex++) {
+			auto& slot = this->slots[slotIndex];
+
+			if (slot.state.load(std::memory_order_acquire) == int(MixerSlotState::Active) && !slot.removeRequested.load(std::memory_order_relaxed)) {
+				maxPriority = std::max(maxPriority, slot.priority.load(std::memory_order_relaxed));
+			}
+		}
+
+		return maxPriority;
+	}
+
+	// Moves the source's ducking level towards its target for this mix, and returns it as a linear gain
+	float UpdateDucking(MixerSlot& slot, int64_t frameCount) {
+		auto depth = this->duckingDepth.load(std::memory_order_relaxed);
+		auto isDucked = slot.priority.load(std::memory_order_relaxed) < this->mixMaxPriority;
+		auto targetLevel = isDucked ? depth : 0.0f;
+
+		if (slot.duckingLevel == targetLevel) {
+			return slot.duckingLevel == 0.0f ? 1.0f : powf(10.0f, slot.duckingLevel / 20.0f);
+		}
+
+		// A full swing, from 0 to the depth, takes the attack or release time. If the depth was reduced while ducked,
+		// the swing is from the current level.
+		auto swing = std::max(-depth, std::fabs(slot.duckingLevel - targetLevel));
+		auto rampTime = slot.duckingLevel > targetLevel ? this->duckingAttack.load(std::memory_order_relaxed) : this->duckingRelease.load(std::memory_order_relaxed);
+		auto mixDuration = (float(frameCount) * 1000.0f) / float(this->sampleRate);
+		auto maxChange = rampTime > 0.0f ? (swing * mixDuration) / rampTime : std::numeric_limits<float>::infinity();
+
+		if (slot.duckingLevel > targetLevel) {
+			slot.duckingLevel = std::max(slot.duckingLevel - maxChange, targetLevel);
+		} else {
+			slot.duckingLevel = std::min(slot.duckingLevel + maxChange, targetLevel);
+		}
+
+		return powf(10.0f, slot.duckingLevel / 20.0f);
+	}
+
+	static void MixSlotItem(void* context, int64_t participantIndex, int64_t slotIndex) {
+		static_cast<Mixer*>(context)->MixSlot(slotIndex, participantIndex);
+	}
+
+	// Mixes the slot's source, if active, into the participant's accumulator, and finishes it if it has ended,
+	// or its removal was requested
+	void MixSlot(int64_t slotIndex, int64_t participantIndex) {
+		auto& slot = this->slots[slotIndex];
+
+		if (slot.state.load(std::memory_order_acquire) != int(MixerSlotState::Active)) {
+			return;
+		}
+
+		auto isRemoved = slot.removeRequested.load(std::memory_order_acquire);
+
+		this->MixSource(slot, this->mixFrameCount, isRemoved, this->threadBuffers[participantIndex]);
+
+		if (isRemoved || slot.isEnding) {
+			slot.state.store(int(MixerSlotState::Finished), std::memory_order_release);
+
+			this->hasFinishedSources.store(true, std::memory_order_release);
+		}
+	}
+
+	// Reads the source's frames for the next `frameCount` output frames, and adds them to the given accumulator.
+	// If the source is being removed, it's faded out.
+	void MixSource(MixerSlot& slot, int64_t frameCount, bool fadeOut, ThreadBuffers& buffers) {
+		auto sourceChannelCount = slot.channelCount;
+
+		// Number of source frames needed, including the one following the last, for interpolation
+		int64_t neededFrameCount;
+
+		if (slot.step == 1.0) {
+			neededFrameCount = frameCount;
+		} else {
+			neededFrameCount = int64_t(slot.position + (slot.step * double(frameCount - 1))) + 2;
+		}
+
+		if (slot.inputFrameCount < neededFrameCount) {
+			auto offset = slot.inputFrameCount * sourceChannelCount;
+			auto requestedSampleCount = (neededFrameCount - slot.inputFrameCount) * sourceChannelCount;
+
+			auto samplesRead = slot.source->Read(slot.inputFrames.data() + offset, requestedSampleCount);
+
+			// On underflow, or at the end of the source, the remainder is silent
+			std::fill_n(slot.inputFrames.data() + offset + samplesRead, requestedSampleCount - samplesRead, int16_t(0));
+
+			if (samplesRead < requestedSampleCount && slot.source->IsExhausted()) {
+				slot.isEnding = true;
+			}
+
+			slot.inputFrameCount = neededFrameCount;
+		}
+
+		float targetGains[maxMixerChannelCount];
+
+		if (fadeOut) {
+			std::fill_n(targetGains, this->channelCount, 0.0f);
+		} else {
+			this->GetTargetGains(slot, targetGains);
+
+			auto duckingGain = this->UpdateDucking(slot, frameCount);
+
+			for (int64_t channelIndex = 0; channelIndex < this->channelCount; channelIndex++) {
+				targetGains[channelIndex] *= duckingGain;
+			}
+		}
+
+		// Frames with the source's channel count, in 16-bit or float samples
+		const int16_t* int16Frames = nullptr;
+		const float* floatFrames = nullptr;
+
+		if (slot.step == 1.0) {
+			int16Frames = slot.inputFrames.data();
+		} else {
+			auto nextPosition = ResampleLinearInt16(slot.inputFrames.data(), slot.inputFrameCount, sourceChannelCount, slot.position, slot.step, buffers.resampledFrames.data(), frameCount);
+
+			floatFrames = buffers.resampledFrames.data();
+
+			slot.position = nextPosition;
+		}
+
+		// Mix, ramping the gains linearly to their target, if they changed
+		auto gainsChanged = !std::equal(slot.channelGains, slot.channelGains + this->channelCount, targetGains);
+		auto stepCount = gainsChanged ? std::min(mixerGainRampStepCount, frameCount) : 1;
+
+		int64_t frameOffset = 0;
+
+		for (int64_t stepIndex = 0; stepIndex < stepCount; stepIndex++) {
+			auto stepFrameCount = ((frameCount * (stepIndex + 1)) / stepCount) - frameOffset;
+
+			float stepGains[maxMixerChannelCount];
+
+			for (int64_t channelIndex = 0; channelIndex < this->channelCount; channelIndex++) {
+				auto startGain = slot.channelGains[channelIndex];
+
+				stepGains[channelIndex] = startGain + ((targetGains[channelIndex] - startGain) * float(stepIndex + 1) / float(stepCount));
+			}
+
+			auto accumulator = buffers.accumulator.data() + (frameOffset * this->channelCount);
+
+			if (int16Frames != nullptr && sourceChannelCount == this->channelCount) {
+				MixInt16(int16Frames + (frameOffset * sourceChannelCount), stepGains, this->channelCount, accumulator, stepFrameCount);
+			} else if (int16Frames != nullptr) {
+				// A mono source is converted to float first, then spread to all channels
+				auto converted = buffers.resampledFrames.data();
+
+				ConvertInt16ToFloat(int16Frames + frameOffset, converted, stepFrameCount);
+				MixFloat(converted, 1, stepGains, this->channelCount, accumulator, stepFrameCount);
+			} else {
+				MixFloat(floatFrames + (frameOffset * sourceChannelCount), sourceChannelCount, stepGains, this->channelCount, accumulator, stepFrameCount);
+			}
+
+			frameOffset += stepFrameCount;
+		}
+
+		std::copy(targetGains, targetGains + this->channelCount, slot.channelGains);
+
+		// Keep the frames that weren't consumed for the next mix
+		auto consumedFrameCount = slot.step == 1.0 ? frameCount : std::min(int64_t(slot.position), slot.inputFrameCount);
+
+		if (consumedFrameCount > 0) {
+			auto remainingFrameCount = slot.inputFrameCount - consumedFrameCount;
+
+			memmove(slot.inputFrames.data(), slot.inputFrames.data() + (consumedFrameCount * sourceChannelCount), remainingFrameCount * sourceChannelCount * sizeof(int16_t));
+
+			slot.inputFrameCount = remainingFrameCount;
+			slot.position -= double(consumedFrameCount);
+		}
+
+		slot.mixedFrameCount.fetch_add(frameCount, std::memory_order_relaxed);
+	}
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+// State of an output backend. Mirrors the ALSA PCM states the output engine relies on.
+enum class BackendState {
+	Setup, // Stopped. Must be prepared before writing.
+	Prepared, // Ready to start, on the first write
+	Running,
+	Paused,
+	Xrun, // Underrun. Must be recovered before writing.
+};
+
+// Status of a backend, taken at a single point in time
+struct BackendStatus {
+	BackendState state = BackendState::Setup;
+	int64_t delayFrameCount = 0; // Frames queued, plus any additional delay. Only valid when running.
+	int64_t availableFrameCount = 0; // Frames that can be written without blocking
+	int64_t timestamp = -1; // Monotonic time the status was taken at, in nanoseconds, or -1 if not known
+};
+
+// The device layer of the output engine.
+//
+// All methods, except `Open`, are only called by the output thread. Like ALSA functions, methods return
+// a negative `errno` code on failure. In particular, `-EPIPE` is returned on underrun.
+class OutputBackend {
+public:
+	virtual ~OutputBackend() {}
+
+	// Opens the backend with the given sample rate and channel count. `writeFrameCount` is the number of
+	// frames the engine writes on each wakeup, for backends that choose their own buffer size.
+	//
+	// On failure, returns a negative error code, and sets `errorMessage`.
+	virtual int Open(int64_t sampleRate, int64_t channelCount, int64_t writeFrameCount, std::string& errorMessage) = 0;
+
+	// Returns a negative error code if frames written before closing were lost, like when a file couldn't be written
+	virtual int Close() = 0;
+
+	// Parameters, only valid after the backend was opened
+	virtual int64_t GetSampleRate() const = 0;
+	virtual int64_t GetBufferFrameCount() const = 0;
+	virtual int64_t GetPeriodFrameCount() const = 0;
+	virtual bool CanPause() const = 0;
+
+	virtual int GetAvailableAndDelay(int64_t& availableFrameCount, int64_t& delayFrameCount) = 0;
+	virtual int GetStatus(BackendStatus& status) = 0;
+	virtual BackendState GetState() = 0;
+
+	// Writes interleaved frames, blocking until all were queued. Returns the number of frames written.
+	virtual int64_t Write(const int16_t* samples, int64_t frameCount) = 0;
+
+	virtual int Recover(int errorCode) = 0;
+	virtual int Prepare() = 0;
+	virtual int Drain() = 0;
+	virtual int Drop() = 0;
+	virtual int Pause(bool enable) = 0;
+
+	virtual int64_t GetRewindableFrameCount() = 0;
+	virtual int64_t Rewind(int64_t frameCount) = 0;
+
+	// Describes an error code returned by one of the methods
+	virtual const char* GetErrorDescription(int errorCode) const {
+		return strerror(-errorCode);
+	}
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+// A histogram with logarithmically scaled buckets, recorded to by a single thread, and read by any other thread,
+// without locking.
+//
+// Bucket 0 counts values of 0, and bucket i counts values in the range [2^(i-1), 2^i).
+// Values beyond the range of the last bucket are counted in the last bucket.
+class LogHistogram {
+public:
+	static const int bucketCount = 32;
+
+private:
+	std::atomic<uint64_t> buckets[bucketCount];
+	std::atomic<uint64_t> count{0};
+	std::atomic<uint64_t> sum{0};
+	std::atomic<uint64_t> max{0};
+
+public:
+	LogHistogram() {
+		for (int i = 0; i < bucketCount; i++) {
+			buckets[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// Recorder only
+	void Record(int64_t value) {
+		auto unsignedValue = value > 0 ? uint64_t(value) : uint64_t(0);
+
+		auto bucketIndex = 0;
+
+		if (unsignedValue > 0) {
+			bucketIndex = 64 - __builtin_clzll(unsignedValue);
+
+			if (bucketIndex >= bucketCount) {
+				bucketIndex = bucketCount - 1;
+			}
+		}
+
+		buckets[bucketIndex].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(unsignedValue, std::memory_order_relaxed);
+
+		if (unsignedValue > max.load(std::memory_order_relaxed)) {
+			max.store(unsignedValue, std::memory_order_relaxed);
+		}
+	}
+
+	uint64_t GetBucket(int bucketIndex) const {
+		return buckets[bucketIndex].load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetCount() const {
+		return count.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetSum() const {
+		return sum.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetMax() const {
+		return max.load(std::memory_order_relaxed);
+	}
+};
+
+// Statistics collected by the output thread, and read from the JavaScript thread, without locking.
+// Durations are in microseconds.
+struct OutputStats {
+	std::atomic<uint64_t> underrunCount{0};
+	std::atomic<uint64_t> recoveryCount{0}; // Underruns successfully recovered from
+	std::atomic<uint64_t> recoveryFailureCount{0};
+	std::atomic<uint64_t> deadlineMissCount{0}; // Writes made when less than a period of audio was left queued
+	std::atomic<uint64_t> concealedPeriodCount{0}; // Periods of silence written while waiting for a late handler
+
+	LogHistogram handlerLatency; // Time from requesting a handler call, to the handler being called
+	LogHistogram handlerDuration; // Time spent in the handler
+	LogHistogram handlerRoundTrip; // Time from requesting a handler call, to the output thread resuming after it returned
+	LogHistogram writeDuration; // Time spent writing to the device
+	LogHistogram wakeupJitter; // Deviation of the interval between writes, from the ideal interval
+	LogHistogram slack; // Duration of audio left queued in the device at each write
+	LogHistogram bufferFill; // Frames left queued in the device at each write
+	LogHistogram mixDuration; // Time spent mixing each buffer, when playing through a mixer
+};
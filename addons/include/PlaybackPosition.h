@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+
+// A snapshot of the playback state, taken by the output thread after writing to the device
+struct PlaybackPositionSnapshot {
+	int64_t framesWritten; // Total frames written to the device, in the output's timeline
+	int64_t delayFrameCount; // Frames written but not yet played, at the time of the snapshot
+	int64_t contentFrameOffset; // Frame offset of the next content frame to be written (handler, stream or clip frame)
+	int64_t contentEndFrame; // Frame following the last content frame written, in the output's timeline. Frames after it are silence.
+	int64_t timestamp; // Monotonic time of the snapshot, in nanoseconds
+	bool isRunning; // Whether the device was consuming frames at the time of the snapshot
+};
+
+// Publishes snapshots from the output thread, to be read from any other thread, without locking.
+//
+// Uses a sequence lock: the writer increments the sequence number before and after updating the fields,
+// and readers retry if the sequence number was odd, or changed while they were reading.
+class PlaybackPosition {
+private:
+	std::atomic<uint32_t> sequence{0};
+
+	std::atomic<int64_t> framesWritten{0};
+	std::atomic<int64_t> delayFrameCount{0};
+	std::atomic<int64_t> contentFrameOffset{0};
+	std::atomic<int64_t> contentEndFrame{0};
+	std::atomic<int64_t> timestamp{0};
+	std::atomic<bool> isRunning{false};
+
+	int64_t sampleRate;
+
+public:
+	PlaybackPosition(int64_t sampleRate) : sampleRate(sampleRate) {
+	}
+
+	// Writer only
+	void Publish(const PlaybackPositionSnapshot& snapshot) {
+		sequence.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		framesWritten.store(snapshot.framesWritten, std::memory_order_relaxed);
+		delayFrameCount.store(snapshot.delayFrameCount, std::memory_order_relaxed);
+		contentFrameOffset.store(snapshot.contentFrameOffset, std::memory_order_relaxed);
+		contentEndFrame.store(snapshot.contentEndFrame, std::memory_order_relaxed);
+		timestamp.store(snapshot.timestamp, std::memory_order_relaxed);
+		isRunning.store(snapshot.isRunning, std::memory_order_relaxed);
+
+		sequence.fetch_add(1, std::memory_order_release);
+	}
+
+	PlaybackPositionSnapshot Read() const {
+		PlaybackPositionSnapshot snapshot;
+
+		while (true) {
+			auto sequenceBefore = sequence.load(std::memory_order_acquire);
+
+			snapshot.framesWritten = framesWritten.load(std::memory_order_relaxed);
+			snapshot.delayFrameCount = delayFrameCount.load(std::memory_order_relaxed);
+			snapshot.contentFrameOffset = contentFrameOffset.load(std::memory_order_relaxed);
+			snapshot.contentEndFrame = contentEndFrame.load(std::memory_order_relaxed);
+			snapshot.timestamp = timestamp.load(std::memory_order_relaxed);
+			snapshot.isRunning = isRunning.load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			auto sequenceAfter = sequence.load(std::memory_order_relaxed);
+
+			if (sequenceBefore == sequenceAfter && (sequenceBefore & 1) == 0) {
+				return snapshot;
+			}
+		}
+	}
+
+	// Returns the frame, in the output's timeline, that is playing at the given monotonic time.
+	//
+	// While the device is running, the position is interpolated from the last snapshot, using the sample rate,
+	// but never beyond the frames that were actually written.
+	int64_t GetPlayedFrameAt(const PlaybackPositionSnapshot& snapshot, int64_t time) const {
+		auto playedFrame = snapshot.framesWritten - snapshot.delayFrameCount;
+
+		if (snapshot.isRunning && time > snapshot.timestamp) {
+			playedFrame += ((time - snapshot.timestamp) * sampleRate) / 1000000000;
+		}
+
+		return std::min(playedFrame, snapshot.framesWritten);
+	}
+
+	// Returns the content frame that is playing, given the frame playing in the output's timeline.
+	//
+	// Only the frames queued before the end of the content are counted as content, so silence written after it
+	// (on a source underflow, or while a late handler is concealed) doesn't hold back the content frame.
+	int64_t GetPlayedContentFrame(const PlaybackPositionSnapshot& snapshot, int64_t playedFrame) const {
+		auto queuedContentFrameCount = std::max(snapshot.contentEndFrame - playedFrame, int64_t(0));
+
+		return std::max(snapshot.contentFrameOffset - queuedContentFrameCount, int64_t(0));
+	}
+
+	int64_t GetSampleRate() const {
+		return sampleRate;
+	}
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+// USDT (user-level statically defined tracing) probes, for attaching tools like bpftrace or perf
+// to a running process, without rebuilding.
+//
+// Probes are only compiled in when `sys/sdt.h` is available (on Debian and Ubuntu, it's provided by the
+// `systemtap-sdt-dev` package). Each probe compiles to a single no-op instruction, so it has no
+// measurable cost when no tool is attached.
+//
+// All probes are under the `audio_io` provider. The first argument of every probe is the address of the output,
+// so events from different outputs can be told apart.
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define AUDIO_IO_PROBES_ENABLED
+#endif
+#endif
+
+#ifdef AUDIO_IO_PROBES_ENABLED
+#define AUDIO_IO_PROBE1(name, arg1) DTRACE_PROBE1(audio_io, name, arg1)
+#define AUDIO_IO_PROBE2(name, arg1, arg2) DTRACE_PROBE2(audio_io, name, arg1, arg2)
+#else
+#define AUDIO_IO_PROBE1(name, arg1) do {} while (0)
+#define AUDIO_IO_PROBE2(name, arg1, arg2) do {} while (0)
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <dlfcn.h>
+
+// Hooks into the realtime guard library (built from `src/realtime-guard.cpp`). When the library is preloaded,
+// with `LD_PRELOAD`, it interposes the memory allocation and mutex functions of the process, and counts,
+// or aborts on, any call made by a thread while it's within a realtime section.
+//
+// When the library isn't preloaded, the hooks aren't found, and entering or leaving a section is a single branch.
+
+struct RealtimeGuardViolationCounts {
+	int64_t allocationCount = 0;
+	int64_t deallocationCount = 0;
+	int64_t lockCount = 0;
+};
+
+typedef void (*RealtimeGuardSectionFunction)();
+typedef void (*RealtimeGuardGetViolationCountsFunction)(int64_t* allocationCount, int64_t* deallocationCount, int64_t* lockCount);
+
+RealtimeGuardSectionFunction realtimeGuardEnterSection = nullptr;
+RealtimeGuardSectionFunction realtimeGuardLeaveSection = nullptr;
+RealtimeGuardGetViolationCountsFunction realtimeGuardGetViolationCounts = nullptr;
+
+// Looks up the hooks of the preloaded library. Must be called before any output thread is started.
+void InitializeRealtimeGuard() {
+	realtimeGuardEnterSection = (RealtimeGuardSectionFunction)dlsym(RTLD_DEFAULT, "audio_io_realtime_guard_enter_section");
+	realtimeGuardLeaveSection = (RealtimeGuardSectionFunction)dlsym(RTLD_DEFAULT, "audio_io_realtime_guard_leave_section");
+	realtimeGuardGetViolationCounts = (RealtimeGuardGetViolationCountsFunction)dlsym(RTLD_DEFAULT, "audio_io_realtime_guard_get_violation_counts");
+
+	if (realtimeGuardEnterSection == nullptr || realtimeGuardLeaveSection == nullptr || realtimeGuardGetViolationCounts == nullptr) {
+		realtimeGuardEnterSection = nullptr;
+		realtimeGuardLeaveSection = nullptr;
+		realtimeGuardGetViolationCounts = nullptr;
+	}
+}
+
+// Returns false if the realtime guard library isn't preloaded
+bool GetRealtimeGuardViolationCounts(RealtimeGuardViolationCounts& counts) {
+	if (realtimeGuardGetViolationCounts == nullptr) {
+		return false;
+	}
+
+	realtimeGuardGetViolationCounts(&counts.allocationCount, &counts.deallocationCount, &counts.lockCount);
+
+	return true;
+}
+
+// Marks the current thread as running realtime code, for as long as the object is alive.
+// Sections can be nested.
+class RealtimeSection {
+public:
+	RealtimeSection() {
+		if (realtimeGuardEnterSection != nullptr) {
+			realtimeGuardEnterSection();
+		}
+	}
+
+	~RealtimeSection() {
+		if (realtimeGuardLeaveSection != nullptr) {
+			realtimeGuardLeaveSection();
+		}
+	}
+
+	RealtimeSection(const RealtimeSection&) = delete;
+	RealtimeSection& operator=(const RealtimeSection&) = delete;
+};
+
+// Temporarily leaves the current realtime section, for as long as the object is alive.
+//
+// Used around calls into ALSA: with a hardware device, they only make system calls, but plugins, like
+// those of sound servers, may allocate or lock, which is outside our control.
+class RealtimeSectionSuspension {
+public:
+	RealtimeSectionSuspension() {
+		if (realtimeGuardLeaveSection != nullptr) {
+			realtimeGuardLeaveSection();
+		}
+	}
+
+	~RealtimeSectionSuspension() {
+		if (realtimeGuardEnterSection != nullptr) {
+			realtimeGuardEnterSection();
+		}
+	}
+
+	RealtimeSectionSuspension(const RealtimeSectionSuspension&) = delete;
+	RealtimeSectionSuspension& operator=(const RealtimeSectionSuspension&) = delete;
+};
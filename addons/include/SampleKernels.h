@@ -0,0 +1,421 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SAMPLE_KERNELS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define SAMPLE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// Sample processing kernels, used by the output engine and the mixer.
+//
+// Each kernel has a portable scalar implementation. The kernels that dominate mixing cost also have an SSE2 (x64)
+// or NEON (arm64) implementation, selected at compile time, producing the same results as the scalar one.
+// The unsuffixed functions call the best implementation available.
+//
+// Float samples are in 16-bit units (full scale is 32767), so accumulated mixes can be converted without scaling.
+
+// Name of the instruction set used by the unsuffixed functions
+const char* GetSampleKernelInstructionSet() {
+#if defined(SAMPLE_KERNELS_SSE2)
+	return "sse2";
+#elif defined(SAMPLE_KERNELS_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Float to 16-bit conversion, with rounding to nearest, and saturation
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ConvertFloatToInt16Scalar(const float* input, int16_t* output, int64_t sampleCount) {
+	for (int64_t i = 0; i < sampleCount; i++) {
+		auto sample = std::min(std::max(input[i], -32768.0f), 32767.0f);
+
+		output[i] = int16_t(lrintf(sample));
+	}
+}
+
+#if defined(SAMPLE_KERNELS_SSE2)
+void ConvertFloatToInt16Sse2(const float* input, int16_t* output, int64_t sampleCount) {
+	auto minimum = _mm_set1_ps(-32768.0f);
+	auto maximum = _mm_set1_ps(32767.0f);
+
+	int64_t i = 0;
+
+	for (; i + 8 <= sampleCount; i += 8) {
+		// Clamped first, since out of range values would convert to INT32_MIN
+		auto low = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(input + i), minimum), maximum);
+		auto high = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(input + i + 4), minimum), maximum);
+
+		auto packed = _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high));
+
+		_mm_storeu_si128((__m128i*)(output + i), packed);
+	}
+
+	ConvertFloatToInt16Scalar(input + i, output + i, sampleCount - i);
+}
+#endif
+
+#if defined(SAMPLE_KERNELS_NEON)
+void ConvertFloatToInt16Neon(const float* input, int16_t* output, int64_t sampleCount) {
+	int64_t i = 0;
+
+	for (; i + 8 <= sampleCount; i += 8) {
+		auto low = vcvtnq_s32_f32(vld1q_f32(input + i));
+		auto high = vcvtnq_s32_f32(vld1q_f32(input + i + 4));
+
+		vst1q_s16(output + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+	}
+
+	ConvertFloatToInt16Scalar(input + i, output + i, sampleCount - i);
+}
+#endif
+
+void ConvertFloatToInt16(const float* input, int16_t* output, int64_t sampleCount) {
+#if defined(SAMPLE_KERNELS_SSE2)
+	ConvertFloatToInt16Sse2(input, output, sampleCount);
+#elif defined(SAMPLE_KERNELS_NEON)
+	ConvertFloatToInt16Neon(input, output, sampleCount);
+#else
+	ConvertFloatToInt16Scalar(input, output, sampleCount);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// 16-bit to float conversion
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void ConvertInt16ToFloatScalar(const int16_t* input, float* output, int64_t sampleCount) {
+	for (int64_t i = 0; i < sampleCount; i++) {
+		output[i] = float(input[i]);
+	}
+}
+
+#if defined(SAMPLE_KERNELS_SSE2)
+void ConvertInt16ToFloatSse2(const int16_t* input, float* output, int64_t sampleCount) {
+	int64_t i = 0;
+
+	for (; i + 8 <= sampleCount; i += 8) {
+		auto samples = _mm_loadu_si128((const __m128i*)(input + i));
+
+		// Sign-extend by placing each sample in the high half of a 32-bit lane, and shifting it down
+		auto low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+		auto high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+
+		_mm_storeu_ps(output + i, _mm_cvtepi32_ps(low));
+		_mm_storeu_ps(output + i + 4, _mm_cvtepi32_ps(high));
+	}
+
+	ConvertInt16ToFloatScalar(input + i, output + i, sampleCount - i);
+}
+#endif
+
+#if defined(SAMPLE_KERNELS_NEON)
+void ConvertInt16ToFloatNeon(const int16_t* input, float* output, int64_t sampleCount) {
+	int64_t i = 0;
+
+	for (; i + 8 <= sampleCount; i += 8) {
+		auto samples = vld1q_s16(input + i);
+
+		vst1q_f32(output + i, vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))));
+		vst1q_f32(output + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))));
+	}
+
+	ConvertInt16ToFloatScalar(input + i, output + i, sampleCount - i);
+}
+#endif
+
+void ConvertInt16ToFloat(const int16_t* input, float* output, int64_t sampleCount) {
+#if defined(SAMPLE_KERNELS_SSE2)
+	ConvertInt16ToFloatSse2(input, output, sampleCount);
+#elif defined(SAMPLE_KERNELS_NEON)
+	ConvertInt16ToFloatNeon(input, output, sampleCount);
+#else
+	ConvertInt16ToFloatScalar(input, output, sampleCount);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Mixing: adds interleaved 16-bit frames, with a gain per channel, to a float accumulator
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MixInt16Scalar(const int16_t* source, const float* channelGains, int64_t channelCount, float* accumulator, int64_t frameCount) {
+	for (int64_t i = 0; i < frameCount; i++) {
+		for (int64_t channelIndex = 0; channelIndex < channelCount; channelIndex++) {
+			auto sampleIndex = (i * channelCount) + channelIndex;
+
+			accumulator[sampleIndex] += float(source[sampleIndex]) * channelGains[channelIndex];
+		}
+	}
+}
+
+#if defined(SAMPLE_KERNELS_SSE2)
+void MixInt16Sse2(const int16_t* source, const float* channelGains, int64_t channelCount, float* accumulator, int64_t frameCount) {
+	// The gains repeat every 4 samples only for mono and stereo
+	if (channelCount != 1 && channelCount != 2) {
+		MixInt16Scalar(source, channelGains, channelCount, accumulator, frameCount);
+
+		return;
+	}
+
+	auto gains = channelCount == 1 ? _mm_set1_ps(channelGains[0]) : _mm_setr_ps(channelGains[0], channelGains[1], channelGains[0], channelGains[1]);
+
+	auto sampleCount = frameCount * channelCount;
+
+	int64_t i = 0;
+
+	for (; i + 8 <= sampleCount; i += 8) {
+		auto samples = _mm_loadu_si128((const __m128i*)(source + i));
+
+		auto low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16));
+		auto high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16));
+
+		_mm_storeu_ps(accumulator + i, _mm_add_ps(_mm_loadu_ps(accumulator + i), _mm_mul_ps(low, gains)));
+		_mm_storeu_ps(accumulator + i + 4, _mm_add_ps(_mm_loadu_ps(accumulator + i + 4), _mm_mul_ps(high, gains)));
+	}
+
+	MixInt16Scalar(source + i, channelGains, channelCount, accumulator + i, (sampleCount - i) / channelCount);
+}
+#endif
+
+#if defined(SAMPLE_KERNELS_NEON)
+void MixInt16Neon(const int16_t* source, const float* channelGains, int64_t channelCount, float* accumulator, int64_t frameCount) {
+	if (channelCount != 1 && channelCount != 2) {
+		MixInt16Scalar(source, channelGains, channelCount, accumulator, frameCount);
+
+		return;
+	}
+
+	const float gainValues[4] = { channelGains[0], channelGains[channelCount - 1], channelGains[0], channelGains[channelCount - 1] };
+	auto gains = vld1q_f32(gainValues);
+
+	auto sampleCount = frameCount * channelCount;
+
+	int64_t i = 0;
+
+	for (; i + 8 <= sampleCount; i += 8) {
+		auto samples = vld1q_s16(source + i);
+
+		auto low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples)));
+		auto high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples)));
+
+		// Multiplied and added separately, rather than fused, to match the scalar rounding
+		vst1q_f32(accumulator + i, vaddq_f32(vld1q_f32(accumulator + i), vmulq_f32(low, gains)));
+		vst1q_f32(accumulator + i + 4, vaddq_f32(vld1q_f32(accumulator + i + 4), vmulq_f32(high, gains)));
+	}
+
+	MixInt16Scalar(source + i, channelGains, channelCount, accumulator + i, (sampleCount - i) / channelCount);
+}
+#endif
+
+void MixInt16(const int16_t* source, const float* channelGains, int64_t channelCount, float* accumulator, int64_t frameCount) {
+#if defined(SAMPLE_KERNELS_SSE2)
+	MixInt16Sse2(source, channelGains, channelCount, accumulator, frameCount);
+#elif defined(SAMPLE_KERNELS_NEON)
+	MixInt16Neon(source, channelGains, channelCount, accumulator, frameCount);
+#else
+	MixInt16Scalar(source, channelGains, channelCount, accumulator, frameCount);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Mixing: adds interleaved float frames, with a gain per output channel, to a float accumulator.
+// The source has either as many channels as the accumulator, or a single channel, which is added to all of them.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void MixFloatScalar(const float* source, int64_t sourceChannelCount, const float* channelGains, int64_t channelCount, float* accumulator, int64_t frameCount) {
+	for (int64_t i = 0; i < frameCount; i++) {
+		for (int64_t channelIndex = 0; channelIndex < channelCount; channelIndex++) {
+			auto sample = sourceChannelCount == 1 ? source[i] : source[(i * channelCount) + channelIndex];
+
+			accumulator[(i * channelCount) + channelIndex] += sample * channelGains[channelIndex];
+		}
+	}
+}
+
+#if defined(SAMPLE_KERNELS_SSE2)
+void MixFloatSse2(const float* source, int64_t sourceChannelCount, const float* channelGains, int64_t channelCount, float* accumulator, int64_t frameCount) {
+	if (sourceChannelCount != channelCount || (channelCount != 1 && channelCount != 2)) {
+		MixFloatScalar(source, sourceChannelCount, channelGains, channelCount, accumulator, frameCount);
+
+		return;
+	}
+
+	auto gains = channelCount == 1 ? _mm_set1_ps(channelGains[0]) : _mm_setr_ps(channelGains[0], channelGains[1], channelGains[0], channelGains[1]);
+
+	auto sampleCount = frameCount * channelCount;
+
+	int64_t i = 0;
+
+	for (; i + 4 <= sampleCount; i += 4) {
+		_mm_storeu_ps(accumulator + i, _mm_add_ps(_mm_loadu_ps(accumulator + i), _mm_mul_ps(_mm_loadu_ps(source + i), gains)));
+	}
+
+	MixFloatScalar(source + i, sourceChannelCount, channelGains, channelCount, accumulator + i, (sampleCount - i) / channelCount);
+}
+#endif
+
+#if defined(SAMPLE_KERNELS_NEON)
+void MixFloatNeon(const float* source, int64_t sourceChannelCount, const float* channelGains, int64_t channelCount, float* accumulator, int64_t frameCount) {
+	if (sourceChannelCount != channelCount || (channelCount != 1 && channelCount != 2)) {
+		MixFloatScalar(source, sourceChannelCount, channelGains, channelCount, accumulator, frameCount);
+
+		return;
+	}
+
+	const float gainValues[4] = { channelGains[0], channelGains[channelCount - 1], channelGains[0], channelGains[channelCount - 1] };
+	auto gains = vld1q_f32(gainValues);
+
+	auto sampleCount = frameCount * channelCount;
+
+	int64_t i = 0;
+
+	for (; i + 4 <= sampleCount; i += 4) {
+		vst1q_f32(accumulator + i, vaddq_f32(vld1q_f32(accumulator + i), vmulq_f32(vld1q_f32(source + i), gains)));
+	}
+
+	MixFloatScalar(source + i, sourceChannelCount, channelGains, channelCount, accumulator + i, (sampleCount - i) / channelCount);
+}
+#endif
+
+void MixFloat(const float* source, int64_t sourceChannelCount, const float* channelGains, int64_t channelCount, float* accumulator, int64_t frameCount) {
+#if defined(SAMPLE_KERNELS_SSE2)
+	MixFloatSse2(source, sourceChannelCount, channelGains, channelCount, accumulator, frameCount);
+#elif defined(SAMPLE_KERNELS_NEON)
+	MixFloatNeon(source, sourceChannelCount, channelGains, channelCount, accumulator, frameCount);
+#else
+	MixFloatScalar(source, sourceChannelCount, channelGains, channelCount, accumulator, frameCount);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reduction: adds float samples to an accumulator, like partial mixes made by separate threads
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void AddFloatScalar(const float* source, float* accumulator, int64_t sampleCount) {
+	for (int64_t i = 0; i < sampleCount; i++) {
+		accumulator[i] += source[i];
+	}
+}
+
+#if defined(SAMPLE_KERNELS_SSE2)
+void AddFloatSse2(const float* source, float* accumulator, int64_t sampleCount) {
+	int64_t i = 0;
+
+	for (; i + 8 <= sampleCount; i += 8) {
+		_mm_storeu_ps(accumulator + i, _mm_add_ps(_mm_loadu_ps(accumulator + i), _mm_loadu_ps(source + i)));
+		_mm_storeu_ps(accumulator + i + 4, _mm_add_ps(_mm_loadu_ps(accumulator + i + 4), _mm_loadu_ps(source + i + 4)));
+	}
+
+	AddFloatScalar(source + i, accumulator + i, sampleCount - i);
+}
+#endif
+
+#if defined(SAMPLE_KERNELS_NEON)
+void AddFloatNeon(const float* source, float* accumulator, int64_t sampleCount) {
+	int64_t i = 0;
+
+	for (; i + 8 <= sampleCount; i += 8) {
+		vst1q_f32(accumulator + i, vaddq_f32(vld1q_f32(accumulator + i), vld1q_f32(source + i)));
+		vst1q_f32(accumulator + i + 4, vaddq_f32(vld1q_f32(accumulator + i + 4), vld1q_f32(source + i + 4)));
+	}
+
+	AddFloatScalar(source + i, accumulator + i, sampleCount - i);
+}
+#endif
+
+void AddFloat(const float* source, float* accumulator, int64_t sampleCount) {
+#if defined(SAMPLE_KERNELS_SSE2)
+	AddFloatSse2(source, accumulator, sampleCount);
+#elif defined(SAMPLE_KERNELS_NEON)
+	AddFloatNeon(source, accumulator, sampleCount);
+#else
+	AddFloatScalar(source, accumulator, sampleCount);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Scalar only kernels
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Interleaves separate channels into frames
+void InterleaveInt16(const int16_t* const* channels, int64_t channelCount, int16_t* output, int64_t frameCount) {
+	for (int64_t i = 0; i < frameCount; i++) {
+		for (int64_t channelIndex = 0; channelIndex < channelCount; channelIndex++) {
+			output[(i * channelCount) + channelIndex] = channels[channelIndex][i];
+		}
+	}
+}
+
+// Splits frames into separate channels
+void DeinterleaveInt16(const int16_t* input, int64_t channelCount, int16_t* const* channels, int64_t frameCount) {
+	for (int64_t i = 0; i < frameCount; i++) {
+		for (int64_t channelIndex = 0; channelIndex < channelCount; channelIndex++) {
+			channels[channelIndex][i] = input[(i * channelCount) + channelIndex];
+		}
+	}
+}
+
+// Writes a linear crossfade from `fadingOut` to `fadingIn`, over `frameCount` frames. A null `fadingIn` is taken
+// as silence, giving a fade-out. `output` may be the same as `fadingOut`.
+void CrossfadeInt16(const int16_t* fadingOut, const int16_t* fadingIn, int16_t* output, int64_t frameCount, int64_t channelCount) {
+	for (int64_t i = 0; i < frameCount; i++) {
+		auto gain = float(i + 1) / float(frameCount);
+
+		for (int64_t channelIndex = 0; channelIndex < channelCount; channelIndex++) {
+			auto sampleIndex = (i * channelCount) + channelIndex;
+
+			auto fadingOutSample = float(fadingOut[sampleIndex]);
+			auto fadingInSample = fadingIn != nullptr ? float(fadingIn[sampleIndex]) : 0.0f;
+
+			output[sampleIndex] = int16_t((fadingOutSample * (1.0f - gain)) + (fadingInSample * gain));
+		}
+	}
+}
+
+// Converts float samples to 16 bits, with triangular (TPDF) dither of 1 LSB peak. `state` is the state of the
+// noise generator, and must be non-zero.
+void DitherFloatToInt16(const float* input, int16_t* output, int64_t sampleCount, uint32_t& state) {
+	auto nextRandom = [&state]() {
+		// xorshift32
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		return float(state) * (1.0f / 4294967296.0f);
+	};
+
+	for (int64_t i = 0; i < sampleCount; i++) {
+		auto dither = nextRandom() - nextRandom();
+		auto sample = std::min(std::max(input[i] + dither, -32768.0f), 32767.0f);
+
+		output[i] = int16_t(lrintf(sample));
+	}
+}
+
+// Resamples interleaved 16-bit frames by linear interpolation, reading from `position` (in input frames), and
+// advancing it by `step` for every output frame. Each output frame reads the input frame at the integer part of
+// the position, and the one after it, which must both be within the `inputFrameCount` frames.
+//
+// Returns the position following the last output frame.
+double ResampleLinearInt16(const int16_t* input, int64_t inputFrameCount, int64_t channelCount, double position, double step, float* output, int64_t outputFrameCount) {
+	for (int64_t i = 0; i < outputFrameCount; i++) {
+		auto inputFrame = std::min(int64_t(position), inputFrameCount - 2);
+		auto fraction = float(position - double(inputFrame));
+
+		auto current = input + (inputFrame * channelCount);
+		auto next = current + channelCount;
+
+		for (int64_t channelIndex = 0; channelIndex < channelCount; channelIndex++) {
+			output[(i * channelCount) + channelIndex] = float(current[channelIndex]) + ((float(next[channelIndex]) - float(current[channelIndex])) * fraction);
+		}
+
+		position += step;
+	}
+
+	return position;
+}
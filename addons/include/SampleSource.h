@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// A source of interleaved 16-bit samples, read natively by the output thread, without calling into JavaScript
+class SampleSource {
+public:
+	virtual ~SampleSource() {}
+
+	// Copies up to `sampleCount` samples to `target` and returns the number of samples copied.
+	// If fewer samples are available, the remainder of `target` is left untouched.
+	virtual int64_t Read(int16_t* target, int64_t sampleCount) = 0;
+
+	// Returns true if the source has no more samples, and never will
+	virtual bool IsExhausted() const = 0;
+
+	// Returns the offset, in samples, of the next sample to be read, relative to the start of the source
+	virtual int64_t GetReadOffset() const = 0;
+
+	// Returns the number of bytes of native memory currently held by the source
+	virtual int64_t GetHeldByteCount() const = 0;
+};
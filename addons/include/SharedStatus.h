@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Slots of the shared status buffer. Each slot is a 64-bit float, except for slot 0, which holds
+// two 32-bit integers: a sequence number and the output state.
+//
+// This layout must be kept in sync with the one used by `readAudioOutputStatus` in `AudioIO.ts`.
+enum SharedStatusSlot {
+	SequenceAndState = 0,
+	FramesWritten = 1,
+	PlayedFrame = 2,
+	DelayFrameCount = 3,
+	PlayedContentFrame = 4,
+	Timestamp = 5,
+	UnderrunCount = 6,
+	DeviceSampleRate = 7,
+
+	SharedStatusSlotCount = 8,
+};
+
+enum class OutputState {
+	NotStarted = 0,
+	Playing = 1,
+	Paused = 2,
+	Stopped = 3,
+	Ended = 4,
+};
+
+struct SharedStatusValues {
+	OutputState state;
+	int64_t framesWritten;
+	int64_t playedFrame;
+	int64_t delayFrameCount;
+	int64_t playedContentFrame;
+	int64_t timestamp;
+	int64_t underrunCount;
+	int64_t deviceSampleRate;
+};
+
+// Publishes the output status to memory shared with JavaScript (a `SharedArrayBuffer`), without locking.
+//
+// Uses a sequence lock, like `PlaybackPosition`. JavaScript readers load the sequence number with
+// `Atomics.load`, read the slots, and retry if the sequence number was odd, or has changed.
+class SharedStatus {
+private:
+	std::atomic<int32_t>* sequence;
+	std::atomic<int32_t>* state;
+	std::atomic<double>* slots;
+
+public:
+	SharedStatus(double* sharedMemory) {
+		static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "Atomic 32-bit integers must have the same size as plain ones");
+		static_assert(sizeof(std::atomic<double>) == sizeof(double), "Atomic doubles must have the same size as plain ones");
+
+		sequence = reinterpret_cast<std::atomic<int32_t>*>(sharedMemory);
+		state = reinterpret_cast<std::atomic<int32_t>*>(sharedMemory) + 1;
+		slots = reinterpret_cast<std::atomic<double>*>(sharedMemory);
+	}
+
+	// Writer only
+	void Publish(const SharedStatusValues& values) {
+		sequence->fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		state->store(int32_t(values.state), std::memory_order_relaxed);
+
+		slots[FramesWritten].store(double(values.framesWritten), std::memory_order_relaxed);
+		slots[PlayedFrame].store(double(values.playedFrame), std::memory_order_relaxed);
+		slots[DelayFrameCount].store(double(values.delayFrameCount), std::memory_order_relaxed);
+		slots[PlayedContentFrame].store(double(values.playedContentFrame), std::memory_order_relaxed);
+		slots[Timestamp].store(double(values.timestamp), std::memory_order_relaxed);
+		slots[UnderrunCount].store(double(values.underrunCount), std::memory_order_relaxed);
+		slots[DeviceSampleRate].store(double(values.deviceSampleRate), std::memory_order_relaxed);
+
+		sequence->fetch_add(1, std::memory_order_release);
+	}
+};
@@ -0,0 +1,513 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "OutputBackend.h"
+
+// Output backend simulating a device, without any hardware.
+//
+// When paced, queued frames are consumed at the sample rate, as measured by the monotonic clock, and an underrun
+// occurs if the queue runs empty while running, like with a real device. When unpaced, written frames are consumed
+// immediately, so writes never block, and the engine runs as fast as it can produce frames.
+//
+// Consumed frames are passed to `OnFramesPlayed`. Frames dropped, or rewound, before being consumed, aren't.
+// Once passing them on fails, as reported by `GetOutputError`, writing and draining fail with its error.
+//
+// Never allocates or locks after being opened.
+class SimulatedOutputBackend : public OutputBackend {
+private:
+	bool paced;
+
+	int64_t sampleRate = 0;
+	int64_t channelCount = 0;
+	int64_t bufferFrameCount = 0;
+	int64_t periodFrameCount = 0;
+
+	BackendState state = BackendState::Setup;
+
+	// Queued frames, in a ring indexed by frame number
+	std::vector<int16_t> queue;
+
+	int64_t framesAppended = 0; // Frames written since the backend was last prepared
+	int64_t framesPlayed = 0; // Frames consumed since the backend was last prepared
+
+	// While running, frames are consumed from `framesPlayedAtRunStart`, starting at `runStartTime`
+	int64_t framesPlayedAtRunStart = 0;
+	int64_t runStartTime = 0;
+
+public:
+	SimulatedOutputBackend(bool paced) : paced(paced) {
+	}
+
+	int Open(int64_t requestedSampleRate, int64_t requestedChannelCount, int64_t writeFrameCount, std::string& errorMessage) override {
+		this->sampleRate = requestedSampleRate;
+		this->channelCount = requestedChannelCount;
+
+		// A 10ms period, like the one requested from ALSA, and room for several writes of the engine
+		this->periodFrameCount = std::max(requestedSampleRate / 100, int64_t(1));
+
+		auto minimumBufferFrameCount = std::max(writeFrameCount * 4, this->periodFrameCount * 4);
+
+		this->bufferFrameCount = ((minimumBufferFrameCount + this->periodFrameCount - 1) / this->periodFrameCount) * this->periodFrameCount;
+
+		this->queue.resize(this->bufferFrameCount * this->channelCount);
+
+		this->state = BackendState::Prepared;
+
+		return 0;
+	}
+
+	int Close() override {
+		return 0;
+	}
+
+	int64_t GetSampleRate() const override {
+		return this->sampleRate;
+	}
+
+	int64_t GetBufferFrameCount() const override {
+		return this->bufferFrameCount;
+	}
+
+	int64_t GetPeriodFrameCount() const override {
+		return this->periodFrameCount;
+	}
+
+	bool CanPause() const override {
+		return true;
+	}
+
+	int GetAvailableAndDelay(int64_t& availableFrameCount, int64_t& delayFrameCount) override {
+		this->Update();
+
+		if (this->state == BackendState::Xrun) {
+			return -EPIPE;
+		}
+
+		delayFrameCount = this->GetQueuedFrameCount();
+		availableFrameCount = this->bufferFrameCount - delayFrameCount;
+
+		return 0;
+	}
+
+	int GetStatus(BackendStatus& status) override {
+		this->Update();
+
+		status.state = this->state;
+		status.delayFrameCount = this->GetQueuedFrameCount();
+		status.availableFrameCount = this->bufferFrameCount - status.delayFrameCount;
+		status.timestamp = GetTime();
+
+		return 0;
+	}
+
+	BackendState GetState() override {
+		this->Update();
+
+		return this->state;
+	}
+
+	int64_t Write(const int16_t* samples, int64_t frameCount) override {
+		int64_t framesWritten = 0;
+
+		while (framesWritten < frameCount) {
+			this->Update();
+
+			auto outputError = this->GetOutputError();
+
+			if (outputError < 0) {
+				return framesWritten > 0 ? framesWritten : outputError;
+			}
+
+			if (this->state == BackendState::Xrun) {
+				return framesWritten > 0 ? framesWritten : -EPIPE;
+			}
+
+			if (this->state == BackendState::Setup) {
+				return -EBADFD;
+			}
+
+			auto availableFrameCount = this->bufferFrameCount - this->GetQueuedFrameCount();
+
+			// Like a blocking write to a full device, wait for a period to be consumed
+			if (availableFrameCount == 0 || this->state == BackendState::Paused) {
+				SleepFor(1000000);
+
+				continue;
+			}
+
+			auto framesToQueue = std::min(availableFrameCount, frameCount - framesWritten);
+
+			for (int64_t i = 0; i < framesToQueue; i++) {
+				auto queueOffset = ((this->framesAppended + i) % this->bufferFrameCount) * this->channelCount;
+
+				memcpy(&this->queue[queueOffset], samples + ((framesWritten + i) * this->channelCount), this->channelCount * sizeof(int16_t));
+			}
+
+			this->framesAppended += framesToQueue;
+			framesWritten += framesToQueue;
+
+			// Start on the first write
+			if (this->state == BackendState::Prepared) {
+				this->Start();
+			}
+
+			if (!this->paced) {
+				this->Consume(this->framesAppended);
+			}
+		}
+
+		return framesWritten;
+	}
+
+	int Recover(int errorCode) override {
+		if (errorCode != -EPIPE) {
+			return errorCode;
+		}
+
+		return this->Prepare();
+	}
+
+	int Prepare() override {
+		this->Update();
+
+		this->framesAppended = this->framesPlayed;
+		this->state = BackendState::Prepared;
+
+		return 0;
+	}
+
+	int Drain() override {
+		this->Update();
+
+		while (this->state == BackendState::Running && this->GetQueuedFrameCount() > 0) {
+			auto remainingDuration = (this->GetQueuedFrameCount() * 1000000000) / this->sampleRate;
+
+			SleepFor(std::max(remainingDuration, int64_t(100000)));
+
+			this->Update();
+		}
+
+		this->Consume(this->framesAppended);
+		this->state = BackendState::Setup;
+
+		this->OnDrained();
+
+		return this->GetOutputError();
+	}
+
+	int Drop() override {
+		this->Update();
+
+		this->framesAppended = this->framesPlayed;
+		this->state = BackendState::Setup;
+
+		return 0;
+	}
+
+	int Pause(bool enable) override {
+		this->Update();
+
+		if (enable && this->state == BackendState::Running) {
+			this->state = BackendState::Paused;
+		} else if (!enable && this->state == BackendState::Paused) {
+			this->Start();
+		} else {
+			return -EBADFD;
+		}
+
+		return 0;
+	}
+
+	int64_t GetRewindableFrameCount() override {
+		this->Update();
+
+		return this->GetQueuedFrameCount();
+	}
+
+	int64_t Rewind(int64_t frameCount) override {
+		this->Update();
+
+		auto framesToRewind = std::min(frameCount, this->GetQueuedFrameCount());
+
+		this->framesAppended -= framesToRewind;
+
+		return framesToRewind;
+	}
+
+protected:
+	// Called with frames as they are consumed. A frame count may span the end of the queue, so it's called
+	// with at most two contiguous blocks at a time.
+	virtual void OnFramesPlayed(const int16_t* samples, int64_t frameCount) {
+	}
+
+	// Called after draining, once all queued frames were passed to `OnFramesPlayed`
+	virtual void OnDrained() {
+	}
+
+	// Returns a negative error code once consumed frames couldn't be passed on, or 0
+	virtual int GetOutputError() const {
+		return 0;
+	}
+
+	static int64_t GetTime() {
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC, &time);
+
+		return (int64_t(time.tv_sec) * 1000000000) + time.tv_nsec;
+	}
+
+	static void SleepFor(int64_t duration) {
+		timespec time;
+
+		time.tv_sec = duration / 1000000000;
+		time.tv_nsec = duration % 1000000000;
+
+		nanosleep(&time, nullptr);
+	}
+
+private:
+	int64_t GetQueuedFrameCount() const {
+		return this->framesAppended - this->framesPlayed;
+	}
+
+	void Start() {
+		this->state = BackendState::Running;
+		this->framesPlayedAtRunStart = this->framesPlayed;
+		this->runStartTime = GetTime();
+	}
+
+	// Consumes the frames the device would have played by now. An underrun occurs if the queue ran empty.
+	void Update() {
+		if (this->state != BackendState::Running || !this->paced) {
+			return;
+		}
+
+		auto elapsedFrameCount = ((GetTime() - this->runStartTime) * this->sampleRate) / 1000000000;
+		auto targetFramesPlayed = this->framesPlayedAtRunStart + elapsedFrameCount;
+
+		if (targetFramesPlayed >= this->framesAppended) {
+			this->Consume(this->framesAppended);
+
+			this->state = BackendState::Xrun;
+
+			return;
+		}
+
+		this->Consume(targetFramesPlayed);
+	}
+
+	void Consume(int64_t targetFramesPlayed) {
+		while (this->framesPlayed < targetFramesPlayed) {
+			auto queueFrameOffset = this->framesPlayed % this->bufferFrameCount;
+			auto frameCount = std::min(targetFramesPlayed - this->framesPlayed, this->bufferFrameCount - queueFrameOffset);
+
+			this->OnFramesPlayed(&this->queue[queueFrameOffset * this->channelCount], frameCount);
+
+			this->framesPlayed += frameCount;
+		}
+	}
+};
+
+// Simulated device that discards all frames
+class NullOutputBackend : public SimulatedOutputBackend {
+public:
+	NullOutputBackend(bool paced) : SimulatedOutputBackend(paced) {
+	}
+};
+
+enum class OutputFileFormat {
+	Raw, // Interleaved 16-bit little-endian samples, with no header
+	Wave,
+};
+
+// Simulated device that writes all frames it plays to a file.
+//
+// Frames are collected in a preallocated staging buffer, and written with `write`, without going through
+// stdio, which locks. Once a write fails, like when the disk is full, no more frames are written, and the error
+// is returned by the following writes, by draining, and by closing. The WAVE header only counts the frames written.
+class FileOutputBackend : public SimulatedOutputBackend {
+private:
+	std::string filePath;
+	OutputFileFormat format;
+
+	int fileDescriptor = -1;
+	int64_t channelCount = 0;
+	int64_t sampleRate = 0;
+	int64_t dataByteCount = 0;
+	int writeError = 0;
+
+	std::vector<uint8_t> stagingBuffer;
+	size_t stagingByteCount = 0;
+
+	static const int64_t waveHeaderByteCount = 44;
+
+public:
+	FileOutputBackend(bool paced, const std::string& filePath, OutputFileFormat format) :
+		SimulatedOutputBackend(paced), filePath(filePath), format(format) {
+	}
+
+	int Open(int64_t requestedSampleRate, int64_t requestedChannelCount, int64_t writeFrameCount, std::string& errorMessage) override {
+		auto result = SimulatedOutputBackend::Open(requestedSampleRate, requestedChannelCount, writeFrameCount, errorMessage);
+
+		if (result < 0) {
+			return result;
+		}
+
+		this->fileDescriptor = open(this->filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+		if (this->fileDescriptor < 0) {
+			auto errorCode = -errno;
+
+			errorMessage = "Failed to open output file '" + this->filePath + "': " + strerror(errno);
+
+			return errorCode;
+		}
+
+		this->sampleRate = requestedSampleRate;
+		this->channelCount = requestedChannelCount;
+		this->stagingBuffer.resize(64 * 1024);
+
+		// Reserve space for the header. It's written when the file is closed, once the data size is known.
+		if (this->format == OutputFileFormat::Wave) {
+			uint8_t header[waveHeaderByteCount] = { 0 };
+
+			this->WriteToFile(header, waveHeaderByteCount);
+
+			if (this->writeError != 0) {
+				errorMessage = "Failed to write to output file '" + this->filePath + "': " + strerror(this->writeError);
+
+				close(this->fileDescriptor);
+				this->fileDescriptor = -1;
+
+				return -this->writeError;
+			}
+		}
+
+		return 0;
+	}
+
+	int Close() override {
+		if (this->fileDescriptor < 0) {
+			return 0;
+		}
+
+		this->FlushStagingBuffer();
+
+		if (this->format == OutputFileFormat::Wave) {
+			this->WriteWaveHeader();
+		}
+
+		if (close(this->fileDescriptor) < 0 && this->writeError == 0) {
+			this->writeError = errno;
+		}
+
+		this->fileDescriptor = -1;
+
+		return this->GetOutputError();
+	}
+
+protected:
+	void OnFramesPlayed(const int16_t* samples, int64_t frameCount) override {
+		auto bytes = reinterpret_cast<const uint8_t*>(samples);
+		auto byteCount = size_t(frameCount * this->channelCount * sizeof(int16_t));
+
+		while (byteCount > 0) {
+			auto bytesToCopy = std::min(byteCount, this->stagingBuffer.size() - this->stagingByteCount);
+
+			memcpy(&this->stagingBuffer[this->stagingByteCount], bytes, bytesToCopy);
+
+			this->stagingByteCount += bytesToCopy;
+			bytes += bytesToCopy;
+			byteCount -= bytesToCopy;
+
+			if (this->stagingByteCount == this->stagingBuffer.size()) {
+				this->FlushStagingBuffer();
+			}
+		}
+	}
+
+	void OnDrained() override {
+		this->FlushStagingBuffer();
+	}
+
+	int GetOutputError() const override {
+		return -this->writeError;
+	}
+
+private:
+	void FlushStagingBuffer() {
+		this->dataByteCount += this->WriteToFile(this->stagingBuffer.data(), this->stagingByteCount);
+		this->stagingByteCount = 0;
+	}
+
+	// Writes the given bytes, unless a previous write failed, and returns the number of bytes written
+	size_t WriteToFile(const uint8_t* bytes, size_t byteCount) {
+		size_t writtenByteCount = 0;
+
+		while (writtenByteCount < byteCount && this->writeError == 0) {
+			auto result = write(this->fileDescriptor, bytes + writtenByteCount, byteCount - writtenByteCount);
+
+			if (result < 0) {
+				if (errno != EINTR) {
+					this->writeError = errno;
+				}
+
+				continue;
+			}
+
+			writtenByteCount += result;
+		}
+
+		return writtenByteCount;
+	}
+
+	// Writes a canonical 44-byte PCM WAVE header, at the start of the file
+	void WriteWaveHeader() {
+		uint8_t header[waveHeaderByteCount];
+
+		auto dataSize = uint32_t(std::min(this->dataByteCount, int64_t(UINT32_MAX - waveHeaderByteCount)));
+		auto byteRate = uint32_t(this->sampleRate * this->channelCount * sizeof(int16_t));
+		auto blockAlign = uint16_t(this->channelCount * sizeof(int16_t));
+
+		memcpy(header + 0, "RIFF", 4);
+		WriteUint32(header + 4, dataSize + waveHeaderByteCount - 8);
+		memcpy(header + 8, "WAVE", 4);
+		memcpy(header + 12, "fmt ", 4);
+		WriteUint32(header + 16, 16);
+		WriteUint16(header + 20, 1); // PCM
+		WriteUint16(header + 22, uint16_t(this->channelCount));
+		WriteUint32(header + 24, uint32_t(this->sampleRate));
+		WriteUint32(header + 28, byteRate);
+		WriteUint16(header + 32, blockAlign);
+		WriteUint16(header + 34, 16); // Bits per sample
+		memcpy(header + 36, "data", 4);
+		WriteUint32(header + 40, dataSize);
+
+		auto result = pwrite(this->fileDescriptor, header, waveHeaderByteCount, 0);
+
+		if (result != waveHeaderByteCount && this->writeError == 0) {
+			this->writeError = result < 0 ? errno : EIO;
+		}
+	}
+
+	static void WriteUint16(uint8_t* target, uint16_t value) {
+		target[0] = value & 0xff;
+		target[1] = (value >> 8) & 0xff;
+	}
+
+	static void WriteUint32(uint8_t* target, uint32_t value) {
+		for (int i = 0; i < 4; i++) {
+			target[i] = (value >> (i * 8)) & 0xff;
+		}
+	}
+};
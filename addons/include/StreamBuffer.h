@@ -0,0 +1,201 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "SampleSource.h"
+
+// A growable, single-producer single-consumer sample buffer.
+//
+// The producer (the JavaScript thread) appends chunks of interleaved samples, which are copied
+// into newly allocated nodes of a linked list. The consumer (the audio thread) reads from the list
+// without locking, allocating or freeing any memory. Nodes that were fully consumed are freed by the
+// producer, on its next call to `Append`, or when the buffer is destroyed.
+class StreamBuffer : public SampleSource {
+private:
+	struct Node {
+		int16_t* samples;
+		int64_t sampleCount;
+		std::atomic<Node*> next;
+	};
+
+	// Consumer side
+	std::atomic<Node*> tail; // Last node that was fully consumed (initially a dummy node)
+	int64_t readOffset = 0; // Read offset within the node following `tail`
+
+	// Producer side
+	Node* head; // Last node appended
+	Node* first; // Oldest node not yet freed
+	std::atomic<int64_t> heldByteCount{0}; // Bytes held by nodes not yet freed
+
+	std::atomic<int64_t> appendedSampleCount{0};
+	std::atomic<int64_t> consumedSampleCount{0};
+	std::atomic<int64_t> discardedSampleCount{0}; // Samples before this position are skipped by the consumer
+	std::atomic<bool> ended{false};
+
+	static Node* CreateNode(const int16_t* samples, int64_t sampleCount) {
+		auto node = new Node();
+
+		node->samples = sampleCount > 0 ? new int16_t[sampleCount] : nullptr;
+		node->sampleCount = sampleCount;
+		node->next.store(nullptr, std::memory_order_relaxed);
+
+		if (sampleCount > 0) {
+			memcpy(node->samples, samples, sampleCount * sizeof(int16_t));
+		}
+
+		return node;
+	}
+
+	static int64_t GetNodeByteCount(const Node* node) {
+		return sizeof(Node) + (node->sampleCount * sizeof(int16_t));
+	}
+
+	static void FreeNode(Node* node) {
+		delete[] node->samples;
+		delete node;
+	}
+
+	void FreeConsumedNodes() {
+		auto currentTail = tail.load(std::memory_order_acquire);
+
+		while (first != currentTail) {
+			auto next = first->next.load(std::memory_order_relaxed);
+
+			heldByteCount.fetch_sub(GetNodeByteCount(first), std::memory_order_relaxed);
+
+			FreeNode(first);
+
+			first = next;
+		}
+	}
+
+public:
+	StreamBuffer() {
+		auto dummy = CreateNode(nullptr, 0);
+
+		tail.store(dummy, std::memory_order_relaxed);
+		head = dummy;
+		first = dummy;
+
+		heldByteCount.store(GetNodeByteCount(dummy), std::memory_order_relaxed);
+	}
+
+	~StreamBuffer() {
+		while (first != nullptr) {
+			auto next = first->next.load(std::memory_order_relaxed);
+
+			FreeNode(first);
+
+			first = next;
+		}
+	}
+
+	// Producer only
+	void Append(const int16_t* samples, int64_t sampleCount) {
+		FreeConsumedNodes();
+
+		if (sampleCount <= 0) {
+			return;
+		}
+
+		auto node = CreateNode(samples, sampleCount);
+
+		heldByteCount.fetch_add(GetNodeByteCount(node), std::memory_order_relaxed);
+
+		head->next.store(node, std::memory_order_release);
+		head = node;
+
+		appendedSampleCount.fetch_add(sampleCount, std::memory_order_release);
+	}
+
+	// Producer only.
+	//
+	// Discards all samples appended so far. The consumer skips them on its next read.
+	void Discard() {
+		discardedSampleCount.store(appendedSampleCount.load(std::memory_order_relaxed), std::memory_order_release);
+	}
+
+	// Producer only
+	void End() {
+		ended.store(true, std::memory_order_release);
+	}
+
+	// Consumer only
+	int64_t Read(int16_t* target, int64_t sampleCount) override {
+		auto samplesToSkip = discardedSampleCount.load(std::memory_order_acquire) - consumedSampleCount.load(std::memory_order_relaxed);
+
+		if (samplesToSkip > 0) {
+			Skip(samplesToSkip);
+		}
+
+		return Consume(target, sampleCount);
+	}
+
+	// Consumer only.
+	//
+	// Skips up to `sampleCount` samples, and returns the number of samples skipped.
+	int64_t Skip(int64_t sampleCount) {
+		return Consume(nullptr, sampleCount);
+	}
+
+	int64_t GetReadOffset() const override {
+		return consumedSampleCount.load(std::memory_order_acquire);
+	}
+
+	// Returns true if `End` was called and all appended samples were consumed
+	bool IsExhausted() const override {
+		return ended.load(std::memory_order_acquire) && GetQueuedSampleCount() == 0;
+	}
+
+	int64_t GetHeldByteCount() const override {
+		return sizeof(StreamBuffer) + heldByteCount.load(std::memory_order_relaxed);
+	}
+
+	bool IsEnded() const {
+		return ended.load(std::memory_order_acquire);
+	}
+
+	int64_t GetQueuedSampleCount() const {
+		return appendedSampleCount.load(std::memory_order_acquire) - consumedSampleCount.load(std::memory_order_acquire);
+	}
+
+private:
+	// Consumes up to `sampleCount` samples, copying them to `target`, if given
+	int64_t Consume(int16_t* target, int64_t sampleCount) {
+		int64_t samplesRead = 0;
+
+		while (samplesRead < sampleCount) {
+			auto currentTail = tail.load(std::memory_order_relaxed);
+			auto node = currentTail->next.load(std::memory_order_acquire);
+
+			if (node == nullptr) {
+				break;
+			}
+
+			auto samplesRemainingInNode = node->sampleCount - readOffset;
+			auto samplesToCopy = std::min(samplesRemainingInNode, sampleCount - samplesRead);
+
+			if (target != nullptr) {
+				memcpy(target + samplesRead, node->samples + readOffset, samplesToCopy * sizeof(int16_t));
+			}
+
+			samplesRead += samplesToCopy;
+			readOffset += samplesToCopy;
+
+			// If the node was fully consumed, advance to it, and allow the producer to free the previous one
+			if (readOffset == node->sampleCount) {
+				readOffset = 0;
+
+				tail.store(node, std::memory_order_release);
+			}
+		}
+
+		consumedSampleCount.fetch_add(samplesRead, std::memory_order_release);
+
+		return samplesRead;
+	}
+};
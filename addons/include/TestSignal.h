@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+// Test signals used for latency calibration
+
+// Feedback masks of maximal-length Galois LFSRs, indexed by order
+const uint32_t mlsFeedbackMasks[] = {
+	0, 0,
+	0x3, 0x6, 0xC, 0x14, 0x30, 0x60, 0xB8, 0x110, 0x240,
+	0x500, 0x829, 0x100D, 0x2015, 0x6000, 0xD008, 0x12000, 0x20400, 0x40023, 0x90000,
+};
+
+const int minMlsOrder = 2;
+const int maxMlsOrder = 20;
+
+// Generates a maximum length sequence of the given order (2^order - 1 samples), with values of +amplitude or -amplitude.
+// Its circular autocorrelation is a single peak, so its offset within a recording can be found to the sample.
+void GenerateMaximumLengthSequence(int order, int16_t amplitude, std::vector<int16_t>& result) {
+	auto length = (int64_t(1) << order) - 1;
+	auto feedbackMask = mlsFeedbackMasks[order];
+
+	result.resize(length);
+
+	uint32_t state = 1;
+
+	for (int64_t i = 0; i < length; i++) {
+		auto outputBit = state & 1;
+
+		state >>= 1;
+
+		if (outputBit) {
+			state ^= feedbackMask;
+		}
+
+		result[i] = outputBit ? amplitude : int16_t(-amplitude);
+	}
+}
+
+// Generates a train of single sample impulses, every `interval` samples, starting at sample 0
+void GenerateImpulseTrain(int64_t length, int64_t interval, int16_t amplitude, std::vector<int16_t>& result) {
+	result.assign(length, 0);
+
+	for (int64_t i = 0; i < length; i += interval) {
+		result[i] = amplitude;
+	}
+}
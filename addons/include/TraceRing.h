@@ -0,0 +1,204 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Types of trace events. Names are given by `traceEventNames`, in the same order.
+enum class TraceEventType : int64_t {
+	Wait = 0, // Waiting for the device buffer to drain
+	HandlerDispatch = 1, // From requesting a handler call, to the handler being called
+	Handler = 2, // Handler call
+	Write = 3, // Writing to the device
+	Underrun = 4, // Instant event
+	Recover = 5, // Recovering from an underrun
+	Flush = 6,
+	Pause = 7,
+	Resume = 8,
+	Seek = 9,
+	Drain = 10, // Waiting for queued frames to play, when disposing
+	HandlerRoundTrip = 11, // From requesting a handler call, to the output thread resuming after it returned
+	Conceal = 12, // Writing a period of silence while waiting for a late handler
+};
+
+const char* const traceEventNames[] = {
+	"wait",
+	"handlerDispatch",
+	"handler",
+	"write",
+	"underrun",
+	"recover",
+	"flush",
+	"pause",
+	"resume",
+	"seek",
+	"drain",
+	"handlerRoundTrip",
+	"conceal",
+};
+
+// A fixed-size binary trace event. Instant events have a duration of -1.
+struct TraceEvent {
+	TraceEventType type;
+	int64_t threadId;
+	int64_t startTime; // Monotonic time, in nanoseconds
+	int64_t duration; // In nanoseconds
+	int64_t argument; // Event specific, like a frame count
+};
+
+const int traceEventFieldCount = 5;
+
+// Whether trace events are recorded. Can be toggled at any time, from any thread.
+std::atomic<bool> tracingEnabled{false};
+
+// A single-producer single-consumer ring of trace events, owned by a single output thread.
+//
+// The producer never blocks or allocates. If the ring is full, new events are dropped and counted.
+class TraceRing {
+public:
+	static const int64_t capacity = 8192; // Must be a power of 2
+
+private:
+	TraceEvent events[capacity];
+
+	std::atomic<int64_t> writeIndex{0};
+	std::atomic<int64_t> readIndex{0};
+	std::atomic<int64_t> droppedEventCount{0};
+
+	std::atomic<bool> retired{false};
+
+public:
+	int64_t threadId = 0;
+
+	// Producer only
+	void Record(TraceEventType type, int64_t startTime, int64_t duration, int64_t argument) {
+		auto currentWriteIndex = writeIndex.load(std::memory_order_relaxed);
+
+		if (currentWriteIndex - readIndex.load(std::memory_order_acquire) >= capacity) {
+			droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+
+			return;
+		}
+
+		events[currentWriteIndex & (capacity - 1)] = { type, threadId, startTime, duration, argument };
+
+		writeIndex.store(currentWriteIndex + 1, std::memory_order_release);
+	}
+
+	// Producer only. Marks the ring as no longer written to.
+	void Retire() {
+		retired.store(true, std::memory_order_release);
+	}
+
+	bool IsRetired() const {
+		return retired.load(std::memory_order_acquire);
+	}
+
+	bool IsEmpty() const {
+		return readIndex.load(std::memory_order_acquire) == writeIndex.load(std::memory_order_acquire);
+	}
+
+	// Consumer only. Appends all recorded events to the given vector.
+	void Drain(std::vector<TraceEvent>& target) {
+		auto currentReadIndex = readIndex.load(std::memory_order_relaxed);
+		auto currentWriteIndex = writeIndex.load(std::memory_order_acquire);
+
+		while (currentReadIndex < currentWriteIndex) {
+			target.push_back(events[currentReadIndex & (capacity - 1)]);
+
+			currentReadIndex++;
+		}
+
+		readIndex.store(currentReadIndex, std::memory_order_release);
+	}
+
+	int64_t GetDroppedEventCount() const {
+		return droppedEventCount.load(std::memory_order_relaxed);
+	}
+};
+
+// Registry of the trace rings of all output threads. Only locked when a ring is added or retired, or when draining,
+// never when recording.
+class TraceRegistry {
+private:
+	std::mutex mutex;
+	std::vector<TraceRing*> rings;
+	int64_t droppedEventCount = 0; // Dropped events of rings that were deleted
+
+public:
+	TraceRing* CreateRing(int64_t threadId) {
+		auto ring = new TraceRing();
+		ring->threadId = threadId;
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		rings.push_back(ring);
+
+		return ring;
+	}
+
+	// Called by the producer of a ring, once it stops recording. If all of the ring's events were drained,
+	// it's deleted right away. Otherwise, it's deleted after its remaining events are drained.
+	void RetireRing(TraceRing* ring) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		ring->Retire();
+
+		if (ring->IsEmpty()) {
+			droppedEventCount += ring->GetDroppedEventCount();
+
+			rings.erase(std::find(rings.begin(), rings.end(), ring));
+
+			delete ring;
+		}
+	}
+
+	// Drains the events of all rings, sorted by start time, and deletes the rings that were retired
+	std::vector<TraceEvent> Drain() {
+		std::vector<TraceEvent> result;
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (auto it = rings.begin(); it != rings.end();) {
+			auto ring = *it;
+
+			// Check before draining, so events recorded before retiring are never lost
+			auto isRetired = ring->IsRetired();
+
+			ring->Drain(result);
+
+			if (isRetired) {
+				droppedEventCount += ring->GetDroppedEventCount();
+
+				delete ring;
+
+				it = rings.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		std::sort(result.begin(), result.end(), [](const TraceEvent& a, const TraceEvent& b) {
+			return a.startTime < b.startTime;
+		});
+
+		return result;
+	}
+
+	int64_t GetDroppedEventCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto total = droppedEventCount;
+
+		for (auto ring : rings) {
+			total += ring->GetDroppedEventCount();
+		}
+
+		return total;
+	}
+};
+
+TraceRegistry traceRegistry;
@@ -0,0 +1,406 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <alsa/asoundlib.h>
+#include <alsa/pcm_external.h>
+
+#include "AlsaOutputBackend.h"
+
+// A stall of the virtual device: its hardware pointer stops advancing for `duration`, starting at `time`,
+// both in nanoseconds, relative to when the device was first started
+struct VirtualDeviceStall {
+	int64_t time = 0;
+	int64_t duration = 0;
+};
+
+struct VirtualDeviceOptions {
+	int64_t periodFrameCount = 0; // 0 selects 10ms
+	int64_t bufferFrameCount = 0; // 0 selects 4 periods, or 4 writes of the engine, whichever is larger
+	double clockRate = 1.0; // Rate of the device clock, relative to the monotonic clock
+
+	std::vector<VirtualDeviceStall> stalls;
+
+	// Times at which an xrun is reported, regardless of how many frames are queued, in nanoseconds,
+	// relative to when the device was first started
+	std::vector<int64_t> xrunTimes;
+
+	// Buffer receiving the frames written to the device, in the order they were received, or null.
+	// Frames beyond its capacity are counted, but not recorded.
+	int16_t* recordBuffer = nullptr;
+	int64_t recordBufferFrameCount = 0;
+};
+
+struct VirtualDeviceStats {
+	int64_t receivedFrameCount = 0; // Frames written to the device, including frames later rewound or dropped
+	int64_t recordedFrameCount = 0;
+	int64_t startCount = 0;
+	int64_t stallCount = 0; // Injected stalls that have begun
+	int64_t injectedXrunCount = 0;
+	int64_t underrunCount = 0; // Xruns caused by the buffer running empty
+};
+
+// Output backend playing through a virtual sound card, implemented as an ALSA I/O plugin (ioplug) PCM, created
+// within the process. Since it's driven through the ALSA API, exactly like the default device, the engine's use of
+// ALSA (including `snd_pcm_avail_delay`, `snd_pcm_recover`, rewinding and draining) can be tested without hardware.
+//
+// The hardware pointer advances by whole periods, as measured by the monotonic clock, scaled by the device's clock
+// rate. An underrun occurs if it reaches the end of the queued frames while running. Stalls, during which the pointer
+// doesn't advance, and xruns can be injected at given times. The poll descriptor is a timer firing once per period.
+class VirtualAlsaOutputBackend : public AlsaOutputBackend {
+private:
+	VirtualDeviceOptions options;
+
+	snd_pcm_ioplug_t ioplug;
+	snd_pcm_ioplug_callback_t callbacks;
+	int timerFd = -1;
+
+	int64_t deviceSampleRate = 0;
+	int64_t deviceChannelCount = 0;
+	int64_t devicePeriodFrameCount = 0;
+	int64_t deviceBufferFrameCount = 0;
+
+	// Hardware position, in frames since the device was last prepared. While running, it advances from
+	// `positionAtRunStart`, starting at `runStartTime`.
+	int64_t position = 0;
+	int64_t positionAtRunStart = 0;
+	int64_t runStartTime = 0;
+	int64_t firstStartTime = -1;
+	bool isRunning = false;
+	bool isDraining = false;
+	size_t nextXrunIndex = 0;
+
+	// Read from the JavaScript thread
+	std::atomic<int64_t> receivedFrameCount { 0 };
+	std::atomic<int64_t> startCount { 0 };
+	std::atomic<int64_t> stallCount { 0 };
+	std::atomic<int64_t> injectedXrunCount { 0 };
+	std::atomic<int64_t> underrunCount { 0 };
+
+public:
+	VirtualAlsaOutputBackend(const VirtualDeviceOptions& options) : options(options) {
+	}
+
+	VirtualDeviceStats GetStats() const {
+		VirtualDeviceStats stats;
+
+		stats.receivedFrameCount = this->receivedFrameCount;
+		stats.recordedFrameCount = std::min(stats.receivedFrameCount, this->options.recordBufferFrameCount);
+		stats.startCount = this->startCount;
+		stats.stallCount = this->stallCount;
+		stats.injectedXrunCount = this->injectedXrunCount;
+		stats.underrunCount = this->underrunCount;
+
+		return stats;
+	}
+
+protected:
+	int OpenDevice(int64_t requestedSampleRate, int64_t channelCount, int64_t writeFrameCount) override {
+		int err;
+
+		this->deviceSampleRate = requestedSampleRate;
+		this->deviceChannelCount = channelCount;
+
+		this->devicePeriodFrameCount = this->options.periodFrameCount > 0 ? this->options.periodFrameCount : std::max(requestedSampleRate / 100, int64_t(1));
+
+		auto minimumBufferFrameCount = this->options.bufferFrameCount > 0 ? this->options.bufferFrameCount : std::max(writeFrameCount * 4, this->devicePeriodFrameCount * 4);
+
+		this->deviceBufferFrameCount = ((minimumBufferFrameCount + this->devicePeriodFrameCount - 1) / this->devicePeriodFrameCount) * this->devicePeriodFrameCount;
+
+		// The poll descriptor becomes readable once per period, like the interrupt of a sound card
+		this->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+		if (this->timerFd < 0) {
+			return -errno;
+		}
+
+		auto periodDuration = (this->devicePeriodFrameCount * 1000000000) / requestedSampleRate;
+
+		itimerspec timerSpec;
+		timerSpec.it_interval.tv_sec = periodDuration / 1000000000;
+		timerSpec.it_interval.tv_nsec = periodDuration % 1000000000;
+		timerSpec.it_value = timerSpec.it_interval;
+
+		timerfd_settime(this->timerFd, 0, &timerSpec, nullptr);
+
+		memset(&this->callbacks, 0, sizeof(this->callbacks));
+
+		this->callbacks.start = OnStart;
+		this->callbacks.stop = OnStop;
+		this->callbacks.pointer = OnPointer;
+		this->callbacks.transfer = OnTransfer;
+		this->callbacks.close = OnClose;
+		this->callbacks.prepare = OnPrepare;
+		this->callbacks.drain = OnDrain;
+		this->callbacks.pause = OnPause;
+		this->callbacks.poll_revents = OnPollRevents;
+
+		memset(&this->ioplug, 0, sizeof(this->ioplug));
+
+		this->ioplug.version = SND_PCM_IOPLUG_VERSION;
+		this->ioplug.name = "Virtual audio device";
+		this->ioplug.flags = SND_PCM_IOPLUG_FLAG_MONOTONIC;
+		this->ioplug.mmap_rw = 0;
+		this->ioplug.poll_fd = this->timerFd;
+		this->ioplug.poll_events = POLLIN;
+		this->ioplug.callback = &this->callbacks;
+		this->ioplug.private_data = this;
+
+		err = snd_pcm_ioplug_create(&this->ioplug, "virtual", SND_PCM_STREAM_PLAYBACK, 0);
+
+		if (err < 0) {
+			close(this->timerFd);
+			this->timerFd = -1;
+
+			return err;
+		}
+
+		// Only allow the exact configuration of the device
+		unsigned int accessList[] = { SND_PCM_ACCESS_RW_INTERLEAVED };
+		unsigned int formatList[] = { SND_PCM_FORMAT_S16_LE };
+
+		auto frameByteCount = static_cast<unsigned int>(channelCount * 2);
+		auto periodByteCount = static_cast<unsigned int>(this->devicePeriodFrameCount) * frameByteCount;
+		auto bufferByteCount = static_cast<unsigned int>(this->deviceBufferFrameCount) * frameByteCount;
+		auto periodCount = static_cast<unsigned int>(this->deviceBufferFrameCount / this->devicePeriodFrameCount);
+
+		if ((err = snd_pcm_ioplug_set_param_list(&this->ioplug, SND_PCM_IOPLUG_HW_ACCESS, 1, accessList)) < 0 ||
+			(err = snd_pcm_ioplug_set_param_list(&this->ioplug, SND_PCM_IOPLUG_HW_FORMAT, 1, formatList)) < 0 ||
+			(err = snd_pcm_ioplug_set_param_minmax(&this->ioplug, SND_PCM_IOPLUG_HW_CHANNELS, channelCount, channelCount)) < 0 ||
+			(err = snd_pcm_ioplug_set_param_minmax(&this->ioplug, SND_PCM_IOPLUG_HW_RATE, requestedSampleRate, requestedSampleRate)) < 0 ||
+			(err = snd_pcm_ioplug_set_param_minmax(&this->ioplug, SND_PCM_IOPLUG_HW_PERIOD_BYTES, periodByteCount, periodByteCount)) < 0 ||
+			(err = snd_pcm_ioplug_set_param_minmax(&this->ioplug, SND_PCM_IOPLUG_HW_BUFFER_BYTES, bufferByteCount, bufferByteCount)) < 0 ||
+			(err = snd_pcm_ioplug_set_param_minmax(&this->ioplug, SND_PCM_IOPLUG_HW_PERIODS, periodCount, periodCount)) < 0) {
+
+			// Also closes the timer, through the close callback
+			snd_pcm_ioplug_delete(&this->ioplug);
+
+			return err;
+		}
+
+		this->pcmHandle = this->ioplug.pcm;
+
+		return 0;
+	}
+
+private:
+	static VirtualAlsaOutputBackend* GetDevice(snd_pcm_ioplug_t* io) {
+		return static_cast<VirtualAlsaOutputBackend*>(io->private_data);
+	}
+
+	static int OnStart(snd_pcm_ioplug_t* io) {
+		GetDevice(io)->Start();
+
+		return 0;
+	}
+
+	static int OnStop(snd_pcm_ioplug_t* io) {
+		auto device = GetDevice(io);
+
+		device->isRunning = false;
+		device->isDraining = false;
+
+		return 0;
+	}
+
+	static snd_pcm_sframes_t OnPointer(snd_pcm_ioplug_t* io) {
+		return GetDevice(io)->UpdatePointer();
+	}
+
+	static snd_pcm_sframes_t OnTransfer(snd_pcm_ioplug_t* io, const snd_pcm_channel_area_t* areas, snd_pcm_uframes_t offset, snd_pcm_uframes_t size) {
+		// Interleaved, so the first area holds all channels
+		auto samples = reinterpret_cast<const int16_t*>(static_cast<const char*>(areas[0].addr) + ((areas[0].first + (areas[0].step * offset)) / 8));
+
+		GetDevice(io)->Record(samples, size);
+
+		return size;
+	}
+
+	static int OnClose(snd_pcm_ioplug_t* io) {
+		auto device = GetDevice(io);
+
+		if (device->timerFd >= 0) {
+			close(device->timerFd);
+			device->timerFd = -1;
+		}
+
+		return 0;
+	}
+
+	static int OnPrepare(snd_pcm_ioplug_t* io) {
+		auto device = GetDevice(io);
+
+		device->position = 0;
+		device->isRunning = false;
+		device->isDraining = false;
+
+		return 0;
+	}
+
+	// Blocks until all queued frames were played. Depending on the ALSA version, the stream is then either
+	// stopped by ALSA, or by the plugin layer once it sees the buffer is empty.
+	static int OnDrain(snd_pcm_ioplug_t* io) {
+		auto device = GetDevice(io);
+
+		device->isDraining = true;
+
+		if (!device->isRunning) {
+			device->Start();
+		}
+
+		device->UpdatePointer();
+
+		while (device->position < device->GetQueuedEnd()) {
+			SleepFor(std::max((device->devicePeriodFrameCount * 1000000000) / (device->deviceSampleRate * 4), int64_t(100000)));
+
+			device->UpdatePointer();
+		}
+
+		return 0;
+	}
+
+	static int OnPause(snd_pcm_ioplug_t* io, int enable) {
+		auto device = GetDevice(io);
+
+		if (enable) {
+			device->UpdatePointer();
+			device->isRunning = false;
+		} else {
+			device->positionAtRunStart = device->position;
+			device->runStartTime = GetTime();
+			device->isRunning = true;
+		}
+
+		return 0;
+	}
+
+	static int OnPollRevents(snd_pcm_ioplug_t* io, struct pollfd* descriptors, unsigned int descriptorCount, unsigned short* events) {
+		uint64_t expirationCount;
+		auto result = read(GetDevice(io)->timerFd, &expirationCount, sizeof(expirationCount));
+		(void)result;
+
+		// ALSA checks the available frame count itself, and polls again if there isn't enough room
+		*events = (descriptorCount > 0 && (descriptors[0].revents & POLLIN)) ? POLLOUT : 0;
+
+		return 0;
+	}
+
+	void Start() {
+		auto currentTime = GetTime();
+
+		if (this->firstStartTime < 0) {
+			this->firstStartTime = currentTime;
+		}
+
+		this->positionAtRunStart = this->position;
+		this->runStartTime = currentTime;
+		this->isRunning = true;
+
+		this->startCount++;
+	}
+
+	// End of the frames queued since the device was last prepared
+	int64_t GetQueuedEnd() const {
+		return static_cast<int64_t>(this->ioplug.appl_ptr);
+	}
+
+	// Advances the hardware position, and returns it within the buffer, or -EPIPE on xrun
+	snd_pcm_sframes_t UpdatePointer() {
+		if (this->isRunning) {
+			auto currentTime = GetTime();
+			auto elapsedTime = currentTime - this->firstStartTime;
+
+			// Injected xruns are each reported once. None are reported while draining.
+			if (!this->isDraining && this->nextXrunIndex < this->options.xrunTimes.size() && elapsedTime >= this->options.xrunTimes[this->nextXrunIndex]) {
+				this->nextXrunIndex++;
+				this->injectedXrunCount++;
+				this->isRunning = false;
+
+				return -EPIPE;
+			}
+
+			int64_t beganStallCount = 0;
+
+			for (auto& stall : this->options.stalls) {
+				if (stall.time <= elapsedTime) {
+					beganStallCount++;
+				}
+			}
+
+			this->stallCount = beganStallCount;
+
+			auto playedDuration = double(this->GetUnstalledTime(currentTime) - this->GetUnstalledTime(this->runStartTime)) * this->options.clockRate;
+			auto playedFrameCount = static_cast<int64_t>((playedDuration * double(this->deviceSampleRate)) / 1000000000.0);
+			auto targetPosition = this->positionAtRunStart + ((playedFrameCount / this->devicePeriodFrameCount) * this->devicePeriodFrameCount);
+
+			auto queuedEnd = this->GetQueuedEnd();
+
+			if (targetPosition >= queuedEnd) {
+				this->position = queuedEnd;
+
+				if (!this->isDraining) {
+					this->underrunCount++;
+					this->isRunning = false;
+
+					return -EPIPE;
+				}
+			} else {
+				this->position = targetPosition;
+			}
+		}
+
+		return this->position % this->deviceBufferFrameCount;
+	}
+
+	// Time elapsed since the device was first started, up to the given time, excluding stalls
+	int64_t GetUnstalledTime(int64_t time) const {
+		auto elapsedTime = time - this->firstStartTime;
+		auto result = elapsedTime;
+
+		for (auto& stall : this->options.stalls) {
+			auto overlapStart = std::min(stall.time, elapsedTime);
+			auto overlapEnd = std::min(stall.time + stall.duration, elapsedTime);
+
+			result -= overlapEnd - overlapStart;
+		}
+
+		return result;
+	}
+
+	void Record(const int16_t* samples, int64_t frameCount) {
+		auto frameOffset = this->receivedFrameCount.load();
+		auto recordedFrameCount = std::min(frameCount, std::max(this->options.recordBufferFrameCount - frameOffset, int64_t(0)));
+
+		if (recordedFrameCount > 0) {
+			memcpy(this->options.recordBuffer + (frameOffset * this->deviceChannelCount), samples, recordedFrameCount * this->deviceChannelCount * sizeof(int16_t));
+		}
+
+		this->receivedFrameCount = frameOffset + frameCount;
+	}
+
+	static int64_t GetTime() {
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC, &time);
+
+		return (int64_t(time.tv_sec) * 1000000000) + time.tv_nsec;
+	}
+
+	static void SleepFor(int64_t duration) {
+		timespec time;
+
+		time.tv_sec = duration / 1000000000;
+		time.tv_nsec = duration % 1000000000;
+
+		nanosleep(&time, nullptr);
+	}
+};
@@ -0,0 +1,455 @@
+// Microbenchmark of the sample processing kernels in `include/SampleKernels.h`. Doesn't depend on Node.js.
+//
+// For each kernel, and each of its implementations (scalar, and SSE2 or NEON where available), measures the
+// throughput, in frames per second, and the CPU cycles per frame, for period sizes from 32 to 4096 stereo frames.
+// Before measuring, checks that every SIMD implementation produces the same results as the scalar one.
+//
+// Cycles are counted with `perf_event_open` on Linux, when permitted. Otherwise, on x64, the time stamp counter is
+// used, which counts at a constant reference rate, rather than the current core clock rate.
+//
+// Build with `npm run build-kernel-benchmark`, in the `addons` directory, then run `build/kernel-benchmark`.
+// An optional argument gives the minimum duration of each measurement, in milliseconds (defaults to 20).
+// Results are written to stdout, as JSON.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#endif
+
+#include "../include/SampleKernels.h"
+
+namespace {
+	const int64_t channelCount = 2;
+	const int64_t periodFrameCounts[] = { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+	const int64_t maxPeriodFrameCount = 4096;
+
+	// Resampling step, from 44100Hz to 48000Hz
+	const double resampleStep = 44100.0 / 48000.0;
+
+	// Number of timed runs per measurement. The fastest is reported.
+	const int runCount = 5;
+
+	int64_t getMonotonicTime() {
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC, &time);
+
+		return (int64_t(time.tv_sec) * 1000000000) + time.tv_nsec;
+	}
+
+	// Counts CPU cycles of the calling thread
+	class CycleCounter {
+	private:
+		int perfFileDescriptor = -1;
+		const char* source = "none";
+
+	public:
+		CycleCounter() {
+#if defined(__linux__)
+			perf_event_attr attributes;
+			memset(&attributes, 0, sizeof(attributes));
+
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.size = sizeof(attributes);
+			attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+
+			this->perfFileDescriptor = int(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+
+			if (this->perfFileDescriptor >= 0) {
+				this->source = "perf";
+
+				return;
+			}
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+			this->source = "tsc";
+#endif
+		}
+
+		~CycleCounter() {
+#if defined(__linux__)
+			if (this->perfFileDescriptor >= 0) {
+				close(this->perfFileDescriptor);
+			}
+#endif
+		}
+
+		const char* GetSource() const {
+			return this->source;
+		}
+
+		// Returns the current count, or -1 if cycles can't be counted
+		int64_t Read() {
+#if defined(__linux__)
+			if (this->perfFileDescriptor >= 0) {
+				uint64_t count = 0;
+
+				if (read(this->perfFileDescriptor, &count, sizeof(count)) != sizeof(count)) {
+					return -1;
+				}
+
+				return int64_t(count);
+			}
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+			return int64_t(__rdtsc());
+#else
+			return -1;
+#endif
+		}
+	};
+
+	struct KernelVariant {
+		std::string kernel;
+		std::string instructionSet;
+
+		// Processes the given number of frames
+		std::function<void(int64_t)> run;
+	};
+
+	struct Measurement {
+		double framesPerSecond;
+		double cyclesPerFrame; // Negative if not known
+	};
+
+	// Inputs and outputs of the kernels, large enough for the largest period
+	struct KernelBuffers {
+		std::vector<int16_t> int16Input;
+		std::vector<int16_t> int16Input2;
+		std::vector<float> floatInput;
+		std::vector<int16_t> int16Output;
+		std::vector<float> floatOutput;
+		std::vector<int16_t> channels[channelCount];
+		int16_t* channelPointers[channelCount];
+		float channelGains[channelCount] = { 0.7f, 0.3f };
+		uint32_t ditherState = 1;
+
+		KernelBuffers() {
+			auto sampleCount = (maxPeriodFrameCount + 2) * channelCount;
+
+			this->int16Input.resize(sampleCount * 2);
+			this->int16Input2.resize(sampleCount);
+			this->floatInput.resize(sampleCount);
+			this->int16Output.resize(sampleCount);
+			this->floatOutput.resize(sampleCount);
+
+			for (auto& sample : this->int16Input) {
+				sample = int16_t(rand() - (RAND_MAX / 2));
+			}
+
+			for (auto& sample : this->int16Input2) {
+				sample = int16_t(rand() - (RAND_MAX / 2));
+			}
+
+			// Includes values beyond the 16-bit range, to exercise saturation
+			for (auto& sample : this->floatInput) {
+				sample = ((float(rand()) / float(RAND_MAX)) * 80000.0f) - 40000.0f;
+			}
+
+			for (int64_t channelIndex = 0; channelIndex < channelCount; channelIndex++) {
+				this->channels[channelIndex].resize(maxPeriodFrameCount + 2);
+				this->channelPointers[channelIndex] = this->channels[channelIndex].data();
+			}
+		}
+	};
+
+	std::vector<KernelVariant> createKernelVariants(KernelBuffers& buffers) {
+		std::vector<KernelVariant> variants;
+
+		auto addConvertFloatToInt16 = [&](const char* instructionSet, void (*function)(const float*, int16_t*, int64_t)) {
+			variants.push_back({ "convertFloatToInt16", instructionSet, [&buffers, function](int64_t frameCount) {
+				function(buffers.floatInput.data(), buffers.int16Output.data(), frameCount * channelCount);
+			} });
+		};
+
+		auto addConvertInt16ToFloat = [&](const char* instructionSet, void (*function)(const int16_t*, float*, int64_t)) {
+			variants.push_back({ "convertInt16ToFloat", instructionSet, [&buffers, function](int64_t frameCount) {
+				function(buffers.int16Input.data(), buffers.floatOutput.data(), frameCount * channelCount);
+			} });
+		};
+
+		auto addMix = [&](const char* instructionSet, void (*function)(const int16_t*, const float*, int64_t, float*, int64_t)) {
+			variants.push_back({ "mixInt16", instructionSet, [&buffers, function](int64_t frameCount) {
+				function(buffers.int16Input.data(), buffers.channelGains, channelCount, buffers.floatOutput.data(), frameCount);
+			} });
+		};
+
+		auto addMixFloat = [&](const char* instructionSet, void (*function)(const float*, int64_t, const float*, int64_t, float*, int64_t)) {
+			variants.push_back({ "mixFloat", instructionSet, [&buffers, function](int64_t frameCount) {
+				function(buffers.floatInput.data(), channelCount, buffers.channelGains, channelCount, buffers.floatOutput.data(), frameCount);
+			} });
+		};
+
+		auto addAddFloat = [&](const char* instructionSet, void (*function)(const float*, float*, int64_t)) {
+			variants.push_back({ "addFloat", instructionSet, [&buffers, function](int64_t frameCount) {
+				function(buffers.floatInput.data(), buffers.floatOutput.data(), frameCount * channelCount);
+			} });
+		};
+
+		addConvertFloatToInt16("scalar", ConvertFloatToInt16Scalar);
+		addConvertInt16ToFloat("scalar", ConvertInt16ToFloatScalar);
+		addMix("scalar", MixInt16Scalar);
+		addMixFloat("scalar", MixFloatScalar);
+		addAddFloat("scalar", AddFloatScalar);
+
+#if defined(SAMPLE_KERNELS_SSE2)
+		addConvertFloatToInt16("sse2", ConvertFloatToInt16Sse2);
+		addConvertInt16ToFloat("sse2", ConvertInt16ToFloatSse2);
+		addMix("sse2", MixInt16Sse2);
+		addMixFloat("sse2", MixFloatSse2);
+		addAddFloat("sse2", AddFloatSse2);
+#endif
+
+#if defined(SAMPLE_KERNELS_NEON)
+		addConvertFloatToInt16("neon", ConvertFloatToInt16Neon);
+		addConvertInt16ToFloat("neon", ConvertInt16ToFloatNeon);
+		addMix("neon", MixInt16Neon);
+		addMixFloat("neon", MixFloatNeon);
+		addAddFloat("neon", AddFloatNeon);
+#endif
+
+		variants.push_back({ "interleaveInt16", "scalar", [&buffers](int64_t frameCount) {
+			const int16_t* channels[channelCount] = { buffers.channelPointers[0], buffers.channelPointers[1] };
+
+			InterleaveInt16(channels, channelCount, buffers.int16Output.data(), frameCount);
+		} });
+
+		variants.push_back({ "deinterleaveInt16", "scalar", [&buffers](int64_t frameCount) {
+			DeinterleaveInt16(buffers.int16Input.data(), channelCount, buffers.channelPointers, frameCount);
+		} });
+
+		variants.push_back({ "crossfadeInt16", "scalar", [&buffers](int64_t frameCount) {
+			CrossfadeInt16(buffers.int16Input.data(), buffers.int16Input2.data(), buffers.int16Output.data(), frameCount, channelCount);
+		} });
+
+		variants.push_back({ "ditherFloatToInt16", "scalar", [&buffers](int64_t frameCount) {
+			DitherFloatToInt16(buffers.floatInput.data(), buffers.int16Output.data(), frameCount * channelCount, buffers.ditherState);
+		} });
+
+		variants.push_back({ "resampleLinearInt16", "scalar", [&buffers](int64_t frameCount) {
+			auto inputFrameCount = int64_t(std::ceil(double(frameCount) * resampleStep)) + 2;
+
+			ResampleLinearInt16(buffers.int16Input.data(), inputFrameCount, channelCount, 0.0, resampleStep, buffers.floatOutput.data(), frameCount);
+		} });
+
+		return variants;
+	}
+
+	Measurement measure(const KernelVariant& variant, int64_t frameCount, int64_t minimumRunTime, CycleCounter& cycleCounter) {
+		// Warm up, and find the number of iterations lasting at least the minimum run time
+		int64_t iterationCount = 1;
+
+		while (true) {
+			auto startTime = getMonotonicTime();
+
+			for (int64_t i = 0; i < iterationCount; i++) {
+				variant.run(frameCount);
+			}
+
+			if (getMonotonicTime() - startTime >= minimumRunTime) {
+				break;
+			}
+
+			iterationCount *= 2;
+		}
+
+		int64_t bestTime = INT64_MAX;
+		int64_t bestCycleCount = -1;
+
+		for (int run = 0; run < runCount; run++) {
+			auto startCycleCount = cycleCounter.Read();
+			auto startTime = getMonotonicTime();
+
+			for (int64_t i = 0; i < iterationCount; i++) {
+				variant.run(frameCount);
+			}
+
+			auto elapsedTime = getMonotonicTime() - startTime;
+			auto endCycleCount = cycleCounter.Read();
+
+			if (elapsedTime < bestTime) {
+				bestTime = elapsedTime;
+				bestCycleCount = startCycleCount >= 0 && endCycleCount >= 0 ? endCycleCount - startCycleCount : -1;
+			}
+		}
+
+		auto totalFrameCount = double(iterationCount * frameCount);
+
+		return {
+			totalFrameCount / (double(bestTime) / 1e9),
+			bestCycleCount >= 0 ? double(bestCycleCount) / totalFrameCount : -1.0,
+		};
+	}
+
+	// Checks that each SIMD implementation matches the scalar one, including for lengths that aren't a multiple
+	// of the vector width. Float results may differ by rounding, if the compiler fuses the scalar multiply-add.
+	bool verifyKernels() {
+#if defined(SAMPLE_KERNELS_SSE2) || defined(SAMPLE_KERNELS_NEON)
+		KernelBuffers buffers;
+
+		auto passed = true;
+
+		auto check = [&passed](const char* kernel, const char* instructionSet, bool matches) {
+			if (!matches) {
+				fprintf(stderr, "FAIL %s (%s) doesn't match the scalar implementation\n", kernel, instructionSet);
+
+				passed = false;
+			}
+		};
+
+		auto floatsMatch = [](const std::vector<float>& a, const std::vector<float>& b) {
+			for (size_t i = 0; i < a.size(); i++) {
+				if (std::fabs(a[i] - b[i]) > std::fabs(a[i]) * 1e-6f + 1e-3f) {
+					return false;
+				}
+			}
+
+			return true;
+		};
+
+		for (int64_t frameCount : { int64_t(1), int64_t(3), int64_t(37), int64_t(256), int64_t(1001) }) {
+			auto sampleCount = frameCount * channelCount;
+
+			std::vector<int16_t> expectedInt16(sampleCount), actualInt16(sampleCount);
+			std::vector<float> expectedFloat(sampleCount, 1.0f), actualFloat(sampleCount, 1.0f);
+
+#if defined(SAMPLE_KERNELS_SSE2)
+			const char* instructionSet = "sse2";
+			auto convertFloatToInt16 = ConvertFloatToInt16Sse2;
+			auto convertInt16ToFloat = ConvertInt16ToFloatSse2;
+			auto mix = MixInt16Sse2;
+			auto mixFloat = MixFloatSse2;
+			auto addFloat = AddFloatSse2;
+#else
+			const char* instructionSet = "neon";
+			auto convertFloatToInt16 = ConvertFloatToInt16Neon;
+			auto convertInt16ToFloat = ConvertInt16ToFloatNeon;
+			auto mix = MixInt16Neon;
+			auto mixFloat = MixFloatNeon;
+			auto addFloat = AddFloatNeon;
+#endif
+
+			ConvertFloatToInt16Scalar(buffers.floatInput.data(), expectedInt16.data(), sampleCount);
+			convertFloatToInt16(buffers.floatInput.data(), actualInt16.data(), sampleCount);
+			check("convertFloatToInt16", instructionSet, expectedInt16 == actualInt16);
+
+			ConvertInt16ToFloatScalar(buffers.int16Input.data(), expectedFloat.data(), sampleCount);
+			convertInt16ToFloat(buffers.int16Input.data(), actualFloat.data(), sampleCount);
+			check("convertInt16ToFloat", instructionSet, expectedFloat == actualFloat);
+
+			AddFloatScalar(buffers.floatInput.data(), expectedFloat.data(), sampleCount);
+			addFloat(buffers.floatInput.data(), actualFloat.data(), sampleCount);
+			check("addFloat", instructionSet, expectedFloat == actualFloat);
+
+			for (int64_t mixChannelCount : { int64_t(1), int64_t(2) }) {
+				auto mixFrameCount = sampleCount / mixChannelCount;
+
+				std::fill(expectedFloat.begin(), expectedFloat.end(), 1.0f);
+				std::fill(actualFloat.begin(), actualFloat.end(), 1.0f);
+
+				MixInt16Scalar(buffers.int16Input.data(), buffers.channelGains, mixChannelCount, expectedFloat.data(), mixFrameCount);
+				mix(buffers.int16Input.data(), buffers.channelGains, mixChannelCount, actualFloat.data(), mixFrameCount);
+				check("mixInt16", instructionSet, floatsMatch(expectedFloat, actualFloat));
+
+				std::fill(expectedFloat.begin(), expectedFloat.end(), 1.0f);
+				std::fill(actualFloat.begin(), actualFloat.end(), 1.0f);
+
+				MixFloatScalar(buffers.floatInput.data(), mixChannelCount, buffers.channelGains, mixChannelCount, expectedFloat.data(), mixFrameCount);
+				mixFloat(buffers.floatInput.data(), mixChannelCount, buffers.channelGains, mixChannelCount, actualFloat.data(), mixFrameCount);
+				check("mixFloat", instructionSet, floatsMatch(expectedFloat, actualFloat));
+			}
+		}
+
+		return passed;
+#else
+		return true;
+#endif
+	}
+}
+
+int main(int argc, char** argv) {
+	auto minimumRunTime = int64_t(argc > 1 ? atof(argv[1]) * 1000000.0 : 20000000.0);
+
+	if (minimumRunTime <= 0) {
+		fprintf(stderr, "The minimum run time must be a positive number of milliseconds\n");
+
+		return 1;
+	}
+
+	if (!verifyKernels()) {
+		return 1;
+	}
+
+	KernelBuffers buffers;
+	CycleCounter cycleCounter;
+
+	auto variants = createKernelVariants(buffers);
+
+#if defined(__x86_64__) || defined(_M_X64)
+	const char* arch = "x64";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	const char* arch = "arm64";
+#else
+	const char* arch = "unknown";
+#endif
+
+	printf("{\n");
+	printf("  \"arch\": \"%s\",\n", arch);
+	printf("  \"compiler\": \"%s\",\n", __VERSION__);
+	printf("  \"defaultInstructionSet\": \"%s\",\n", GetSampleKernelInstructionSet());
+	printf("  \"cycleCounter\": \"%s\",\n", cycleCounter.GetSource());
+	printf("  \"channelCount\": %d,\n", int(channelCount));
+	printf("  \"results\": [\n");
+
+	auto isFirstResult = true;
+
+	for (auto& variant : variants) {
+		fprintf(stderr, "%s (%s)..\n", variant.kernel.c_str(), variant.instructionSet.c_str());
+
+		for (auto periodFrameCount : periodFrameCounts) {
+			auto measurement = measure(variant, periodFrameCount, minimumRunTime, cycleCounter);
+
+			char cyclesPerFrame[32];
+
+			if (measurement.cyclesPerFrame >= 0) {
+				snprintf(cyclesPerFrame, sizeof(cyclesPerFrame), "%.3f", measurement.cyclesPerFrame);
+			} else {
+				snprintf(cyclesPerFrame, sizeof(cyclesPerFrame), "null");
+			}
+
+			printf("%s    { \"kernel\": \"%s\", \"instructionSet\": \"%s\", \"periodFrameCount\": %d, \"framesPerSecond\": %.0f, \"cyclesPerFrame\": %s }",
+				isFirstResult ? "" : ",\n",
+				variant.kernel.c_str(),
+				variant.instructionSet.c_str(),
+				int(periodFrameCount),
+				measurement.framesPerSecond,
+				cyclesPerFrame);
+
+			isFirstResult = false;
+		}
+	}
+
+	printf("\n  ]\n}\n");
+
+	return 0;
+}
@@ -1,23 +1,400 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <unistd.h>
+#include <time.h>
+#include <semaphore.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
 
 #include <string>
-#include <sstream>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <mutex>
 
 #include <alsa/asoundlib.h>
 #include <napi.h>
+#include <uv.h>
 
 #include "../include/Signal.h"
+#include "../include/StreamBuffer.h"
+#include "../include/ClipBuffer.h"
+#include "../include/Mixer.h"
+#include "../include/PlaybackPosition.h"
+#include "../include/SharedStatus.h"
+#include "../include/OutputStats.h"
+#include "../include/TraceRing.h"
+#include "../include/Probes.h"
+#include "../include/RealtimeGuard.h"
+#include "../include/OutputBackend.h"
+#include "../include/AlsaOutputBackend.h"
+#include "../include/SimulatedOutputBackend.h"
+#include "../include/VirtualAlsaOutputBackend.h"
+#include "../include/AlsaCapture.h"
+#include "../include/TestSignal.h"
+#include "../include/CrossCorrelation.h"
+#include "../include/SampleKernels.h"
 #include "../include/Utils.h"
 
+// Determines what happens to frames already queued in the ALSA buffer when the output is stopped
+enum class StopMode {
+	Drain = 0, // Play all queued frames
+	Drop = 1, // Discard all queued frames immediately
+	Fade = 2, // Discard queued frames, after a short fade-out
+};
+
+// Duration of the fade-out applied when stopping or flushing in fade mode
+const double fadeOutDuration = 10.0; // 10ms
+
+// Duration of audio, immediately after the hardware position, that is never rewound,
+// since it may have already been fetched by the device
+const double rewindSafetyDuration = 2.0; // 2ms
+
+// Work requested from the JavaScript thread by the output thread, as flags of `pendingAsyncWork`
+enum AsyncWorkFlags {
+	CallHandlerWork = 1,
+	SendMarkerEventWork = 2,
+	MixerSourceEndedWork = 4,
+};
+
+// Interval at which the output thread, while waiting for the handler, checks if it should stop waiting
+const int64_t handlerWaitCheckInterval = 10 * 1000000; // 10ms
+
+// Returns the current time of the monotonic clock, in nanoseconds.
+// This is the same clock used by Node.js for `process.hrtime`.
+int64_t getMonotonicTime() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return (int64_t(time.tv_sec) * 1000000000) + time.tv_nsec;
+}
+
+// Converts a histogram to a JavaScript object, with its count, sum, maximum, and bucket counts
+Napi::Object CreateHistogramObject(Napi::Env env, const LogHistogram& histogram) {
+	auto result = Napi::Object::New(env);
+	auto buckets = Napi::Array::New(env, LogHistogram::bucketCount);
+
+	for (int i = 0; i < LogHistogram::bucketCount; i++) {
+		buckets.Set(i, Napi::Number::New(env, double(histogram.GetBucket(i))));
+	}
+
+	result.Set("count", Napi::Number::New(env, double(histogram.GetCount())));
+	result.Set("sum", Napi::Number::New(env, double(histogram.GetSum())));
+	result.Set("max", Napi::Number::New(env, double(histogram.GetMax())));
+	result.Set("buckets", buckets);
+
+	return result;
+}
+
+// Reads the options of the virtual device from the `virtualDevice` config property. Times are given
+// in milliseconds. The record buffer, if given, must be referenced for as long as the device is open.
+VirtualDeviceOptions GetVirtualDeviceOptions(const Napi::Object& configObject) {
+	VirtualDeviceOptions options;
+
+	auto virtualDeviceValue = configObject.Get("virtualDevice");
+
+	if (!virtualDeviceValue.IsObject()) {
+		return options;
+	}
+
+	auto virtualDeviceObject = virtualDeviceValue.As<Napi::Object>();
+
+	auto periodFrameCountValue = virtualDeviceObject.Get("periodFrameCount");
+
+	if (periodFrameCountValue.IsNumber()) {
+		options.periodFrameCount = periodFrameCountValue.As<Napi::Number>().Int64Value();
+	}
+
+	auto bufferFrameCountValue = virtualDeviceObject.Get("bufferFrameCount");
+
+	if (bufferFrameCountValue.IsNumber()) {
+		options.bufferFrameCount = bufferFrameCountValue.As<Napi::Number>().Int64Value();
+	}
+
+	auto clockRateValue = virtualDeviceObject.Get("clockRate");
+
+	if (clockRateValue.IsNumber()) {
+		options.clockRate = clockRateValue.As<Napi::Number>().DoubleValue();
+	}
+
+	auto stallsValue = virtualDeviceObject.Get("stalls");
+
+	if (stallsValue.IsArray()) {
+		auto stallsArray = stallsValue.As<Napi::Array>();
+
+		for (uint32_t i = 0; i < stallsArray.Length(); i++) {
+			auto stallObject = stallsArray.Get(i).As<Napi::Object>();
+
+			VirtualDeviceStall stall;
+			stall.time = static_cast<int64_t>(stallObject.Get("time").As<Napi::Number>().DoubleValue() * 1000000.0);
+			stall.duration = static_cast<int64_t>(stallObject.Get("duration").As<Napi::Number>().DoubleValue() * 1000000.0);
+
+			options.stalls.push_back(stall);
+		}
+	}
+
+	auto xrunsValue = virtualDeviceObject.Get("xruns");
+
+	if (xrunsValue.IsArray()) {
+		auto xrunsArray = xrunsValue.As<Napi::Array>();
+
+		for (uint32_t i = 0; i < xrunsArray.Length(); i++) {
+			options.xrunTimes.push_back(static_cast<int64_t>(xrunsArray.Get(i).As<Napi::Number>().DoubleValue() * 1000000.0));
+		}
+
+		std::sort(options.xrunTimes.begin(), options.xrunTimes.end());
+	}
+
+	auto recordBufferValue = virtualDeviceObject.Get("recordBuffer");
+
+	if (recordBufferValue.IsTypedArray()) {
+		auto recordBuffer = recordBufferValue.As<Napi::Int16Array>();
+		auto channelCount = configObject.Get("channelCount").As<Napi::Number>().Int64Value();
+
+		options.recordBuffer = recordBuffer.Data();
+		options.recordBufferFrameCount = static_cast<int64_t>(recordBuffer.ElementLength()) / channelCount;
+	}
+
+	return options;
+}
+
+Napi::Object CreateVirtualDeviceStatsObject(Napi::Env env, const VirtualDeviceStats& stats) {
+	auto result = Napi::Object::New(env);
+
+	result.Set("receivedFrameCount", Napi::Number::New(env, double(stats.receivedFrameCount)));
+	result.Set("recordedFrameCount", Napi::Number::New(env, double(stats.recordedFrameCount)));
+	result.Set("startCount", Napi::Number::New(env, double(stats.startCount)));
+	result.Set("stallCount", Napi::Number::New(env, double(stats.stallCount)));
+	result.Set("injectedXrunCount", Napi::Number::New(env, double(stats.injectedXrunCount)));
+	result.Set("underrunCount", Napi::Number::New(env, double(stats.underrunCount)));
+
+	return result;
+}
+
+// Creates the backend selected by the `backend` config property. `device` (the default) plays through the
+// ALSA device named by `deviceName`, or the default device. `null` and `file` simulate a device, paced by the monotonic clock unless `paced` is false,
+// and `file` writes all frames played to `filePath`, in the format given by `fileFormat` (`wav` or `raw`).
+// `virtual` plays through an in-process ALSA plugin device, configured by `virtualDevice`, which is also
+// returned through `virtualDevice`.
+OutputBackend* CreateBackend(const Napi::Object& configObject, VirtualAlsaOutputBackend*& virtualDevice) {
+	auto backendValue = configObject.Get("backend");
+	auto backendName = backendValue.IsString() ? backendValue.As<Napi::String>().Utf8Value() : std::string("device");
+
+	auto pacedValue = configObject.Get("paced");
+	auto paced = pacedValue.IsUndefined() || pacedValue.ToBoolean().Value();
+
+	if (backendName == "null") {
+		return new NullOutputBackend(paced);
+	}
+
+	if (backendName == "file") {
+		auto filePath = configObject.Get("filePath").As<Napi::String>().Utf8Value();
+
+		auto fileFormatValue = configObject.Get("fileFormat");
+		auto isRaw = fileFormatValue.IsString() && fileFormatValue.As<Napi::String>().Utf8Value() == "raw";
+
+		return new FileOutputBackend(paced, filePath, isRaw ? OutputFileFormat::Raw : OutputFileFormat::Wave);
+	}
+
+	if (backendName == "virtual") {
+		virtualDevice = new VirtualAlsaOutputBackend(GetVirtualDeviceOptions(configObject));
+
+		return virtualDevice;
+	}
+
+	auto deviceNameValue = configObject.Get("deviceName");
+
+	if (deviceNameValue.IsString()) {
+		return new AlsaOutputBackend(deviceNameValue.As<Napi::String>().Utf8Value());
+	}
+
+	return new AlsaOutputBackend();
+}
+
+class NodeAudioOutput;
+
+// All outputs that were successfully initialized, and not yet deleted. Used to compute process-wide resource usage.
+std::mutex liveOutputsMutex;
+std::vector<NodeAudioOutput*> liveOutputs;
+
+// Native objects that are allocated, and not yet freed, across all outputs. Used to check for leaks.
+std::atomic<int64_t> allocatedOutputCount { 0 }; // NodeAudioOutput objects, including the references they hold
+std::atomic<int64_t> openAsyncHandleCount { 0 }; // Async wakeup handles, until their close callback has run
+
+// Interval between samples of the output thread's CPU time and context switch counts
+const int64_t threadUsageSampleInterval = 50 * 1000000; // 50ms
+
+// Resource usage of an output. The CPU time and context switches are of the output thread only, and don't include
+// the time spent calling the handler on the JavaScript thread.
+struct ResourceUsage {
+	int64_t threadCpuTime = 0; // In nanoseconds
+	int64_t voluntaryContextSwitchCount = 0;
+	int64_t involuntaryContextSwitchCount = 0;
+	int64_t nativeByteCount = 0;
+};
+
+Napi::Object CreateResourceUsageObject(Napi::Env env, const ResourceUsage& usage) {
+	auto result = Napi::Object::New(env);
+
+	result.Set("threadCpuTime", Napi::Number::New(env, double(usage.threadCpuTime) / 1000000.0));
+	result.Set("voluntaryContextSwitchCount", Napi::Number::New(env, double(usage.voluntaryContextSwitchCount)));
+	result.Set("involuntaryContextSwitchCount", Napi::Number::New(env, double(usage.involuntaryContextSwitchCount)));
+	result.Set("nativeByteCount", Napi::Number::New(env, double(usage.nativeByteCount)));
+
+	return result;
+}
+
 class NodeAudioOutput {
+public:
+	NodeAudioOutput() {
+		allocatedOutputCount++;
+	}
+
+	~NodeAudioOutput() {
+		allocatedOutputCount--;
+	}
+
 private:
 	Napi::ThreadSafeFunction threadSafeCallbackWrapper = Napi::ThreadSafeFunction();
-	bool disposeRequested = false;
+	Napi::ThreadSafeFunction eventCallbackWrapper = Napi::ThreadSafeFunction();
+	std::atomic<bool> disposeRequested { false };
 	std::vector<Napi::Reference<Napi::Int16Array>> outputBuffers;
+	int16_t* outputBufferData[2] = { nullptr, nullptr }; // Stable for as long as the buffers are referenced
+
+	// The handler, and the `markers` event, are called through an async handle, rather than the callback wrappers,
+	// so the output thread doesn't allocate or lock when requesting them. The output thread sets flags in
+	// `pendingAsyncWork`, and wakes the JavaScript thread with `uv_async_send`, which does neither.
+	// Once the handler has filled the buffer, the JavaScript thread posts `handlerCompletedSemaphore`.
+	napi_env env = nullptr;
+	uv_async_t* asyncWakeup = nullptr;
+	Napi::AsyncContext* asyncContext = nullptr;
+	Napi::FunctionReference handlerReference;
+	Napi::FunctionReference eventCallbackReference;
+	std::atomic<int> pendingAsyncWork { 0 };
+	sem_t handlerCompletedSemaphore;
+	std::atomic<int> handlerBufferIndex { 0 };
+	std::atomic<int64_t> handlerRequestTime { 0 };
+
+	// Times of the last handler call, set by the JavaScript thread before posting `handlerCompletedSemaphore`,
+	// and recorded to the trace ring by the output thread, which is the ring's only producer
+	int64_t handlerCallStartTime = 0;
+	int64_t handlerCallEndTime = 0;
+	int64_t handlerBufferFrameCount = 0;
+	bool hasEventCallback = false;
+	bool errorReported = false; // Output thread only
+
+	// The output thread is joined, and the object deleted, on the JavaScript thread, once the output thread
+	// has released the callback wrappers. The `disposed` promise is then resolved.
+	std::thread outputThread;
+	std::atomic<bool> outputThreadFinished { false };
+	Napi::Promise::Deferred* disposedDeferred = nullptr;
+
+	// Device layer. Opened when initializing, and closed by the output thread when it ends.
+	OutputBackend* backend = nullptr;
+
+	std::atomic<int> stopMode { int(StopMode::Drain) };
+	std::atomic<bool> flushRequested { false };
+	std::atomic<bool> pauseRequested { false };
+	std::atomic<int64_t> seekTargetFrame { -1 }; // -1 when no seek is pending
+
+	// Start request. Target frame and time are -1 when not set.
+	std::atomic<bool> startRequested { false };
+	std::atomic<int64_t> startTargetFrame { -1 };
+	std::atomic<int64_t> startTargetTime { -1 };
+
+	// Start state. Only accessed by the output thread.
+	bool isStarted = false;
+	int64_t scheduledStartFrame = -1; // Frame index, in the output's timeline, at which content should begin
+	int64_t scheduledStartTime = -1; // Monotonic time, in nanoseconds, at which content should begin
+	std::vector<int16_t> silenceBuffer;
+
+	// Pause state. Only accessed by the output thread.
+	bool canPauseInHardware = false;
+	bool isPaused = false;
+	bool isPausedInHardware = false;
+	int64_t prefillFrameCount = 0; // Frames to rewrite, from the write history, when resuming
+
+	// Only set when the output plays from a native sample source, rather than calling a handler.
+	// The source is either a stream buffer, a clip buffer, or a mixer.
+	SampleSource* nativeSource = nullptr;
+	StreamBuffer* streamBuffer = nullptr;
+	ClipBuffer* clipBuffer = nullptr;
+	Mixer* mixer = nullptr;
+	std::vector<int64_t> finishedMixerSourceIds; // Only accessed by the JavaScript thread
+
+	int64_t channelCount = 0;
+	int64_t deviceSampleRate = 0;
+	int64_t periodFrameCount = 0;
+	int64_t framesWritten = 0;
+	int64_t handlerFrameOffset = 0; // Frames passed to the handler so far
+
+	// Tracks where the content ends in the output's timeline, since silence may be written after it, like on
+	// a source underflow, or while concealing a late handler. Content is always at the start of a write.
+	int64_t contentEndFrame = 0; // Frame following the last content frame written
+	int64_t lastContentFrameOffset = 0; // Content frame offset when the content end was last updated
+	int64_t writeStartFrame = 0; // Frames written before the last write started
+	int64_t prefillContentEndFrame = 0; // Content end before queued frames were dropped, restored when they're rewritten
+
+	// Latency not reported by the device (like that of its converters, measured by loopback calibration),
+	// added to the delay used for position reporting
+	int64_t latencyOffsetFrameCount = 0;
+
+	// When set, silence is written while waiting for a late handler, if the device is about to run empty,
+	// so it keeps running instead of underrunning
+	bool concealUnderruns = false;
+	int64_t handlerWaitInterval = handlerWaitCheckInterval; // In nanoseconds
+
+	// Playback position, published after every write
+	PlaybackPosition* playbackPosition = nullptr;
+
+	// Optional status, published to a shared buffer alongside the playback position
+	SharedStatus* sharedStatus = nullptr;
+	Napi::Reference<Napi::Float64Array> statusBufferReference;
+
+	// The backend, when it's the virtual device, and the buffer it records to
+	VirtualAlsaOutputBackend* virtualDevice = nullptr;
+	Napi::Reference<Napi::Int16Array> recordBufferReference;
+
+	// Statistics, read by `getStats`
+	OutputStats stats;
+	int64_t lastWakeupTime = -1; // Time the output thread last woke up to write, or -1 if playback was interrupted since
+	int64_t idealWakeupInterval = 0; // Duration of the frames written on each wakeup, in nanoseconds
+
+	// Resource usage of the output thread, sampled by the output thread itself, at most every `threadUsageSampleInterval`
+	std::atomic<int64_t> threadCpuTime { 0 };
+	std::atomic<int64_t> voluntaryContextSwitchCount { 0 };
+	std::atomic<int64_t> involuntaryContextSwitchCount { 0 };
+	int64_t lastThreadUsageSampleTime = -1;
+	int64_t sourcePeriodBufferByteCount = 0;
+	int64_t outputBufferByteCount = 0; // Bytes of the buffers passed to the handler, allocated by V8
+
+	// Trace ring of the output thread, created by the output thread, outside of its realtime section,
+	// once tracing is enabled. Only written by the output thread, including the events of handler calls.
+	TraceRing* traceRing = nullptr;
+	std::atomic<bool> holdsTraceRing { false }; // Read from the JavaScript thread, when computing memory usage
+	int64_t outputThreadId = 0;
+
+	// Content frame of the earliest pending marker, set by JavaScript, or -1 if there are none.
+	// When the played content frame reaches it, a single `markers` event is sent, and no other is sent
+	// until JavaScript has handled it.
+	std::atomic<int64_t> nextMarkerFrame { -1 };
+	std::atomic<bool> markerEventPending { false };
+	std::atomic<int64_t> markerEventFrame { 0 };
+	std::atomic<int64_t> markerEventTime { 0 };
+
+	// Ring buffer holding the most recently written frames. Used to rewrite rewound frames with a fade-out.
+	std::vector<int16_t> writeHistory;
+	int64_t writeHistoryFrameCount = 0;
+
+	// Buffer for frames rewritten when resuming from a software pause
+	std::vector<int16_t> prefillBuffer;
+
+	// Buffer for frames rewritten with a fade-out, or a crossfade
+	std::vector<int16_t> fadeBuffer;
+	std::vector<int16_t> fadeInBuffer;
+	int64_t fadeFrameCount = 0;
+	int64_t rewindSafetyFrameCount = 0;
 
 public:
 	Napi::Promise Initialize(const Napi::CallbackInfo& info) {
@@ -38,6 +415,27 @@ public:
 		auto bufferDuration = configObject.Get("bufferDuration").As<Napi::Number>().FloatValue();
 		auto userCallback = info[1].As<Napi::Function>();
 
+		// Optional event callback, called with an event name, like `ended`
+		auto hasEventCallback = info.Length() > 2 && info[2].IsFunction();
+
+		// When `useStream` is set, samples are read from a native stream buffer, instead of calling the handler
+		auto useStream = configObject.Has("useStream") && configObject.Get("useStream").ToBoolean().Value();
+
+		// When `clipSamples` is set, the given samples are copied to a native clip buffer, and played from it,
+		// instead of calling the handler
+		auto useClip = configObject.Has("clipSamples") && configObject.Get("clipSamples").IsTypedArray();
+
+		// When `useMixer` is set, samples are mixed from any number of sources added later, up to `maxMixerSourceCount`,
+		// by up to `mixerThreadCount` threads, including the output thread
+		auto useMixer = configObject.Has("useMixer") && configObject.Get("useMixer").ToBoolean().Value();
+
+		// When `autoStart` is false, nothing is played until `start` is called
+		auto autoStart = !configObject.Has("autoStart") || configObject.Get("autoStart").ToBoolean().Value();
+
+		// When `statusBuffer` is set, the output status is published to it. It must be a Float64Array
+		// backed by a SharedArrayBuffer, with at least `SharedStatusSlotCount` elements.
+		auto useStatusBuffer = configObject.Has("statusBuffer") && configObject.Get("statusBuffer").IsTypedArray();
+
 		// Compute buffer sample count
 		auto bufferFrameCount = static_cast<int64_t>((bufferDuration / 1000.0) * float(sampleRate));
 		auto bufferSampleCount = bufferFrameCount * channelCount;
@@ -47,122 +445,173 @@ public:
 		trace("Buffer duration: %f milliseconds\n", bufferDuration);
 		trace("Buffer frame count: %d\n", bufferFrameCount);
 
-		// Open ALSA device for playback
-		trace("Initializing ALSA output..\n");
+		// Create and open the backend
+		this->backend = CreateBackend(configObject, this->virtualDevice);
+
+		if (this->virtualDevice != nullptr) {
+			auto recordBufferValue = configObject.Get("virtualDevice").As<Napi::Object>().Get("recordBuffer");
 
-		int err;
-		snd_pcm_t* pcmHandle;
+			if (recordBufferValue.IsTypedArray()) {
+				this->recordBufferReference = Napi::Persistent(recordBufferValue.As<Napi::Int16Array>());
+			}
+		}
 
-		err = snd_pcm_open(&pcmHandle, "default", SND_PCM_STREAM_PLAYBACK, 0);
+		trace("Initializing output backend..\n");
+
+		std::string openErrorMessage;
+		auto err = this->backend->Open(sampleRate, channelCount, bufferFrameCount, openErrorMessage);
 
 		if (err < 0) {
-			initializationPromiseDeferred.Reject(Napi::Error::New(env, "Failed to open audio device").Value());
+			initializationPromiseDeferred.Reject(Napi::Error::New(env, openErrorMessage).Value());
+
+			delete this->backend;
+			delete this;
 
 			return initializationPromise;
 		}
 
-		// Allocate a hardware parameters object
-		snd_pcm_hw_params_t* params;
+		// Initialize JavaScript callback wrappers. The main wrapper is never called: it keeps the event loop alive
+		// while the output thread runs. When it's finalized, the output thread is joined, and this object is deleted.
+		this->disposedDeferred = new Napi::Promise::Deferred(env);
 
-		snd_pcm_hw_params_malloc(&params);
-		snd_pcm_hw_params_any(pcmHandle, params);
+		this->threadSafeCallbackWrapper = Napi::ThreadSafeFunction::New(env, userCallback, "threadSafeCallbackWrapper", 1, 1, [this](Napi::Env env) {
+			this->OnCallbackWrapperFinalized(env);
+		});
 
-		// Set sample rate
-		auto targetSampleRate = static_cast<unsigned int>(sampleRate);
-		snd_pcm_hw_params_set_rate_near(pcmHandle, params, &targetSampleRate, 0);
+		if (hasEventCallback) {
+			this->eventCallbackWrapper = Napi::ThreadSafeFunction::New(env, info[2].As<Napi::Function>(), "eventCallbackWrapper", 1, 1);
+		}
 
-		// Set channel count
-		auto targetChannelCount = static_cast<unsigned int>(channelCount);
-		snd_pcm_hw_params_set_channels(pcmHandle, params, targetChannelCount);
+		// Initialize the async handle used to call the handler, and to send `markers` events.
+		// It's closed when the main wrapper is finalized.
+		this->env = env;
+		this->asyncContext = new Napi::AsyncContext(env, "audioOutput");
+		this->handlerReference = Napi::Persistent(userCallback);
+		this->hasEventCallback = hasEventCallback;
 
-		// Set format
-		snd_pcm_hw_params_set_format(pcmHandle, params, SND_PCM_FORMAT_S16_LE);
+		if (hasEventCallback) {
+			this->eventCallbackReference = Napi::Persistent(info[2].As<Napi::Function>());
+		}
 
-		// Set PCM access type
-		snd_pcm_hw_params_set_access(pcmHandle, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+		sem_init(&this->handlerCompletedSemaphore, 0, 0);
 
-		// Set period time
-		{
-			unsigned int targetPeriodTime = 10 * 1000; // 10ms
-			int targetPeriodTimeDirection = 0;
-			snd_pcm_hw_params_set_period_time_near(pcmHandle, params, &targetPeriodTime, &targetPeriodTimeDirection);
-		}
+		uv_loop_t* eventLoop;
+		napi_get_uv_event_loop(env, &eventLoop);
 
-		// Set buffer time
-		if (false) {
-			unsigned int bufferDurationNanoseconds = (unsigned int)(bufferDuration * 1000);
-			int bufferTimeDirection = 0;
-			snd_pcm_hw_params_set_buffer_time_near(pcmHandle, params, &bufferDurationNanoseconds, &bufferTimeDirection);
-		}
+		this->asyncWakeup = new uv_async_t();
+		uv_async_init(eventLoop, this->asyncWakeup, OnAsyncWakeup);
+		openAsyncHandleCount++;
+		this->asyncWakeup->data = this;
 
-		// Initialize JavaScript callback wrapper
-		this->threadSafeCallbackWrapper = Napi::ThreadSafeFunction::New(env, userCallback, "threadSafeCallbackWrapper", 1, 1);
+		// The handle doesn't keep the event loop alive by itself. The main wrapper does, until the output thread ends.
+		uv_unref((uv_handle_t*)this->asyncWakeup);
 
-		// Write the parameters to the driver
-		err = snd_pcm_hw_params(pcmHandle, params);
+		auto targetSampleRate = this->backend->GetSampleRate();
+		auto deviceBufferFrameCount = this->backend->GetBufferFrameCount();
 
-		// If failed
-		if (err < 0) {
-			std::stringstream errorString;
-			errorString << "Error " << err << " occurred while initializing ALSA output: " << snd_strerror(err);
+		// Check if the device supports pausing
+		this->canPauseInHardware = this->backend->CanPause();
 
-			initializationPromiseDeferred.Reject(Napi::Error::New(env, errorString.str()).Value());
+		// Initialize write history and fade buffer
+		this->channelCount = channelCount;
+		this->deviceSampleRate = targetSampleRate;
+		this->periodFrameCount = this->backend->GetPeriodFrameCount();
 
-			// Dispose ALSA handle and parameters
-			snd_pcm_close(pcmHandle);
-			snd_pcm_hw_params_free(params);
+		this->writeHistoryFrameCount = deviceBufferFrameCount;
+		this->writeHistory.resize(deviceBufferFrameCount * channelCount);
+		this->prefillBuffer.resize(deviceBufferFrameCount * channelCount);
 
-			// Release callback wrapper
-			this->threadSafeCallbackWrapper.Release();
+		this->fadeFrameCount = static_cast<int64_t>((fadeOutDuration / 1000.0) * double(sampleRate));
+		this->fadeBuffer.resize(this->fadeFrameCount * channelCount);
+		this->fadeInBuffer.resize(this->fadeFrameCount * channelCount);
 
-			delete this;
+		this->rewindSafetyFrameCount = static_cast<int64_t>((rewindSafetyDuration / 1000.0) * double(sampleRate));
 
-			return initializationPromise;
+		if (configObject.Get("latencyOffset").IsNumber()) {
+			auto latencyOffset = configObject.Get("latencyOffset").As<Napi::Number>().DoubleValue();
+
+			this->latencyOffsetFrameCount = static_cast<int64_t>(round((latencyOffset / 1000.0) * double(targetSampleRate)));
 		}
 
-		trace("ALSA output initialized\n");
+		// Concealment checks the device several times per period, so it can write silence before it runs empty
+		if (configObject.Get("concealUnderruns").IsBoolean()) {
+			this->concealUnderruns = configObject.Get("concealUnderruns").As<Napi::Boolean>().Value();
+		}
 
-		// Get ALSA buffer size (frames) and period size (frames)
-		snd_pcm_uframes_t alsaBufferFrameCount;
-		snd_pcm_uframes_t alsaPeriodFrameCount;
-		err = snd_pcm_get_params(pcmHandle, &alsaBufferFrameCount, &alsaPeriodFrameCount);
+		if (this->concealUnderruns && this->periodFrameCount > 0) {
+			auto periodDuration = (this->periodFrameCount * 1000000000) / targetSampleRate;
 
-		if (err < 0) {
-			std::stringstream errorString;
-			errorString << "Error " << err << " occurred while reading ALSA parameters: " << snd_strerror(err);
+			this->handlerWaitInterval = std::clamp(periodDuration / 4, int64_t(500000), handlerWaitCheckInterval);
+		}
 
-			initializationPromiseDeferred.Reject(Napi::Error::New(env, errorString.str()).Value());
+		this->idealWakeupInterval = (bufferFrameCount * 1000000000) / targetSampleRate;
 
-			// Dispose ALSA handle and parameters
-			snd_pcm_close(pcmHandle);
-			snd_pcm_hw_params_free(params);
+		this->silenceBuffer.resize(bufferSampleCount);
 
-			// Release callback wrapper
-			this->threadSafeCallbackWrapper.Release();
+		this->handlerBufferFrameCount = bufferFrameCount;
 
-			delete this;
+		this->playbackPosition = new PlaybackPosition(targetSampleRate);
 
-			return initializationPromise;
+		if (useStatusBuffer) {
+			auto statusBuffer = configObject.Get("statusBuffer").As<Napi::Float64Array>();
+
+			this->statusBufferReference = Napi::Persistent(statusBuffer);
+			this->sharedStatus = new SharedStatus(statusBuffer.Data());
+
+			this->PublishSharedStatus(this->playbackPosition->Read(), OutputState::NotStarted);
 		}
 
-		trace("ALSA buffer frame count: %d, ALSA period frame count: %d\n", alsaBufferFrameCount, alsaPeriodFrameCount);
+		this->startRequested = autoStart;
 
 		// Initialize Int16Array buffers
 		for (int i = 0; i < 2; i++) {
 			auto napiBuffer = Napi::Int16Array::New(env, bufferSampleCount);
 			auto napiBufferReference = Napi::Persistent(napiBuffer);
 
+			this->outputBufferData[i] = napiBuffer.Data();
+
 			outputBuffers.push_back(std::move(napiBufferReference));
+
+			this->outputBufferByteCount += bufferSampleCount * sizeof(int16_t);
+		}
+
+		// Initialize native source, if needed
+		if (useStream) {
+			this->streamBuffer = new StreamBuffer();
+			this->nativeSource = this->streamBuffer;
+		} else if (useClip) {
+			auto clipSamples = configObject.Get("clipSamples").As<Napi::Int16Array>();
+
+			this->clipBuffer = new ClipBuffer(clipSamples.Data(), clipSamples.ElementLength(), channelCount);
+			this->nativeSource = this->clipBuffer;
+		} else if (useMixer) {
+			auto maxMixerSourceCount = configObject.Has("maxMixerSourceCount") ? configObject.Get("maxMixerSourceCount").As<Napi::Number>().Int64Value() : 256;
+
+			auto mixerThreadCount = configObject.Has("mixerThreadCount") ? configObject.Get("mixerThreadCount").As<Napi::Number>().Int64Value() : 1;
+
+			this->mixer = new Mixer(channelCount, sampleRate, bufferFrameCount, maxMixerSourceCount, mixerThreadCount);
+			this->nativeSource = this->mixer;
+		}
+
+		auto useNativeSource = this->nativeSource != nullptr;
+
+		// Add to the live outputs
+		{
+			std::lock_guard<std::mutex> lock(liveOutputsMutex);
+
+			liveOutputs.push_back(this);
 		}
 
 		// Start a new thread for the output loop
-		std::thread([=]() {
+		this->outputThread = std::thread([=]() {
+			this->outputThreadId = syscall(SYS_gettid);
+
 			auto waitUntilALSABufferIsSufficientlyDrained = [&](int targetRemainingFrameCount) -> int {
 				while (true) {
 					// Get available frame count in ALSA buffer, andd ALSA I/O latency (in frames)
-					snd_pcm_sframes_t availableFrameCount;
-					snd_pcm_sframes_t delayInFrames;
-					auto infoRequestErrorCode = snd_pcm_avail_delay(pcmHandle, &availableFrameCount, &delayInFrames);
+					int64_t availableFrameCount;
+					int64_t delayInFrames;
+					auto infoRequestErrorCode = this->backend->GetAvailableAndDelay(availableFrameCount, delayInFrames);
 
 					//trace("Available: %d, Delay: %d, Fill estimate: %d\n", availableFrames, delayInFrames, fillEstimate);
 
@@ -170,7 +619,7 @@ public:
 					if (infoRequestErrorCode == -EPIPE) {
 						trace("Buffer underrun detected while waiting\n");
 
-						auto recoverResult = snd_pcm_recover(pcmHandle, -EPIPE, 1);
+						auto recoverResult = this->RecoverFromUnderrun();
 
 						if (recoverResult < 0) {
 							trace("Failed to recover from buffer underrun\n");
@@ -190,13 +639,23 @@ public:
 					}
 
 					// Derive an estimate of how many frames remain in the buffer
-					auto fillEstimate = availableFrameCount >= 0 ? alsaBufferFrameCount - availableFrameCount : 0;
+					auto fillEstimate = availableFrameCount >= 0 ? deviceBufferFrameCount - availableFrameCount : 0;
 
 					// If the number of remaining frames is smaller or equal to the target, break
 					if (fillEstimate <= targetRemainingFrameCount) {
+						this->RecordWakeup(fillEstimate);
+
+						return 0;
+					}
+
+					// If a flush, pause, or an immediate stop, was requested, return early so it can be handled
+					if (this->HasPendingRequest()) {
 						return 0;
 					}
 
+					// Send a `markers` event if the played position has reached the next marker
+					this->CheckMarkers();
+
 					// Sleep for 1 millisecond
 					std::this_thread::sleep_for(std::chrono::milliseconds(1));
 				}
@@ -205,74 +664,199 @@ public:
 			Signal signal;
 			auto currentBufferIndex = 0;
 
+			// Buffer used when reading from the native source. Allocated before the loop starts.
+			std::vector<int16_t> sourcePeriodBuffer(useNativeSource ? bufferSampleCount : 0);
+			this->sourcePeriodBufferByteCount = sourcePeriodBuffer.capacity() * sizeof(int16_t);
+			auto sourceEnded = false;
+
 			// Start the loop
 			while (!this->disposeRequested) {
+				this->SampleThreadUsage(false);
+
+				// Create the trace ring here, since creating it allocates and locks
+				if (this->traceRing == nullptr && tracingEnabled.load(std::memory_order_relaxed)) {
+					this->traceRing = traceRegistry.CreateRing(this->outputThreadId);
+					this->holdsTraceRing = true;
+				}
+
+				// Wait until started
+				if (!this->isStarted) {
+					if (!this->startRequested) {
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+						continue;
+					}
+
+					this->isStarted = true;
+					this->scheduledStartFrame = this->startTargetFrame;
+					this->scheduledStartTime = this->startTargetTime;
+
+					this->PublishPosition();
+				}
+
+				// Pause or resume, if requested
+				if (this->pauseRequested != this->isPaused) {
+					auto requestStartTime = getMonotonicTime();
+
+					if (this->pauseRequested) {
+						this->Pause();
+
+						this->RecordTraceEvent(TraceEventType::Pause, requestStartTime, getMonotonicTime() - requestStartTime);
+					} else {
+						this->Resume();
+
+						this->RecordTraceEvent(TraceEventType::Resume, requestStartTime, getMonotonicTime() - requestStartTime);
+					}
+				}
+
+				// Discard queued frames, if requested
+				if (this->flushRequested.exchange(false)) {
+					auto flushStartTime = getMonotonicTime();
+
+					this->Flush();
+
+					this->RecordTraceEvent(TraceEventType::Flush, flushStartTime, getMonotonicTime() - flushStartTime);
+
+					continue;
+				}
+
+				// Seek to a new clip position, if requested
+				auto seekTarget = this->seekTargetFrame.exchange(-1);
+
+				if (seekTarget >= 0) {
+					auto seekStartTime = getMonotonicTime();
+
+					this->Seek(seekTarget);
+
+					this->RecordTraceEvent(TraceEventType::Seek, seekStartTime, getMonotonicTime() - seekStartTime, seekTarget);
+
+					continue;
+				}
+
+				// While paused, wait until resumed or disposed
+				if (this->isPaused) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+					continue;
+				}
+
 				trace("Waiting for ALSA buffer to become sufficently drained..\n");
 
+				// From here until the end of the iteration, in the steady state, the output thread must not allocate or lock.
+				// This is checked when the realtime guard library is preloaded.
+				RealtimeSection realtimeSection;
+
 				// Wait until the ALSA internal buffer is sufficiently drained
+				auto waitStartTime = getMonotonicTime();
+				AUDIO_IO_PROBE1(wait__start, this);
+
 				auto waitResult = waitUntilALSABufferIsSufficientlyDrained(bufferFrameCount);
 
+				AUDIO_IO_PROBE2(wait__end, this, waitResult);
+
+				this->RecordTraceEvent(TraceEventType::Wait, waitStartTime, getMonotonicTime() - waitStartTime);
+
 				if (waitResult < 0) {
 					this->disposeRequested = true;
 
 					break;
 				}
 
+				if (this->disposeRequested) {
+					break;
+				}
+
+				// If a flush or pause was requested while waiting, handle it first
+				if (this->HasPendingRequest()) {
+					continue;
+				}
+
 				trace("Iteration start\n");
 
-				// Call back into JavaScript to let the user write to the buffer
-				auto status = this->threadSafeCallbackWrapper.BlockingCall([&](Napi::Env env, Napi::Function jsCallback) {
-					// Get current buffer
-					auto currentBuffer = outputBuffers[currentBufferIndex].Value();
+				// If the start was scheduled for a later frame or time, write silence until then
+				auto framesUntilScheduledStart = this->GetFramesUntilScheduledStart();
 
-					// Set current buffer to all 0s (silence)
-					std::memset((void*)currentBuffer.Data(), 0, currentBuffer.ByteLength());
+				if (framesUntilScheduledStart > 0) {
+					auto silentFrameCount = std::min(framesUntilScheduledStart, bufferFrameCount);
+					auto writeResult = this->WriteFrames(this->silenceBuffer.data(), silentFrameCount);
 
-					// Call back to JavaScript to have the buffer filled with samples
-					jsCallback.Call({ currentBuffer });
+					if (writeResult < 0) {
+						trace("Error %d occurred while writing ALSA output: %s\n", writeResult, snd_strerror(writeResult));
+
+						this->ReportError(writeResult, "writing");
+						this->RequestDispose();
+					}
 
-					// Write buffer to ALSA output
-					auto writeResult = snd_pcm_writei(pcmHandle, currentBuffer.Data(), bufferFrameCount);
+					continue;
+				}
 
-					// Detect buffer underruns and try to recover
-					if (writeResult == -EPIPE) {
-						trace("Buffer underrun detected\n");
+				if (useNativeSource) {
+					// Read samples from the native source. On underflow, the rest of the buffer is left silent.
+					std::fill(sourcePeriodBuffer.begin(), sourcePeriodBuffer.end(), 0);
 
-						auto recoverResult = snd_pcm_recover(pcmHandle, writeResult, 1);
+					auto readStartTime = getMonotonicTime();
+					auto samplesRead = this->nativeSource->Read(sourcePeriodBuffer.data(), bufferSampleCount);
 
-						if (recoverResult < 0) {
-							Napi::Error::New(env, "Failed to recover from buffer underrun").ThrowAsJavaScriptException();
+					if (this->mixer != nullptr) {
+						this->stats.mixDuration.Record((getMonotonicTime() - readStartTime) / 1000);
 
-							this->RequestDispose();
-							signal.send();
+						// Let the JavaScript thread know about sources that have ended
+						if (this->mixer->TakeFinishedNotification()) {
+							this->pendingAsyncWork.fetch_or(MixerSourceEndedWork);
 
-							return;
+							uv_async_send(this->asyncWakeup);
 						}
+					}
 
-						trace("Buffer underrun recovered\n");
+					// If the source has ended, only write the remaining samples
+					auto framesToWrite = bufferFrameCount;
 
-						writeResult = snd_pcm_writei(pcmHandle, currentBuffer.Data(), bufferFrameCount);
+					if (this->nativeSource->IsExhausted()) {
+						framesToWrite = samplesRead / channelCount;
+						sourceEnded = true;
+					} else if (samplesRead < bufferSampleCount) {
+						trace("Native source underflow\n");
 					}
 
-					if (writeResult < 0) {
-						std::stringstream errorString;
-						errorString << "Error " << writeResult << " occurred while writing ALSA output: " << snd_strerror(writeResult);
+					auto writeResult = framesToWrite > 0 ? this->WriteFrames(sourcePeriodBuffer.data(), framesToWrite) : 0;
 
-						Napi::Error::New(env, errorString.str()).ThrowAsJavaScriptException();
+					if (writeResult < 0) {
+						trace("Error %d occurred while writing ALSA output: %s\n", writeResult, snd_strerror(writeResult));
 
+						this->ReportError(writeResult, "writing");
 						this->RequestDispose();
-						signal.send();
+					}
 
-						return;
+					if (sourceEnded) {
+						break;
 					}
 
-					// Switch to other buffer
-					currentBufferIndex = currentBufferIndex == 0 ? 1 : 0;
+					trace("Iteration end\n");
 
-					signal.send();
-				});
+					continue;
+				}
+
+				// Call back into JavaScript to let the user write to the buffer
+				AUDIO_IO_PROBE2(handler__dispatch, this, this->handlerFrameOffset);
+
+				if (!this->CallHandler(currentBufferIndex)) {
+					break;
+				}
+
+				this->handlerFrameOffset += bufferFrameCount;
 
-				signal.wait();
+				// Write buffer to ALSA output, recovering from a buffer underrun if needed
+				auto writeResult = this->WriteFrames(this->outputBufferData[currentBufferIndex], bufferFrameCount);
+
+				if (writeResult < 0) {
+					trace("Error %d occurred while writing ALSA output: %s\n", writeResult, snd_strerror(writeResult));
+
+					this->ReportError(writeResult, "writing");
+					this->RequestDispose();
+				}
+
+				// Switch to other buffer
+				currentBufferIndex = currentBufferIndex == 0 ? 1 : 0;
 
 				trace("Iteration end\n");
 			}
@@ -283,25 +867,109 @@ public:
 				waitUntilALSABufferIsSufficientlyDrained(0);
 			}
 
-			// Wait for any remaining pending samples to play
-			snd_pcm_drain(pcmHandle);
+			auto stopModeValue = sourceEnded ? StopMode::Drain : StopMode(this->stopMode.load());
+
+			// If disposed while paused, don't play the queued frames
+			if (this->isPaused) {
+				stopModeValue = StopMode::Drop;
+			}
+
+			auto drainStartTime = getMonotonicTime();
+			AUDIO_IO_PROBE2(dispose__start, this, int(stopModeValue));
+
+			auto sendFinalMarkerEvent = false;
+			int64_t finalMarkerEventFrame = 0;
+			int64_t finalMarkerEventTime = 0;
+			int drainResult = 0;
+
+			if (stopModeValue == StopMode::Fade) {
+				// Fade out the queued frames, then wait for the fade to play
+				if (this->FadeOutQueuedFrames()) {
+					drainResult = this->backend->Drain();
+				} else {
+					this->backend->Drop();
+				}
+			} else if (stopModeValue == StopMode::Drop) {
+				// Discard any remaining pending samples
+				this->backend->Drop();
+			} else {
+				// Wait for any remaining pending samples to play
+				drainResult = this->backend->Drain();
+
+				// All written content has played, so fire any markers up to its end, just before the `ended` event
+				if (this->nextMarkerFrame >= 0) {
+					sendFinalMarkerEvent = true;
+					finalMarkerEventFrame = this->playbackPosition->Read().contentFrameOffset;
+					finalMarkerEventTime = getMonotonicTime();
+				}
+			}
+
+			this->RecordTraceEvent(TraceEventType::Drain, drainStartTime, getMonotonicTime() - drainStartTime, int64_t(stopModeValue));
+
+			// Close the backend
+			auto closeResult = this->backend->Close();
+
+			// Report frames that were lost while stopping, like when an output file couldn't be written,
+			// so renders don't end as if they had completed
+			if (drainResult < 0) {
+				trace("Error %d occurred while draining ALSA output\n", drainResult);
+
+				this->ReportError(drainResult, "draining");
+			} else if (closeResult < 0) {
+				trace("Error %d occurred while closing ALSA output\n", closeResult);
 
-			// Dispose ALSA handle
-			snd_pcm_close(pcmHandle);
-			snd_pcm_hw_params_free(params);
+				this->ReportError(closeResult, "closing");
+			}
 
 			trace("ALSA output disposed\n");
 
-			// Release callback wrapper
-			this->threadSafeCallbackWrapper.Release();
+			AUDIO_IO_PROBE1(dispose__end, this);
+
+			// Publish the final status. All written frames have either played or been dropped.
+			if (this->sharedStatus != nullptr) {
+				PlaybackPositionSnapshot finalSnapshot = this->playbackPosition->Read();
 
-			for (int i = 0; i < 2; i++) {
-				outputBuffers[i].Unref();
+				finalSnapshot.delayFrameCount = 0;
+				finalSnapshot.timestamp = getMonotonicTime();
+				finalSnapshot.isRunning = false;
+
+				this->PublishSharedStatus(finalSnapshot, sourceEnded ? OutputState::Ended : OutputState::Stopped);
 			}
 
-			// Delete NodeAudioOutput object
-			delete this;
-		}).detach();
+			// Notify that the output has stopped, and the final frame has played, or was dropped
+			if (hasEventCallback) {
+				auto status = this->eventCallbackWrapper.BlockingCall([&](Napi::Env env, Napi::Function jsCallback) {
+					if (sendFinalMarkerEvent) {
+						jsCallback.Call({ Napi::String::New(env, "markers"), Napi::Number::New(env, double(finalMarkerEventFrame)), Napi::BigInt::New(env, finalMarkerEventTime) });
+					}
+
+					jsCallback.Call({ Napi::String::New(env, "ended"), Napi::Boolean::New(env, sourceEnded) });
+
+					signal.send();
+				});
+
+				if (status == napi_ok) {
+					signal.wait();
+				}
+			}
+
+			this->SampleThreadUsage(true);
+
+			// Retire the trace ring. It's deleted once its remaining events are drained, possibly right away,
+			// so it's forgotten here. A handler abandoned by a drop stop may still be running, but never records to it.
+			if (this->traceRing != nullptr) {
+				this->holdsTraceRing = false;
+
+				traceRegistry.RetireRing(this->traceRing);
+				this->traceRing = nullptr;
+			}
+
+			this->outputThreadFinished = true;
+
+			// Release callback wrappers. The remaining resources are freed on the JavaScript thread,
+			// when the main wrapper is finalized.
+			this->ReleaseCallbackWrappers();
+		});
 
 		// Build result object
 		auto resultObject = Napi::Object().New(env);
@@ -310,31 +978,1391 @@ public:
 			this->RequestDispose();
 		};
 
-		resultObject.Set(Napi::String::New(env, "dispose"), Napi::Function::New(env, disposeMethod));
+		auto stopMethod = [this](const Napi::CallbackInfo& info) {
+			auto mode = info[0].As<Napi::String>().Utf8Value();
 
-		// Resolve initialization promise with the result object
-		initializationPromiseDeferred.Resolve(resultObject);
+			if (mode == "drop") {
+				this->stopMode = int(StopMode::Drop);
+			} else if (mode == "fade") {
+				this->stopMode = int(StopMode::Fade);
+			} else {
+				this->stopMode = int(StopMode::Drain);
+			}
 
-		return initializationPromise;
-	}
+			this->RequestDispose();
+		};
 
-	void RequestDispose() {
-		trace("Dispose requested..\n");
+		auto flushMethod = [this](const Napi::CallbackInfo& info) {
+			this->RequestFlush();
+		};
 
-		this->disposeRequested = true;
-	}
-};
+		auto getPlaybackPositionMethod = [this](const Napi::CallbackInfo& info) {
+			auto env = info.Env();
 
-Napi::Promise createAudioOutput(const Napi::CallbackInfo& info) {
-	auto env = info.Env();
+			auto currentTime = getMonotonicTime();
+			auto snapshot = this->playbackPosition->Read();
 
-	auto output = new NodeAudioOutput();
+			auto playedFrame = this->playbackPosition->GetPlayedFrameAt(snapshot, currentTime);
+			auto playedContentFrame = this->playbackPosition->GetPlayedContentFrame(snapshot, playedFrame);
 
-	return output->Initialize(info);
-}
+			auto result = Napi::Object::New(env);
+
+			result.Set("frame", Napi::Number::New(env, double(playedFrame)));
+			result.Set("contentFrame", Napi::Number::New(env, double(playedContentFrame)));
+			result.Set("framesWritten", Napi::Number::New(env, double(snapshot.framesWritten)));
+			result.Set("delay", Napi::Number::New(env, double(snapshot.framesWritten - playedFrame)));
+			result.Set("deviceSampleRate", Napi::Number::New(env, double(this->playbackPosition->GetSampleRate())));
+			result.Set("isRunning", Napi::Boolean::New(env, snapshot.isRunning));
+			result.Set("monotonicTime", Napi::BigInt::New(env, currentTime));
+
+			return result;
+		};
+
+		auto startMethod = [this](const Napi::CallbackInfo& info) {
+			this->startTargetFrame = info[0].As<Napi::Number>().Int64Value();
+
+			bool lossless;
+			this->startTargetTime = info[1].As<Napi::BigInt>().Int64Value(&lossless);
+
+			this->startRequested = true;
+		};
+
+		auto pauseMethod = [this](const Napi::CallbackInfo& info) {
+			this->pauseRequested = true;
+		};
+
+		auto resumeMethod = [this](const Napi::CallbackInfo& info) {
+			this->pauseRequested = false;
+		};
+
+		auto getStatsMethod = [this](const Napi::CallbackInfo& info) {
+			return this->CreateStatsObject(info.Env());
+		};
+
+		auto getResourceUsageMethod = [this](const Napi::CallbackInfo& info) {
+			return CreateResourceUsageObject(info.Env(), this->GetResourceUsage());
+		};
+
+		auto getVirtualDeviceStatsMethod = [this](const Napi::CallbackInfo& info) {
+			return CreateVirtualDeviceStatsObject(info.Env(), this->virtualDevice->GetStats());
+		};
+
+		auto setNextMarkerFrameMethod = [this](const Napi::CallbackInfo& info) {
+			this->nextMarkerFrame = info[0].As<Napi::Number>().Int64Value();
+		};
+
+		resultObject.Set(Napi::String::New(env, "dispose"), Napi::Function::New(env, disposeMethod));
+		resultObject.Set(Napi::String::New(env, "disposed"), this->disposedDeferred->Promise());
+		resultObject.Set(Napi::String::New(env, "stop"), Napi::Function::New(env, stopMethod));
+		resultObject.Set(Napi::String::New(env, "flush"), Napi::Function::New(env, flushMethod));
+		resultObject.Set(Napi::String::New(env, "getPlaybackPosition"), Napi::Function::New(env, getPlaybackPositionMethod));
+		resultObject.Set(Napi::String::New(env, "start"), Napi::Function::New(env, startMethod));
+		resultObject.Set(Napi::String::New(env, "pause"), Napi::Function::New(env, pauseMethod));
+		resultObject.Set(Napi::String::New(env, "resume"), Napi::Function::New(env, resumeMethod));
+		resultObject.Set(Napi::String::New(env, "getStats"), Napi::Function::New(env, getStatsMethod));
+		resultObject.Set(Napi::String::New(env, "getResourceUsage"), Napi::Function::New(env, getResourceUsageMethod));
+
+		if (this->virtualDevice != nullptr) {
+			resultObject.Set(Napi::String::New(env, "getVirtualDeviceStats"), Napi::Function::New(env, getVirtualDeviceStatsMethod));
+		}
+
+		if (hasEventCallback) {
+			resultObject.Set(Napi::String::New(env, "setNextMarkerFrame"), Napi::Function::New(env, setNextMarkerFrameMethod));
+		}
+
+		if (useStream) {
+			auto appendMethod = [this](const Napi::CallbackInfo& info) {
+				auto samples = info[0].As<Napi::Int16Array>();
+
+				this->streamBuffer->Append(samples.Data(), samples.ElementLength());
+			};
+
+			auto endMethod = [this](const Napi::CallbackInfo& info) {
+				this->streamBuffer->End();
+			};
+
+			auto getQueuedSampleCountMethod = [this](const Napi::CallbackInfo& info) {
+				return Napi::Number::New(info.Env(), double(this->streamBuffer->GetQueuedSampleCount()));
+			};
+
+			resultObject.Set(Napi::String::New(env, "append"), Napi::Function::New(env, appendMethod));
+			resultObject.Set(Napi::String::New(env, "end"), Napi::Function::New(env, endMethod));
+			resultObject.Set(Napi::String::New(env, "getQueuedSampleCount"), Napi::Function::New(env, getQueuedSampleCountMethod));
+		}
+
+		if (useClip) {
+			auto seekMethod = [this](const Napi::CallbackInfo& info) {
+				this->seekTargetFrame = info[0].As<Napi::Number>().Int64Value();
+			};
+
+			resultObject.Set(Napi::String::New(env, "seek"), Napi::Function::New(env, seekMethod));
+		}
+
+		if (useMixer) {
+			// Adds a source, played from the given samples, or from a stream if none are given.
+			// Returns the source identifier, or -1 if the maximum number of sources is reached.
+			auto addSourceMethod = [this](const Napi::CallbackInfo& info) {
+				auto sourceChannelCount = info[1].As<Napi::Number>().Int64Value();
+				auto sourceSampleRate = info[2].As<Napi::Number>().Int64Value();
+				auto gain = info[3].As<Napi::Number>().FloatValue();
+				auto pan = info[4].As<Napi::Number>().FloatValue();
+				auto priority = info[5].IsNumber() ? info[5].As<Napi::Number>().Int32Value() : 0;
+
+				SampleSource* source;
+				StreamBuffer* streamBuffer = nullptr;
+
+				if (info[0].IsTypedArray()) {
+					auto samples = info[0].As<Napi::Int16Array>();
+
+					source = new ClipBuffer(samples.Data(), samples.ElementLength(), sourceChannelCount);
+				} else {
+					streamBuffer = new StreamBuffer();
+					source = streamBuffer;
+				}
+
+				auto sourceId = this->mixer->AddSource(source, streamBuffer, sourceChannelCount, sourceSampleRate, gain, pan, priority);
+
+				if (sourceId < 0) {
+					delete source;
+				}
+
+				return Napi::Number::New(info.Env(), double(sourceId));
+			};
+
+			// Returns the stream buffer of a stream source, or nullptr if the source has ended or isn't a stream
+			auto getSourceStreamBuffer = [this](const Napi::CallbackInfo& info) -> StreamBuffer* {
+				auto slot = this->mixer->GetSlot(info[0].As<Napi::Number>().Int64Value());
+
+				return slot != nullptr ? slot->streamBuffer : nullptr;
+			};
+
+			auto appendToSourceMethod = [getSourceStreamBuffer](const Napi::CallbackInfo& info) {
+				auto streamBuffer = getSourceStreamBuffer(info);
+
+				if (streamBuffer != nullptr) {
+					auto samples = info[1].As<Napi::Int16Array>();
+
+					streamBuffer->Append(samples.Data(), samples.ElementLength());
+				}
+			};
+
+			auto endSourceMethod = [getSourceStreamBuffer](const Napi::CallbackInfo& info) {
+				auto streamBuffer = getSourceStreamBuffer(info);
+
+				if (streamBuffer != nullptr) {
+					streamBuffer->End();
+				}
+			};
+
+			auto getSourceQueuedSampleCountMethod = [getSourceStreamBuffer](const Napi::CallbackInfo& info) {
+				auto streamBuffer = getSourceStreamBuffer(info);
+
+				return Napi::Number::New(info.Env(), streamBuffer != nullptr ? double(streamBuffer->GetQueuedSampleCount()) : 0.0);
+			};
+
+			auto setSourceGainMethod = [this](const Napi::CallbackInfo& info) {
+				auto slot = this->mixer->GetSlot(info[0].As<Napi::Number>().Int64Value());
+
+				if (slot != nullptr) {
+					slot->gain.store(info[1].As<Napi::Number>().FloatValue(), std::memory_order_relaxed);
+				}
+			};
+
+			auto setSourcePanMethod = [this](const Napi::CallbackInfo& info) {
+				auto slot = this->mixer->GetSlot(info[0].As<Napi::Number>().Int64Value());
+
+				if (slot != nullptr) {
+					slot->pan.store(info[1].As<Napi::Number>().FloatValue(), std::memory_order_relaxed);
+				}
+			};
+
+			auto setSourcePriorityMethod = [this](const Napi::CallbackInfo& info) {
+				auto slot = this->mixer->GetSlot(info[0].As<Napi::Number>().Int64Value());
+
+				if (slot != nullptr) {
+					slot->priority.store(info[1].As<Napi::Number>().Int32Value(), std::memory_order_relaxed);
+				}
+			};
+
+			// Sets the attack and release times, in milliseconds, and the depth, in decibels, of ducking
+			auto setDuckingMethod = [this](const Napi::CallbackInfo& info) {
+				auto attack = info[0].As<Napi::Number>().FloatValue();
+				auto release = info[1].As<Napi::Number>().FloatValue();
+				auto depth = info[2].As<Napi::Number>().FloatValue();
+
+				this->mixer->SetDucking(attack, release, depth);
+			};
+
+			auto removeSourceMethod = [this](const Napi::CallbackInfo& info) {
+				this->mixer->RequestRemove(info[0].As<Napi::Number>().Int64Value());
+			};
+
+			auto getSourceCountMethod = [this](const Napi::CallbackInfo& info) {
+				return Napi::Number::New(info.Env(), double(this->mixer->GetActiveSourceCount()));
+			};
+
+			resultObject.Set(Napi::String::New(env, "addSource"), Napi::Function::New(env, addSourceMethod));
+			resultObject.Set(Napi::String::New(env, "appendToSource"), Napi::Function::New(env, appendToSourceMethod));
+			resultObject.Set(Napi::String::New(env, "endSource"), Napi::Function::New(env, endSourceMethod));
+			resultObject.Set(Napi::String::New(env, "getSourceQueuedSampleCount"), Napi::Function::New(env, getSourceQueuedSampleCountMethod));
+			resultObject.Set(Napi::String::New(env, "setSourceGain"), Napi::Function::New(env, setSourceGainMethod));
+			resultObject.Set(Napi::String::New(env, "setSourcePan"), Napi::Function::New(env, setSourcePanMethod));
+			resultObject.Set(Napi::String::New(env, "setSourcePriority"), Napi::Function::New(env, setSourcePriorityMethod));
+			resultObject.Set(Napi::String::New(env, "setDucking"), Napi::Function::New(env, setDuckingMethod));
+			resultObject.Set(Napi::String::New(env, "removeSource"), Napi::Function::New(env, removeSourceMethod));
+			resultObject.Set(Napi::String::New(env, "getSourceCount"), Napi::Function::New(env, getSourceCountMethod));
+		}
+
+		// Resolve initialization promise with the result object
+		initializationPromiseDeferred.Resolve(resultObject);
+
+		return initializationPromise;
+	}
+
+	void RequestDispose() {
+		trace("Dispose requested..\n");
+
+		this->disposeRequested = true;
+	}
+
+	void RequestFlush() {
+		trace("Flush requested..\n");
+
+		// Discard samples appended to the stream buffer so far
+		if (this->streamBuffer != nullptr) {
+			this->streamBuffer->Discard();
+		}
+
+		this->flushRequested = true;
+	}
+
+private:
+	// Writes frames to the backend, and records them in the write history
+	int64_t WriteSamples(const int16_t* samples, int64_t frameCount) {
+		auto writeStartTime = getMonotonicTime();
+		AUDIO_IO_PROBE2(write__enter, this, frameCount);
+
+		this->writeStartFrame = this->framesWritten;
+
+		auto writeResult = this->backend->Write(samples, frameCount);
+
+		AUDIO_IO_PROBE2(write__exit, this, writeResult);
+
+		auto writeEndTime = getMonotonicTime();
+
+		this->stats.writeDuration.Record((writeEndTime - writeStartTime) / 1000);
+		this->RecordTraceEvent(TraceEventType::Write, writeStartTime, writeEndTime - writeStartTime, writeResult);
+
+		for (int64_t i = 0; i < writeResult; i++) {
+			auto historyOffset = ((this->framesWritten + i) % this->writeHistoryFrameCount) * this->channelCount;
+
+			std::memcpy(&this->writeHistory[historyOffset], samples + (i * this->channelCount), this->channelCount * sizeof(int16_t));
+		}
+
+		if (writeResult > 0) {
+			this->framesWritten += writeResult;
+
+			this->PublishPosition();
+		}
+
+		return writeResult;
+	}
+
+	// Records statistics for a wakeup of the output thread, given the number of frames still queued in the device.
+	//
+	// The first wakeup after playback was started, resumed, or recovered from an underrun, is only used as
+	// a reference for the next one.
+	void RecordWakeup(int64_t queuedFrameCount) {
+		auto currentTime = getMonotonicTime();
+
+		if (this->lastWakeupTime >= 0) {
+			auto interval = currentTime - this->lastWakeupTime;
+
+			this->stats.wakeupJitter.Record(std::abs(interval - this->idealWakeupInterval) / 1000);
+			this->stats.bufferFill.Record(queuedFrameCount);
+			this->stats.slack.Record((queuedFrameCount * 1000000) / this->deviceSampleRate);
+
+			if (queuedFrameCount < this->periodFrameCount) {
+				this->stats.deadlineMissCount++;
+			}
+		}
+
+		this->lastWakeupTime = currentTime;
+	}
+
+	// Publishes the current playback position, for other threads to read
+	void PublishPosition() {
+		PlaybackPositionSnapshot snapshot;
+
+		if (this->nativeSource != nullptr) {
+			snapshot.contentFrameOffset = this->nativeSource->GetReadOffset() / this->channelCount;
+		} else {
+			snapshot.contentFrameOffset = this->handlerFrameOffset;
+		}
+
+		// Content read since the last update was written at the start of the last write. A seek moves the offset
+		// without writing, so the frames already written are then taken as content.
+		if (snapshot.contentFrameOffset > this->lastContentFrameOffset) {
+			auto contentFrameCount = snapshot.contentFrameOffset - this->lastContentFrameOffset;
+
+			this->contentEndFrame = std::min(this->writeStartFrame + contentFrameCount, this->framesWritten);
+		} else if (snapshot.contentFrameOffset < this->lastContentFrameOffset) {
+			this->contentEndFrame = this->framesWritten;
+		}
+
+		this->lastContentFrameOffset = snapshot.contentFrameOffset;
+
+		snapshot.contentEndFrame = std::min(this->contentEndFrame, this->framesWritten);
+
+		if (this->GetDelayWithTimestamp(snapshot.delayFrameCount, snapshot.timestamp, snapshot.isRunning) < 0) {
+			return;
+		}
+
+		snapshot.framesWritten = this->framesWritten;
+
+		// The offset delay is kept within the frames written
+		snapshot.delayFrameCount = std::clamp(snapshot.delayFrameCount + this->latencyOffsetFrameCount, int64_t(0), snapshot.framesWritten);
+
+		this->playbackPosition->Publish(snapshot);
+
+		if (this->sharedStatus != nullptr) {
+			OutputState state;
+
+			if (!this->isStarted) {
+				state = OutputState::NotStarted;
+			} else if (this->isPaused) {
+				state = OutputState::Paused;
+			} else {
+				state = OutputState::Playing;
+			}
+
+			this->PublishSharedStatus(snapshot, state);
+		}
+	}
+
+	// Publishes the given position snapshot and state to the shared status buffer
+	void PublishSharedStatus(const PlaybackPositionSnapshot& snapshot, OutputState state) {
+		auto playedFrame = snapshot.framesWritten - snapshot.delayFrameCount;
+
+		SharedStatusValues values;
+
+		values.state = state;
+		values.framesWritten = snapshot.framesWritten;
+		values.playedFrame = playedFrame;
+		values.delayFrameCount = snapshot.delayFrameCount;
+		values.playedContentFrame = this->playbackPosition->GetPlayedContentFrame(snapshot, playedFrame);
+		values.timestamp = snapshot.timestamp;
+		values.underrunCount = this->stats.underrunCount;
+		values.deviceSampleRate = this->deviceSampleRate;
+
+		this->sharedStatus->Publish(values);
+	}
+
+	// Recovers from a buffer underrun, and records it in the statistics and trace
+	int RecoverFromUnderrun() {
+		auto recoverStartTime = getMonotonicTime();
+
+		this->stats.underrunCount++;
+		this->RecordTraceEvent(TraceEventType::Underrun, recoverStartTime, -1, this->framesWritten);
+		AUDIO_IO_PROBE2(underrun, this, this->framesWritten);
+
+		auto recoverResult = this->backend->Recover(-EPIPE);
+
+		AUDIO_IO_PROBE2(recover, this, recoverResult);
+
+		this->RecordTraceEvent(TraceEventType::Recover, recoverStartTime, getMonotonicTime() - recoverStartTime, recoverResult);
+
+		if (recoverResult < 0) {
+			this->stats.recoveryFailureCount++;
+
+			return recoverResult;
+		}
+
+		this->stats.recoveryCount++;
+		this->lastWakeupTime = -1;
+
+		return recoverResult;
+	}
+
+	// Records a trace event, if tracing is enabled, and the output's trace ring was created
+	void RecordTraceEvent(TraceEventType type, int64_t startTime, int64_t duration, int64_t argument = 0) {
+		if (!tracingEnabled.load(std::memory_order_relaxed) || this->traceRing == nullptr) {
+			return;
+		}
+
+		this->traceRing->Record(type, startTime, duration, argument);
+	}
+
+	// Requests the JavaScript thread to call the handler with the given output buffer, and waits until it has returned.
+	// Doesn't allocate or lock.
+	//
+	// Returns false if the output was stopped in drop mode while waiting, including when the environment is shutting down.
+	// The handler may then still be running, or not be called at all.
+	bool CallHandler(int bufferIndex) {
+		auto requestTime = getMonotonicTime();
+
+		this->handlerBufferIndex = bufferIndex;
+		this->handlerRequestTime = requestTime;
+
+		this->pendingAsyncWork.fetch_or(CallHandlerWork);
+		uv_async_send(this->asyncWakeup);
+
+		while (true) {
+			timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+
+			auto deadlineNanoseconds = int64_t(deadline.tv_nsec) + this->handlerWaitInterval;
+
+			deadline.tv_sec += deadlineNanoseconds / 1000000000;
+			deadline.tv_nsec = deadlineNanoseconds % 1000000000;
+
+			if (sem_timedwait(&this->handlerCompletedSemaphore, &deadline) == 0) {
+				auto resumeTime = getMonotonicTime();
+
+				this->stats.handlerRoundTrip.Record((resumeTime - requestTime) / 1000);
+
+				// The semaphore orders the call times written by the JavaScript thread before this
+				auto callStartTime = this->handlerCallStartTime;
+				auto callEndTime = this->handlerCallEndTime;
+
+				this->RecordTraceEvent(TraceEventType::HandlerDispatch, requestTime, callStartTime - requestTime);
+				this->RecordTraceEvent(TraceEventType::Handler, callStartTime, callEndTime - callStartTime, this->handlerBufferFrameCount);
+				this->RecordTraceEvent(TraceEventType::HandlerRoundTrip, requestTime, resumeTime - requestTime);
+
+				return true;
+			}
+
+			if (this->disposeRequested && this->stopMode == int(StopMode::Drop)) {
+				// Cancel the request, if the JavaScript thread hasn't taken it yet
+				this->pendingAsyncWork.fetch_and(~CallHandlerWork);
+
+				return false;
+			}
+
+			if (this->concealUnderruns) {
+				this->ConcealLateHandler();
+			}
+		}
+	}
+
+	// Writes a period of silence if less than a period is left queued in the running device, while the handler is late.
+	// The handler's buffer is written after it, once the handler returns.
+	void ConcealLateHandler() {
+		BackendStatus status;
+
+		if (this->backend->GetStatus(status) < 0 || status.state != BackendState::Running) {
+			return;
+		}
+
+		if (status.delayFrameCount >= this->periodFrameCount) {
+			return;
+		}
+
+		auto concealStartTime = getMonotonicTime();
+		auto silentFrameCount = std::min(this->periodFrameCount, this->handlerBufferFrameCount);
+
+		if (this->WriteFrames(this->silenceBuffer.data(), silentFrameCount) < 0) {
+			return;
+		}
+
+		this->stats.concealedPeriodCount++;
+		this->RecordTraceEvent(TraceEventType::Conceal, concealStartTime, getMonotonicTime() - concealStartTime, silentFrameCount);
+	}
+
+	// Called on the JavaScript thread, when woken by the output thread
+	static void OnAsyncWakeup(uv_async_t* handle) {
+		auto output = static_cast<NodeAudioOutput*>(handle->data);
+
+		output->ProcessAsyncWork();
+	}
+
+	void ProcessAsyncWork() {
+		auto work = this->pendingAsyncWork.exchange(0);
+
+		if (work == 0) {
+			return;
+		}
+
+		Napi::Env env(this->env);
+		Napi::HandleScope scope(env);
+
+		if (work & CallHandlerWork) {
+			auto callRequestTime = this->handlerRequestTime.load();
+			auto callStartTime = getMonotonicTime();
+			AUDIO_IO_PROBE1(handler__enter, this);
+
+			this->stats.handlerLatency.Record((callStartTime - callRequestTime) / 1000);
+
+			// Get current buffer
+			auto currentBuffer = this->outputBuffers[this->handlerBufferIndex].Value();
+
+			// Set current buffer to all 0s (silence)
+			std::memset((void*)currentBuffer.Data(), 0, currentBuffer.ByteLength());
+
+			// Call back to JavaScript to have the buffer filled with samples
+			this->CallJavaScript(this->handlerReference, { currentBuffer });
+
+			AUDIO_IO_PROBE1(handler__return, this);
+
+			auto callEndTime = getMonotonicTime();
+
+			this->stats.handlerDuration.Record((callEndTime - callStartTime) / 1000);
+
+			// Recorded to the trace ring by the output thread, once it resumes
+			this->handlerCallStartTime = callStartTime;
+			this->handlerCallEndTime = callEndTime;
+
+			sem_post(&this->handlerCompletedSemaphore);
+		}
+
+		if (work & SendMarkerEventWork) {
+			auto frame = this->markerEventFrame.load();
+			auto time = this->markerEventTime.load();
+
+			this->CallJavaScript(this->eventCallbackReference, { Napi::String::New(env, "markers"), Napi::Number::New(env, double(frame)), Napi::BigInt::New(env, time) });
+
+			this->markerEventPending = false;
+		}
+
+		if (work & MixerSourceEndedWork) {
+			this->finishedMixerSourceIds.clear();
+			this->mixer->CollectFinishedSources(this->finishedMixerSourceIds);
+
+			for (auto sourceId : this->finishedMixerSourceIds) {
+				if (!this->hasEventCallback) {
+					break;
+				}
+
+				this->CallJavaScript(this->eventCallbackReference, { Napi::String::New(env, "sourceEnded"), Napi::Number::New(env, double(sourceId)) });
+			}
+		}
+	}
+
+	// Calls a JavaScript function from the async wakeup. An exception thrown by the function is reported
+	// as uncaught, like it would have been if called through a callback wrapper.
+	void CallJavaScript(Napi::FunctionReference& function, const std::initializer_list<napi_value>& args) {
+		try {
+			function.MakeCallback(Napi::Env(this->env).Global(), args, *this->asyncContext);
+		} catch (const Napi::Error& error) {
+			napi_fatal_exception(this->env, error.Value());
+		}
+	}
+
+	// Sends an `error` event, with a message for the given error code, and the operation that failed (like "writing").
+	// JavaScript throws it as an uncaught exception.
+	// Only used when the output is about to stop, so allocating is allowed. Only the first error is reported.
+	void ReportError(int errorCode, const char* operation) {
+		RealtimeSectionSuspension suspension;
+
+		if (!this->eventCallbackWrapper || this->errorReported) {
+			return;
+		}
+
+		this->errorReported = true;
+
+		char message[256];
+		snprintf(message, sizeof(message), "Error %d occurred while %s audio output: %s", errorCode, operation, this->backend->GetErrorDescription(errorCode));
+
+		std::string messageString(message);
+
+		this->eventCallbackWrapper.NonBlockingCall([messageString](Napi::Env env, Napi::Function jsCallback) {
+			jsCallback.Call({ Napi::String::New(env, "error"), Napi::String::New(env, messageString) });
+		});
+	}
+
+	// Writes frames to the backend, recovering from a buffer underrun if needed
+	int64_t WriteFrames(const int16_t* samples, int64_t frameCount) {
+		auto writeResult = this->WriteSamples(samples, frameCount);
+
+		if (writeResult == -EPIPE) {
+			trace("Buffer underrun detected\n");
+
+			auto recoverResult = this->RecoverFromUnderrun();
+
+			if (recoverResult < 0) {
+				return recoverResult;
+			}
+
+			trace("Buffer underrun recovered\n");
+
+			writeResult = this->WriteSamples(samples, frameCount);
+		}
+
+		return writeResult;
+	}
+
+	// Rewinds the queued frames that haven't played yet, except for the few closest to the hardware position.
+	//
+	// Returns the number of frames rewound, or a negative error code if the frames couldn't be rewound.
+	int64_t RewindQueuedFrames() {
+		auto rewindableFrameCount = this->backend->GetRewindableFrameCount();
+
+		if (rewindableFrameCount < 0) {
+			return rewindableFrameCount;
+		}
+
+		auto framesToRewind = rewindableFrameCount - this->rewindSafetyFrameCount;
+
+		if (framesToRewind <= 0) {
+			return 0;
+		}
+
+		auto rewoundFrameCount = this->backend->Rewind(framesToRewind);
+
+		if (rewoundFrameCount < 0) {
+			trace("Failed to rewind ALSA output\n");
+
+			return rewoundFrameCount;
+		}
+
+		this->framesWritten -= rewoundFrameCount;
+		this->contentEndFrame = std::min(this->contentEndFrame, this->framesWritten);
+
+		this->PublishPosition();
+
+		return rewoundFrameCount;
+	}
+
+	// Writes `frameCount` frames with a linear crossfade, from the rewound frames, taken from the write history,
+	// to the frames in `fadeInBuffer`. Rewound frames beyond `rewoundFrameCount`, and frames of `fadeInBuffer`,
+	// if `fadeIn` is false, are taken as silence.
+	int64_t WriteCrossfade(int64_t frameCount, int64_t rewoundFrameCount, bool fadeIn) {
+		// Gather the rewound frames from the write history, then crossfade from them in place
+		for (int64_t i = 0; i < frameCount; i++) {
+			auto historyOffset = ((this->framesWritten + i) % this->writeHistoryFrameCount) * this->channelCount;
+			auto fadeOffset = i * this->channelCount;
+
+			if (i < rewoundFrameCount) {
+				std::memcpy(&this->fadeBuffer[fadeOffset], &this->writeHistory[historyOffset], this->channelCount * sizeof(int16_t));
+			} else {
+				std::fill_n(&this->fadeBuffer[fadeOffset], this->channelCount, int16_t(0));
+			}
+		}
+
+		CrossfadeInt16(this->fadeBuffer.data(), fadeIn ? this->fadeInBuffer.data() : nullptr, this->fadeBuffer.data(), frameCount, this->channelCount);
+
+		return this->WriteFrames(this->fadeBuffer.data(), frameCount);
+	}
+
+	// Rewinds the queued frames that haven't played yet, and rewrites the first of them with a fade-out,
+	// so the output becomes silent shortly after, without a click.
+	//
+	// Returns false if the frames couldn't be rewound.
+	bool FadeOutQueuedFrames() {
+		auto rewoundFrameCount = this->RewindQueuedFrames();
+
+		if (rewoundFrameCount < 0) {
+			return false;
+		}
+
+		// If only a few frames are left to play, there's nothing to fade
+		if (rewoundFrameCount == 0) {
+			return true;
+		}
+
+		auto framesToFade = std::min(int64_t(rewoundFrameCount), this->fadeFrameCount);
+
+		auto writeResult = this->WriteCrossfade(framesToFade, rewoundFrameCount, false);
+
+		trace("Rewound %d frames, and rewrote %d of them with a fade-out\n", rewoundFrameCount, framesToFade);
+
+		return writeResult >= 0;
+	}
+
+	// Moves the clip read position to the given frame, discarding queued frames.
+	//
+	// The queued frames are rewound, and crossfaded to the frames at the new position. If rewinding isn't supported,
+	// they are dropped, and the new frames are faded in.
+	void Seek(int64_t targetFrame) {
+		trace("Seeking to frame %d..\n", targetFrame);
+
+		this->clipBuffer->SetFramePosition(targetFrame);
+
+		// When paused, discard the frames that would have been rewritten when resuming
+		if (this->isPaused) {
+			this->DiscardPausedFrames();
+
+			return;
+		}
+
+		auto rewoundFrameCount = this->RewindQueuedFrames();
+
+		if (rewoundFrameCount < 0) {
+			this->DropQueuedFrames();
+			this->backend->Prepare();
+
+			rewoundFrameCount = 0;
+		}
+
+		// Read the frames to fade in from the clip. If it ends before the fade does, the remainder is silent.
+		std::fill(this->fadeInBuffer.begin(), this->fadeInBuffer.end(), 0);
+
+		auto samplesRead = this->clipBuffer->Read(this->fadeInBuffer.data(), this->fadeInBuffer.size());
+
+		if (samplesRead > 0) {
+			this->WriteCrossfade(samplesRead / this->channelCount, rewoundFrameCount, true);
+		}
+	}
+
+	// Gets the number of frames currently queued in the device, the monotonic time at which that was measured,
+	// and whether the device is running
+	int GetDelayWithTimestamp(int64_t& delayInFrames, int64_t& timestamp, bool& isRunning) {
+		BackendStatus status;
+
+		auto timeBefore = getMonotonicTime();
+		auto statusResult = this->backend->GetStatus(status);
+		auto timeAfter = getMonotonicTime();
+
+		if (statusResult < 0) {
+			return statusResult;
+		}
+
+		isRunning = status.state == BackendState::Running;
+
+		if (isRunning) {
+			// Includes frames in the buffer, and any additional delay reported by the driver
+			delayInFrames = status.delayFrameCount;
+		} else if (status.state == BackendState::Prepared || status.state == BackendState::Paused) {
+			// The reported delay is only valid while running, so derive the queued frames from the available space
+			delayInFrames = this->writeHistoryFrameCount - status.availableFrameCount;
+		} else {
+			delayInFrames = 0;
+		}
+
+		delayInFrames = std::max(std::min(delayInFrames, this->framesWritten), int64_t(0));
+
+		// Use the backend's timestamp if it's taken from the monotonic clock (for ALSA, depends on the driver and
+		// ALSA version). Otherwise, use the midpoint of the status request.
+		if (isRunning && status.timestamp >= timeBefore - 1000000 && status.timestamp <= timeAfter) {
+			timestamp = status.timestamp;
+		} else {
+			timestamp = timeBefore + ((timeAfter - timeBefore) / 2);
+		}
+
+		return 0;
+	}
+
+	// Returns the number of silent frames to write before the scheduled start, or 0 if content should be written
+	int64_t GetFramesUntilScheduledStart() {
+		if (this->scheduledStartFrame >= 0) {
+			auto remainingFrameCount = this->scheduledStartFrame - this->framesWritten;
+
+			if (remainingFrameCount > 0) {
+				return remainingFrameCount;
+			}
+
+			this->scheduledStartFrame = -1;
+		}
+
+		if (this->scheduledStartTime >= 0) {
+			// If the device isn't running yet, start it with a period of silence,
+			// so the time at which the next frame would play can be measured
+			if (this->backend->GetState() != BackendState::Running) {
+				return this->periodFrameCount;
+			}
+
+			int64_t delayInFrames;
+			int64_t timestamp;
+			bool isRunning;
+
+			if (this->GetDelayWithTimestamp(delayInFrames, timestamp, isRunning) < 0) {
+				this->scheduledStartTime = -1;
+
+				return 0;
+			}
+
+			// The next frame written would play after the queued frames have played.
+			// Compute the number of frames between that time and the scheduled time.
+			//
+			// This is recomputed on every iteration, so the final count is based on the most recent measurement.
+			auto framesUntilScheduledTime = ((this->scheduledStartTime - timestamp) * this->deviceSampleRate) / 1000000000;
+			auto remainingFrameCount = framesUntilScheduledTime - delayInFrames;
+
+			if (remainingFrameCount > 0) {
+				return remainingFrameCount;
+			}
+
+			if (remainingFrameCount < 0) {
+				trace("Scheduled start is late by %d frames\n", -remainingFrameCount);
+			}
+
+			this->scheduledStartTime = -1;
+		}
+
+		return 0;
+	}
+
+	// Sends a `markers` event if the content frame currently playing has reached the next marker,
+	// and no previous event is still waiting to be handled
+	void CheckMarkers() {
+		auto nextMarker = this->nextMarkerFrame.load();
+
+		if (nextMarker < 0 || this->markerEventPending) {
+			return;
+		}
+
+		auto currentTime = getMonotonicTime();
+		auto snapshot = this->playbackPosition->Read();
+
+		auto playedFrame = this->playbackPosition->GetPlayedFrameAt(snapshot, currentTime);
+		auto playedContentFrame = this->playbackPosition->GetPlayedContentFrame(snapshot, playedFrame);
+
+		if (playedContentFrame < nextMarker) {
+			return;
+		}
+
+		this->SendMarkerEvent(playedContentFrame, currentTime);
+	}
+
+	// Sends a `markers` event, with the content frame playing at the given monotonic time.
+	// JavaScript fires all markers up to that frame, then sets the next marker frame.
+	//
+	// Doesn't allocate or lock.
+	void SendMarkerEvent(int64_t playedContentFrame, int64_t time) {
+		if (!this->hasEventCallback) {
+			return;
+		}
+
+		this->markerEventFrame = playedContentFrame;
+		this->markerEventTime = time;
+		this->markerEventPending = true;
+
+		this->pendingAsyncWork.fetch_or(SendMarkerEventWork);
+		uv_async_send(this->asyncWakeup);
+	}
+
+	bool HasPendingRequest() {
+		return
+			this->flushRequested ||
+			this->seekTargetFrame >= 0 ||
+			this->pauseRequested != this->isPaused ||
+			(this->disposeRequested && this->stopMode != int(StopMode::Drain));
+	}
+
+	// Pauses the output, using the device's pause support, if available.
+	//
+	// Otherwise, the queued frames are dropped, and would be rewritten from the write history when resuming,
+	// meaning playback continues from the exact frame it was paused at.
+	void Pause() {
+		trace("Pausing ALSA output..\n");
+
+		this->isPaused = true;
+		this->lastWakeupTime = -1;
+
+		if (this->canPauseInHardware && this->backend->GetState() == BackendState::Running) {
+			auto pauseResult = this->backend->Pause(true);
+
+			if (pauseResult == 0) {
+				this->isPausedInHardware = true;
+
+				this->PublishPosition();
+
+				return;
+			}
+
+			trace("Failed to pause ALSA output: %s\n", snd_strerror(pauseResult));
+		}
+
+		this->prefillFrameCount = this->DropQueuedFrames();
+	}
+
+	void Resume() {
+		trace("Resuming ALSA output..\n");
+
+		this->isPaused = false;
+
+		if (this->isPausedInHardware) {
+			this->isPausedInHardware = false;
+
+			auto resumeResult = this->backend->Pause(false);
+
+			if (resumeResult == 0) {
+				this->PublishPosition();
+
+				return;
+			}
+
+			trace("Failed to resume ALSA output: %s\n", snd_strerror(resumeResult));
+
+			this->prefillFrameCount = this->DropQueuedFrames();
+		}
+
+		this->backend->Prepare();
+
+		// Rewrite the frames that were dropped when pausing
+		if (this->prefillFrameCount > 0) {
+			for (int64_t i = 0; i < this->prefillFrameCount; i++) {
+				auto historyOffset = ((this->framesWritten + i) % this->writeHistoryFrameCount) * this->channelCount;
+
+				std::memcpy(&this->prefillBuffer[i * this->channelCount], &this->writeHistory[historyOffset], this->channelCount * sizeof(int16_t));
+			}
+
+			// The rewritten frames end with the same content as before they were dropped
+			this->contentEndFrame = this->prefillContentEndFrame;
+
+			this->WriteFrames(this->prefillBuffer.data(), this->prefillFrameCount);
+
+			this->prefillFrameCount = 0;
+		}
+	}
+
+	// Discards the frames that were queued when the output was paused
+	void DiscardPausedFrames() {
+		this->prefillFrameCount = 0;
+
+		if (this->isPausedInHardware) {
+			this->isPausedInHardware = false;
+
+			this->DropQueuedFrames();
+		}
+	}
+
+	// Drops all queued frames, and removes them from the output's timeline.
+	//
+	// Returns the number of frames dropped.
+	int64_t DropQueuedFrames() {
+		int64_t delayInFrames = 0;
+		int64_t timestamp;
+		bool isRunning;
+
+		if (this->GetDelayWithTimestamp(delayInFrames, timestamp, isRunning) < 0) {
+			delayInFrames = 0;
+		}
+
+		this->backend->Drop();
+
+		auto droppedFrameCount = std::min(delayInFrames, this->writeHistoryFrameCount);
+
+		this->framesWritten -= droppedFrameCount;
+
+		this->prefillContentEndFrame = this->contentEndFrame;
+		this->contentEndFrame = std::min(this->contentEndFrame, this->framesWritten);
+
+		this->PublishPosition();
+
+		return droppedFrameCount;
+	}
+
+	// Discards all frames queued in the ALSA buffer, and keeps the output running
+	void Flush() {
+		// When paused, discard the frames that would have been rewritten when resuming
+		if (this->isPaused) {
+			this->DiscardPausedFrames();
+
+			return;
+		}
+
+		if (this->FadeOutQueuedFrames()) {
+			return;
+		}
+
+		// If rewinding isn't supported, drop the queued frames and prepare the output for new writes
+		this->DropQueuedFrames();
+		this->backend->Prepare();
+	}
+
+	// Called on the JavaScript thread, once the output thread has released the main callback wrapper,
+	// or if initialization failed, or when the environment is torn down
+	void OnCallbackWrapperFinalized(Napi::Env env) {
+		// If the environment is torn down while the output thread is still running, stop it immediately
+		if (!this->outputThreadFinished) {
+			this->stopMode = int(StopMode::Drop);
+			this->RequestDispose();
+		}
+
+		if (this->outputThread.joinable()) {
+			this->outputThread.join();
+		}
+
+		trace("Output thread joined\n");
+
+		// Remove from the live outputs, so this output is no longer included in the process-wide usage
+		{
+			std::lock_guard<std::mutex> lock(liveOutputsMutex);
+
+			liveOutputs.erase(std::remove(liveOutputs.begin(), liveOutputs.end(), this), liveOutputs.end());
+		}
+
+		// Collect the final statistics and resource usage, since they can't be read after this object is deleted
+		auto finalResult = Napi::Object::New(env);
+
+		finalResult.Set("stats", this->CreateStatsObject(env));
+		finalResult.Set("resourceUsage", CreateResourceUsageObject(env, this->GetResourceUsage()));
+
+		if (this->virtualDevice != nullptr) {
+			finalResult.Set("virtualDevice", CreateVirtualDeviceStatsObject(env, this->virtualDevice->GetStats()));
+		}
+
+		delete this->backend;
+		delete this->nativeSource;
+		delete this->playbackPosition;
+		delete this->sharedStatus;
+
+		// Close the async wakeup. Any pending wakeup is discarded. The handle is freed once closed.
+		uv_close((uv_handle_t*)this->asyncWakeup, [](uv_handle_t* handle) {
+			delete (uv_async_t*)handle;
+
+			openAsyncHandleCount--;
+		});
+
+		sem_destroy(&this->handlerCompletedSemaphore);
+
+		delete this->asyncContext;
+
+		this->disposedDeferred->Resolve(finalResult);
+
+		delete this->disposedDeferred;
+
+		// Delete NodeAudioOutput object. This also deletes the references to the output buffers and status buffer.
+		delete this;
+	}
+
+	// Samples the CPU time and context switch counts of the output thread. Must be called on the output thread.
+	// Unless forced, only samples if at least `threadUsageSampleInterval` has passed since the last sample.
+	void SampleThreadUsage(bool force) {
+		auto currentTime = getMonotonicTime();
+
+		if (!force && this->lastThreadUsageSampleTime >= 0 && currentTime - this->lastThreadUsageSampleTime < threadUsageSampleInterval) {
+			return;
+		}
+
+		this->lastThreadUsageSampleTime = currentTime;
+
+		timespec cpuTime;
+
+		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime) == 0) {
+			this->threadCpuTime = (int64_t(cpuTime.tv_sec) * 1000000000) + cpuTime.tv_nsec;
+		}
+
+		rusage usage;
+
+		if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+			this->voluntaryContextSwitchCount = usage.ru_nvcsw;
+			this->involuntaryContextSwitchCount = usage.ru_nivcsw;
+		}
+	}
+
+public:
+	ResourceUsage GetResourceUsage() {
+		ResourceUsage usage;
+
+		usage.threadCpuTime = this->threadCpuTime;
+		usage.voluntaryContextSwitchCount = this->voluntaryContextSwitchCount;
+		usage.involuntaryContextSwitchCount = this->involuntaryContextSwitchCount;
+		usage.nativeByteCount = this->GetNativeByteCount();
+
+		return usage;
+	}
+
+private:
+	// Returns the number of bytes of native memory held by the output. Buffers are only allocated when initializing,
+	// except for the native source's buffers, and the trace ring.
+	int64_t GetNativeByteCount() {
+		int64_t byteCount = sizeof(NodeAudioOutput);
+
+		byteCount += this->writeHistory.capacity() * sizeof(int16_t);
+		byteCount += this->prefillBuffer.capacity() * sizeof(int16_t);
+		byteCount += this->fadeBuffer.capacity() * sizeof(int16_t);
+		byteCount += this->fadeInBuffer.capacity() * sizeof(int16_t);
+		byteCount += this->silenceBuffer.capacity() * sizeof(int16_t);
+		byteCount += this->sourcePeriodBufferByteCount;
+		byteCount += this->outputBufferByteCount;
+
+		if (this->playbackPosition != nullptr) {
+			byteCount += sizeof(PlaybackPosition);
+		}
+
+		if (this->sharedStatus != nullptr) {
+			byteCount += sizeof(SharedStatus);
+		}
+
+		if (this->nativeSource != nullptr) {
+			byteCount += this->nativeSource->GetHeldByteCount();
+		}
+
+		if (this->holdsTraceRing) {
+			byteCount += sizeof(TraceRing);
+		}
+
+		return byteCount;
+	}
+
+	Napi::Object CreateStatsObject(Napi::Env env) {
+		auto result = Napi::Object::New(env);
+
+		result.Set("underrunCount", Napi::Number::New(env, double(this->stats.underrunCount)));
+		result.Set("recoveryCount", Napi::Number::New(env, double(this->stats.recoveryCount)));
+		result.Set("recoveryFailureCount", Napi::Number::New(env, double(this->stats.recoveryFailureCount)));
+		result.Set("deadlineMissCount", Napi::Number::New(env, double(this->stats.deadlineMissCount)));
+		result.Set("concealedPeriodCount", Napi::Number::New(env, double(this->stats.concealedPeriodCount)));
+
+		result.Set("handlerLatency", CreateHistogramObject(env, this->stats.handlerLatency));
+		result.Set("handlerDuration", CreateHistogramObject(env, this->stats.handlerDuration));
+		result.Set("handlerRoundTrip", CreateHistogramObject(env, this->stats.handlerRoundTrip));
+		result.Set("writeDuration", CreateHistogramObject(env, this->stats.writeDuration));
+		result.Set("wakeupJitter", CreateHistogramObject(env, this->stats.wakeupJitter));
+		result.Set("slack", CreateHistogramObject(env, this->stats.slack));
+		result.Set("bufferFill", CreateHistogramObject(env, this->stats.bufferFill));
+		result.Set("mixDuration", CreateHistogramObject(env, this->stats.mixDuration));
+
+		return result;
+	}
+
+	void ReleaseCallbackWrappers() {
+		this->threadSafeCallbackWrapper.Release();
+
+		if (this->eventCallbackWrapper) {
+			this->eventCallbackWrapper.Release();
+		}
+	}
+};
+
+Napi::Promise createAudioOutput(const Napi::CallbackInfo& info) {
+	auto env = info.Env();
+
+	auto output = new NodeAudioOutput();
+
+	return output->Initialize(info);
+}
+
+void setTracingEnabled(const Napi::CallbackInfo& info) {
+	tracingEnabled = info[0].ToBoolean().Value();
+}
+
+// Drains the trace events recorded by all output threads, and returns them packed into a Float64Array,
+// with `traceEventFieldCount` elements per event
+Napi::Value drainTraceEvents(const Napi::CallbackInfo& info) {
+	auto env = info.Env();
+
+	auto events = traceRegistry.Drain();
+
+	auto result = Napi::Float64Array::New(env, events.size() * traceEventFieldCount);
+
+	for (size_t i = 0; i < events.size(); i++) {
+		auto& event = events[i];
+		auto offset = i * traceEventFieldCount;
+
+		result[offset + 0] = double(event.type);
+		result[offset + 1] = double(event.threadId);
+		result[offset + 2] = double(event.startTime);
+		result[offset + 3] = double(event.duration);
+		result[offset + 4] = double(event.argument);
+	}
+
+	return result;
+}
+
+Napi::Value getDroppedTraceEventCount(const Napi::CallbackInfo& info) {
+	return Napi::Number::New(info.Env(), double(traceRegistry.GetDroppedEventCount()));
+}
+
+// Returns the total resource usage of all live outputs in the process, and their count
+Napi::Value getProcessResourceUsage(const Napi::CallbackInfo& info) {
+	auto env = info.Env();
+
+	ResourceUsage total;
+	int64_t outputCount = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(liveOutputsMutex);
+
+		for (auto output : liveOutputs) {
+			auto usage = output->GetResourceUsage();
+
+			total.threadCpuTime += usage.threadCpuTime;
+			total.voluntaryContextSwitchCount += usage.voluntaryContextSwitchCount;
+			total.involuntaryContextSwitchCount += usage.involuntaryContextSwitchCount;
+			total.nativeByteCount += usage.nativeByteCount;
+		}
+
+		outputCount = liveOutputs.size();
+	}
+
+	auto result = CreateResourceUsageObject(env, total);
+
+	result.Set("outputCount", Napi::Number::New(env, double(outputCount)));
+
+	return result;
+}
+
+// Returns the number of native objects currently allocated, to check that disposed outputs don't leak any
+Napi::Value getNativeObjectCounts(const Napi::CallbackInfo& info) {
+	auto env = info.Env();
+
+	int64_t liveOutputCount = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(liveOutputsMutex);
+
+		liveOutputCount = liveOutputs.size();
+	}
+
+	auto result = Napi::Object::New(env);
+
+	result.Set("outputCount", Napi::Number::New(env, double(allocatedOutputCount)));
+	result.Set("liveOutputCount", Napi::Number::New(env, double(liveOutputCount)));
+	result.Set("asyncHandleCount", Napi::Number::New(env, double(openAsyncHandleCount)));
+
+	return result;
+}
+
+// Returns the number of allocations, deallocations and lock operations made within realtime sections so far,
+// or null if the realtime guard library isn't preloaded
+Napi::Value getRealtimeGuardViolations(const Napi::CallbackInfo& info) {
+	auto env = info.Env();
+
+	RealtimeGuardViolationCounts counts;
+
+	if (!GetRealtimeGuardViolationCounts(counts)) {
+		return env.Null();
+	}
+
+	auto result = Napi::Object::New(env);
+
+	result.Set("allocationCount", Napi::Number::New(env, double(counts.allocationCount)));
+	result.Set("deallocationCount", Napi::Number::New(env, double(counts.deallocationCount)));
+	result.Set("lockCount", Napi::Number::New(env, double(counts.lockCount)));
+
+	return result;
+}
+
+// Records from an ALSA capture device on a worker thread, resolving with the samples, and the monotonic time
+// the first frame was captured at
+class CaptureWorker : public Napi::AsyncWorker {
+private:
+	Napi::Promise::Deferred deferred;
+
+	std::string deviceName;
+	int64_t sampleRate;
+	int64_t channelCount;
+	int64_t frameCount;
+
+	std::vector<int16_t> samples;
+	int64_t firstFrameTime = -1;
+
+public:
+	CaptureWorker(Napi::Env env, const std::string& deviceName, int64_t sampleRate, int64_t channelCount, int64_t frameCount) :
+		Napi::AsyncWorker(env),
+		deferred(Napi::Promise::Deferred::New(env)),
+		deviceName(deviceName),
+		sampleRate(sampleRate),
+		channelCount(channelCount),
+		frameCount(frameCount) {
+	}
+
+	Napi::Promise GetPromise() {
+		return this->deferred.Promise();
+	}
+
+	void Execute() override {
+		std::string errorMessage;
+
+		if (CaptureFrames(this->deviceName, this->sampleRate, this->channelCount, this->frameCount, this->samples, this->firstFrameTime, errorMessage) < 0) {
+			this->SetError(errorMessage);
+		}
+	}
+
+	void OnOK() override {
+		auto env = this->Env();
+
+		auto samplesArray = Napi::Int16Array::New(env, this->samples.size());
+		std::copy(this->samples.begin(), this->samples.end(), samplesArray.Data());
+
+		auto result = Napi::Object::New(env);
+
+		result.Set("samples", samplesArray);
+		result.Set("firstFrameTime", Napi::BigInt::New(env, this->firstFrameTime));
+
+		this->deferred.Resolve(result);
+	}
+
+	void OnError(const Napi::Error& error) override {
+		this->deferred.Reject(error.Value());
+	}
+};
+
+Napi::Value captureAudio(const Napi::CallbackInfo& info) {
+	auto configObject = info[0].As<Napi::Object>();
+
+	auto deviceName = configObject.Get("deviceName").As<Napi::String>().Utf8Value();
+	auto sampleRate = configObject.Get("sampleRate").As<Napi::Number>().Int64Value();
+	auto channelCount = configObject.Get("channelCount").As<Napi::Number>().Int64Value();
+	auto frameCount = configObject.Get("frameCount").As<Napi::Number>().Int64Value();
+
+	auto worker = new CaptureWorker(info.Env(), deviceName, sampleRate, channelCount, frameCount);
+
+	worker->Queue();
+
+	return worker->GetPromise();
+}
+
+// Generates a mono test signal: `mls`, a maximum length sequence of the given order, or `impulses`, an impulse
+// every `interval` samples, for `length` samples
+Napi::Value generateTestSignal(const Napi::CallbackInfo& info) {
+	auto env = info.Env();
+
+	auto signalType = info[0].As<Napi::String>().Utf8Value();
+	auto optionsObject = info[1].As<Napi::Object>();
+
+	auto amplitude = static_cast<int16_t>(optionsObject.Get("amplitude").As<Napi::Number>().Int32Value());
+
+	std::vector<int16_t> signal;
+
+	if (signalType == "mls") {
+		auto order = optionsObject.Get("order").As<Napi::Number>().Int32Value();
+
+		GenerateMaximumLengthSequence(order, amplitude, signal);
+	} else {
+		auto length = optionsObject.Get("length").As<Napi::Number>().Int64Value();
+		auto interval = optionsObject.Get("interval").As<Napi::Number>().Int64Value();
+
+		GenerateImpulseTrain(length, interval, amplitude, signal);
+	}
+
+	auto result = Napi::Int16Array::New(env, signal.size());
+	std::copy(signal.begin(), signal.end(), result.Data());
+
+	return result;
+}
+
+// Cross-correlates a mono signal with a shorter reference, for every offset at which the reference fits within it
+Napi::Value crossCorrelate(const Napi::CallbackInfo& info) {
+	auto env = info.Env();
+
+	auto signal = info[0].As<Napi::Int16Array>();
+	auto reference = info[1].As<Napi::Int16Array>();
+
+	std::vector<double> correlation;
+	CrossCorrelate(signal.Data(), signal.ElementLength(), reference.Data(), reference.ElementLength(), correlation);
+
+	auto result = Napi::Float64Array::New(env, correlation.size());
+	std::copy(correlation.begin(), correlation.end(), result.Data());
+
+	return result;
+}
+
+Napi::Object Init(Napi::Env env, Napi::Object exports) {
+	InitializeRealtimeGuard();
+
+	auto backends = Napi::Array::New(env);
+
+	backends.Set(uint32_t(0), Napi::String::New(env, "device"));
+	backends.Set(uint32_t(1), Napi::String::New(env, "null"));
+	backends.Set(uint32_t(2), Napi::String::New(env, "file"));
+	backends.Set(uint32_t(3), Napi::String::New(env, "virtual"));
+
+	exports.Set(Napi::String::New(env, "backends"), backends);
 
-Napi::Object Init(Napi::Env env, Napi::Object exports) {
 	exports.Set(Napi::String::New(env, "createAudioOutput"), Napi::Function::New(env, createAudioOutput));
+	exports.Set(Napi::String::New(env, "setTracingEnabled"), Napi::Function::New(env, setTracingEnabled));
+	exports.Set(Napi::String::New(env, "drainTraceEvents"), Napi::Function::New(env, drainTraceEvents));
+	exports.Set(Napi::String::New(env, "getDroppedTraceEventCount"), Napi::Function::New(env, getDroppedTraceEventCount));
+	exports.Set(Napi::String::New(env, "getProcessResourceUsage"), Napi::Function::New(env, getProcessResourceUsage));
+	exports.Set(Napi::String::New(env, "getNativeObjectCounts"), Napi::Function::New(env, getNativeObjectCounts));
+	exports.Set(Napi::String::New(env, "getRealtimeGuardViolations"), Napi::Function::New(env, getRealtimeGuardViolations));
+	exports.Set(Napi::String::New(env, "captureAudio"), Napi::Function::New(env, captureAudio));
+	exports.Set(Napi::String::New(env, "generateTestSignal"), Napi::Function::New(env, generateTestSignal));
+	exports.Set(Napi::String::New(env, "crossCorrelate"), Napi::Function::New(env, crossCorrelate));
 
 	return exports;
 }
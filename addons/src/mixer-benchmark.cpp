@@ -0,0 +1,180 @@
+// Benchmark of the mixer in `include/Mixer.h`, and of its scaling across threads. Doesn't depend on Node.js.
+//
+// For each source count, and each thread count from 1 to the number of cores, mixes 10ms periods of 48000Hz stereo
+// frames from sources that all need resampling (from 44100Hz), and reports the median, 99th percentile and maximum
+// time per period, the speedup over a single thread, and the fraction of the period spent mixing (`load`).
+// With few sources, the mixer uses fewer threads than it's allowed, so the thread count has little effect.
+//
+// Build with `npm run build-mixer-benchmark`, in the `addons` directory, then run `build/mixer-benchmark`.
+// An optional argument gives the maximum thread count (defaults to the number of cores). The mixer doesn't use
+// more threads than there are cores, which is reported as `effectiveThreadCount`.
+// Results are written to stdout, as JSON.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "../include/Mixer.h"
+
+namespace {
+	const int64_t channelCount = 2;
+	const int64_t sampleRate = 48000;
+	const int64_t sourceSampleRate = 44100;
+	const int64_t periodFrameCount = 480; // 10ms
+	const int64_t sourceCounts[] = { 8, 32, 128, 512, 1024 };
+
+	// Periods mixed before measuring, and measured
+	const int warmupPeriodCount = 20;
+	const int measuredPeriodCount = 300;
+
+	int64_t getMonotonicTime() {
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC, &time);
+
+		return (int64_t(time.tv_sec) * 1000000000) + time.tv_nsec;
+	}
+
+	// A source looping over a shared table of samples, which never ends
+	class LoopingSource : public SampleSource {
+	private:
+		const std::vector<int16_t>& table;
+		int64_t offset;
+		int64_t readOffset = 0;
+
+	public:
+		LoopingSource(const std::vector<int16_t>& table, int64_t offset) : table(table), offset(offset % table.size()) {
+		}
+
+		int64_t Read(int16_t* target, int64_t sampleCount) override {
+			for (int64_t i = 0; i < sampleCount;) {
+				auto copyCount = std::min(sampleCount - i, int64_t(this->table.size()) - this->offset);
+
+				std::copy_n(this->table.data() + this->offset, copyCount, target + i);
+
+				this->offset = (this->offset + copyCount) % this->table.size();
+				i += copyCount;
+			}
+
+			this->readOffset += sampleCount;
+
+			return sampleCount;
+		}
+
+		bool IsExhausted() const override {
+			return false;
+		}
+
+		int64_t GetReadOffset() const override {
+			return this->readOffset;
+		}
+
+		int64_t GetHeldByteCount() const override {
+			return sizeof(LoopingSource);
+		}
+	};
+
+	struct Measurement {
+		double median; // In microseconds
+		double p99;
+		double max;
+	};
+
+	Measurement measure(const std::vector<int16_t>& table, int64_t sourceCount, int64_t threadCount) {
+		Mixer mixer(channelCount, sampleRate, periodFrameCount, sourceCount, threadCount);
+
+		for (int64_t i = 0; i < sourceCount; i++) {
+			mixer.AddSource(new LoopingSource(table, i * 997 * channelCount), nullptr, channelCount, sourceSampleRate, 0.01f, float(i % 21) / 10.0f - 1.0f);
+		}
+
+		std::vector<int16_t> output(periodFrameCount * channelCount);
+		std::vector<double> durations;
+
+		for (int i = 0; i < warmupPeriodCount + measuredPeriodCount; i++) {
+			auto startTime = getMonotonicTime();
+
+			mixer.Read(output.data(), output.size());
+
+			auto endTime = getMonotonicTime();
+
+			if (i >= warmupPeriodCount) {
+				durations.push_back(double(endTime - startTime) / 1000.0);
+			}
+		}
+
+		std::sort(durations.begin(), durations.end());
+
+		return {
+			durations[durations.size() / 2],
+			durations[(durations.size() * 99) / 100],
+			durations.back(),
+		};
+	}
+}
+
+int main(int argc, char** argv) {
+	auto maxThreadCount = int64_t(argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency());
+
+	if (maxThreadCount < 1) {
+		fprintf(stderr, "The maximum thread count must be a positive integer\n");
+
+		return 1;
+	}
+
+	// A second of noise, shared by all sources
+	std::vector<int16_t> table(sourceSampleRate * channelCount);
+
+	for (auto& sample : table) {
+		sample = int16_t(rand() - (RAND_MAX / 2));
+	}
+
+	auto periodDuration = (double(periodFrameCount) / double(sampleRate)) * 1000000.0;
+
+	printf("{\n");
+	printf("  \"compiler\": \"%s\",\n", __VERSION__);
+	printf("  \"instructionSet\": \"%s\",\n", GetSampleKernelInstructionSet());
+	printf("  \"coreCount\": %d,\n", int(std::thread::hardware_concurrency()));
+	printf("  \"sampleRate\": %d,\n", int(sampleRate));
+	printf("  \"sourceSampleRate\": %d,\n", int(sourceSampleRate));
+	printf("  \"channelCount\": %d,\n", int(channelCount));
+	printf("  \"periodFrameCount\": %d,\n", int(periodFrameCount));
+	printf("  \"minSourcesPerThread\": %d,\n", int(minSourcesPerMixThread));
+	printf("  \"results\": [\n");
+
+	auto isFirstResult = true;
+
+	for (auto sourceCount : sourceCounts) {
+		double singleThreadMedian = 0;
+
+		for (int64_t threadCount = 1; threadCount <= maxThreadCount; threadCount++) {
+			fprintf(stderr, "%d sources, %d threads..\n", int(sourceCount), int(threadCount));
+
+			auto measurement = measure(table, sourceCount, threadCount);
+
+			if (threadCount == 1) {
+				singleThreadMedian = measurement.median;
+			}
+
+			printf("%s    { \"sourceCount\": %d, \"threadCount\": %d, \"effectiveThreadCount\": %d, \"median\": %.1f, \"p99\": %.1f, \"max\": %.1f, \"speedup\": %.2f, \"load\": %.3f }",
+				isFirstResult ? "" : ",\n",
+				int(sourceCount),
+				int(threadCount),
+				int(std::min(threadCount, int64_t(std::thread::hardware_concurrency()))),
+				measurement.median,
+				measurement.p99,
+				measurement.max,
+				singleThreadMedian / measurement.median,
+				measurement.median / periodDuration);
+
+			isFirstResult = false;
+		}
+	}
+
+	printf("\n  ]\n}\n");
+
+	return 0;
+}
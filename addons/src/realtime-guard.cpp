@@ -0,0 +1,280 @@
+// Realtime guard library, for debugging. Linux only.
+//
+// When preloaded into a process (using `LD_PRELOAD`), interposes the memory allocation and mutex functions,
+// and checks if they are called by a thread within a realtime section, as marked by the audio output addon
+// (see `include/RealtimeGuard.h`). Each such call is a violation.
+//
+// By default, violations are counted, and the first of each kind is reported to stderr. If the
+// `AUDIO_IO_REALTIME_GUARD` environment variable is set to `abort`, the process is aborted on the first violation,
+// so a debugger, or a core dump, shows where it occurred.
+//
+// Build with `npm run build-realtime-guard-linux`, in the `addons` directory.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include <atomic>
+
+namespace {
+	typedef void* (*MallocFunction)(size_t);
+	typedef void* (*CallocFunction)(size_t, size_t);
+	typedef void* (*ReallocFunction)(void*, size_t);
+	typedef void (*FreeFunction)(void*);
+	typedef int (*PosixMemalignFunction)(void**, size_t, size_t);
+	typedef void* (*AlignedAllocFunction)(size_t, size_t);
+	typedef int (*MutexFunction)(pthread_mutex_t*);
+	typedef int (*RwlockFunction)(pthread_rwlock_t*);
+
+	MallocFunction realMalloc = nullptr;
+	CallocFunction realCalloc = nullptr;
+	ReallocFunction realRealloc = nullptr;
+	FreeFunction realFree = nullptr;
+	PosixMemalignFunction realPosixMemalign = nullptr;
+	AlignedAllocFunction realAlignedAlloc = nullptr;
+	MutexFunction realMutexLock = nullptr;
+	MutexFunction realMutexTrylock = nullptr;
+	RwlockFunction realRwlockRdlock = nullptr;
+	RwlockFunction realRwlockWrlock = nullptr;
+
+	// `dlsym` may allocate while the real functions are being looked up, so those allocations are served
+	// from a static buffer, and are never freed
+	char bootstrapBuffer[16384];
+	size_t bootstrapOffset = 0;
+	bool isResolving = false;
+
+	// Depth of nested realtime sections of the current thread. Initial-exec, so accessing it never allocates.
+	__thread int sectionDepth __attribute__((tls_model("initial-exec"))) = 0;
+
+	// Set while a violation is being reported, so the report itself isn't checked
+	__thread bool isReporting __attribute__((tls_model("initial-exec"))) = false;
+
+	std::atomic<int64_t> allocationViolationCount { 0 };
+	std::atomic<int64_t> deallocationViolationCount { 0 };
+	std::atomic<int64_t> lockViolationCount { 0 };
+
+	bool abortOnViolation = false;
+
+	void ResolveRealFunctions() {
+		if (realMalloc != nullptr || isResolving) {
+			return;
+		}
+
+		isResolving = true;
+
+		realCalloc = (CallocFunction)dlsym(RTLD_NEXT, "calloc");
+		realMalloc = (MallocFunction)dlsym(RTLD_NEXT, "malloc");
+		realRealloc = (ReallocFunction)dlsym(RTLD_NEXT, "realloc");
+		realFree = (FreeFunction)dlsym(RTLD_NEXT, "free");
+		realPosixMemalign = (PosixMemalignFunction)dlsym(RTLD_NEXT, "posix_memalign");
+		realAlignedAlloc = (AlignedAllocFunction)dlsym(RTLD_NEXT, "aligned_alloc");
+		realMutexLock = (MutexFunction)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+		realMutexTrylock = (MutexFunction)dlsym(RTLD_NEXT, "pthread_mutex_trylock");
+		realRwlockRdlock = (RwlockFunction)dlsym(RTLD_NEXT, "pthread_rwlock_rdlock");
+		realRwlockWrlock = (RwlockFunction)dlsym(RTLD_NEXT, "pthread_rwlock_wrlock");
+
+		isResolving = false;
+	}
+
+	void* BootstrapAllocate(size_t size) {
+		auto alignedSize = (size + 15) & ~size_t(15);
+
+		if (bootstrapOffset + alignedSize > sizeof(bootstrapBuffer)) {
+			return nullptr;
+		}
+
+		auto result = bootstrapBuffer + bootstrapOffset;
+		bootstrapOffset += alignedSize;
+
+		return result;
+	}
+
+	bool IsBootstrapAllocation(void* pointer) {
+		return pointer >= (void*)bootstrapBuffer && pointer < (void*)(bootstrapBuffer + sizeof(bootstrapBuffer));
+	}
+
+	// Writes a message to stderr, without allocating
+	void WriteMessage(const char* message) {
+		auto result = write(STDERR_FILENO, message, strlen(message));
+		(void)result;
+	}
+
+	void ReportViolation(std::atomic<int64_t>& counter, const char* operationName) {
+		if (sectionDepth <= 0 || isReporting) {
+			return;
+		}
+
+		auto previousCount = counter.fetch_add(1, std::memory_order_relaxed);
+
+		if (abortOnViolation) {
+			isReporting = true;
+
+			WriteMessage("[realtime-guard] Aborting: ");
+			WriteMessage(operationName);
+			WriteMessage(" called within a realtime section\n");
+
+			abort();
+		}
+
+		if (previousCount == 0) {
+			isReporting = true;
+
+			WriteMessage("[realtime-guard] ");
+			WriteMessage(operationName);
+			WriteMessage(" called within a realtime section (further violations of this kind are only counted)\n");
+
+			isReporting = false;
+		}
+	}
+
+	__attribute__((constructor))
+	void InitializeGuard() {
+		ResolveRealFunctions();
+
+		auto mode = getenv("AUDIO_IO_REALTIME_GUARD");
+
+		abortOnViolation = mode != nullptr && strcmp(mode, "abort") == 0;
+	}
+}
+
+extern "C" {
+	// Hooks looked up by the audio output addon
+
+	__attribute__((visibility("default")))
+	void audio_io_realtime_guard_enter_section() {
+		sectionDepth++;
+	}
+
+	__attribute__((visibility("default")))
+	void audio_io_realtime_guard_leave_section() {
+		sectionDepth--;
+	}
+
+	__attribute__((visibility("default")))
+	void audio_io_realtime_guard_get_violation_counts(int64_t* allocationCount, int64_t* deallocationCount, int64_t* lockCount) {
+		*allocationCount = allocationViolationCount.load(std::memory_order_relaxed);
+		*deallocationCount = deallocationViolationCount.load(std::memory_order_relaxed);
+		*lockCount = lockViolationCount.load(std::memory_order_relaxed);
+	}
+
+	// Interposed memory allocation functions
+
+	__attribute__((visibility("default")))
+	void* malloc(size_t size) {
+		ResolveRealFunctions();
+
+		if (realMalloc == nullptr) {
+			return BootstrapAllocate(size);
+		}
+
+		ReportViolation(allocationViolationCount, "malloc");
+
+		return realMalloc(size);
+	}
+
+	__attribute__((visibility("default")))
+	void* calloc(size_t count, size_t size) {
+		ResolveRealFunctions();
+
+		if (realCalloc == nullptr) {
+			// Bootstrap buffer is zero-initialized, and never reused
+			return BootstrapAllocate(count * size);
+		}
+
+		ReportViolation(allocationViolationCount, "calloc");
+
+		return realCalloc(count, size);
+	}
+
+	__attribute__((visibility("default")))
+	void* realloc(void* pointer, size_t size) {
+		ResolveRealFunctions();
+
+		if (IsBootstrapAllocation(pointer)) {
+			auto result = malloc(size);
+			auto availableSize = size_t((bootstrapBuffer + sizeof(bootstrapBuffer)) - (char*)pointer);
+
+			if (result != nullptr) {
+				memcpy(result, pointer, size < availableSize ? size : availableSize);
+			}
+
+			return result;
+		}
+
+		ReportViolation(allocationViolationCount, "realloc");
+
+		return realRealloc(pointer, size);
+	}
+
+	__attribute__((visibility("default")))
+	void free(void* pointer) {
+		if (pointer == nullptr || IsBootstrapAllocation(pointer)) {
+			return;
+		}
+
+		ResolveRealFunctions();
+
+		ReportViolation(deallocationViolationCount, "free");
+
+		realFree(pointer);
+	}
+
+	__attribute__((visibility("default")))
+	int posix_memalign(void** result, size_t alignment, size_t size) {
+		ResolveRealFunctions();
+
+		ReportViolation(allocationViolationCount, "posix_memalign");
+
+		return realPosixMemalign(result, alignment, size);
+	}
+
+	__attribute__((visibility("default")))
+	void* aligned_alloc(size_t alignment, size_t size) {
+		ResolveRealFunctions();
+
+		ReportViolation(allocationViolationCount, "aligned_alloc");
+
+		return realAlignedAlloc(alignment, size);
+	}
+
+	// Interposed locking functions
+
+	__attribute__((visibility("default")))
+	int pthread_mutex_lock(pthread_mutex_t* mutex) {
+		ResolveRealFunctions();
+
+		ReportViolation(lockViolationCount, "pthread_mutex_lock");
+
+		return realMutexLock(mutex);
+	}
+
+	__attribute__((visibility("default")))
+	int pthread_mutex_trylock(pthread_mutex_t* mutex) {
+		ResolveRealFunctions();
+
+		ReportViolation(lockViolationCount, "pthread_mutex_trylock");
+
+		return realMutexTrylock(mutex);
+	}
+
+	__attribute__((visibility("default")))
+	int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+		ResolveRealFunctions();
+
+		ReportViolation(lockViolationCount, "pthread_rwlock_rdlock");
+
+		return realRwlockRdlock(lock);
+	}
+
+	__attribute__((visibility("default")))
+	int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+		ResolveRealFunctions();
+
+		ReportViolation(lockViolationCount, "pthread_rwlock_wrlock");
+
+		return realRwlockWrlock(lock);
+	}
+}
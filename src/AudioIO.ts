@@ -1,98 +1,1464 @@
+import { OpenPromise } from './OpenPromise.js'
+import { decodeWaveToFloat32Channels, float32ChannelsToBuffer } from '@echogarden/wave-codec'
+
 export * from './Playback.js'
+export * from './RenderPool.js'
+export * from './Calibration.js'
+
+let audioOutputAddon: AudioOutputAddon | undefined
+
+export async function createAudioOutput(config: AudioOutputConfig, handler: AudioOutputHandler) {
+	if (typeof config !== 'object') {
+		throw new Error(`No valid configuration object provided`)
+	}
+
+	if (typeof handler !== 'function') {
+		throw new Error(`No valid handler function provided`)
+	}
+
+	config = { ...config, }
+
+	const module = await getAudioOutputAddonForCurrentPlatform()
+
+	validateAudioOutputConfig(config, module)
+
+	const { sampleRate, channelCount } = config
+
+	if (typeof handler !== 'function') {
+		throw new Error(`Handler is not a function`)
+	}
+
+	let wrappedHandler: AudioOutputHandler
+
+	let sampleOffset = 0
+	let timePosition = 0
+
+	// When rendering offline, without a file, a copy of every buffer filled by the handler is kept
+	const renderedChunks: Int16Array[] | undefined = config.mode === 'offline' && config.backend !== 'file' ? [] : undefined
+
+	wrappedHandler = (audioBuffer: Int16Array) => {
+		timePosition = sampleOffset / sampleRate / channelCount
+
+		handler(audioBuffer)
+
+		if (renderedChunks) {
+			renderedChunks.push(audioBuffer.slice())
+		}
+
+		sampleOffset += audioBuffer.length
+	}
+
+	const nativeConfig: NativeAudioOutputConfig = { ...config, statusBuffer: createStatusBuffer() }
+
+	const nativeResult = await module.createAudioOutput(nativeConfig, wrappedHandler, (eventName, ...args) => {
+		wrappedResult.onNativeEvent(eventName, ...args)
+	})
+
+	const wrappedResult = new class extends AudioOutputBase implements AudioOutput {
+		// Gets all samples rendered so far, when rendering offline without a file. Since the handler is called
+		// as soon as the previous buffer was written, this includes every buffer it has filled.
+		getRenderedSamples() {
+			if (!renderedChunks) {
+				throw new Error(`Rendered samples are only available for offline outputs that don't render to a file`)
+			}
+
+			if (renderedChunks.length !== 1) {
+				const totalLength = renderedChunks.reduce((length, chunk) => length + chunk.length, 0)
+				const samples = new Int16Array(totalLength)
+
+				let offset = 0
+
+				for (const chunk of renderedChunks) {
+					samples.set(chunk, offset)
+					offset += chunk.length
+				}
+
+				renderedChunks.length = 0
+				renderedChunks.push(samples)
+			}
+
+			return renderedChunks[0]
+		}
+
+		// When the addon reports the actual playback position, the offset and time of the audio currently heard are given.
+		// Otherwise, the offset and time of the start of the buffer last passed to the handler are given.
+		get sampleOffset() {
+			if (this.hasPlaybackPosition) {
+				return this.getPlaybackPosition().contentFrame * channelCount
+			}
+
+			return sampleOffset
+		}
+
+		get timePosition() {
+			if (this.hasPlaybackPosition) {
+				return this.getPlaybackPosition().time
+			}
+
+			return timePosition
+		}
+	}(nativeResult, nativeConfig)
+
+	return wrappedResult as AudioOutput
+}
+
+export async function createAudioStream(config: AudioOutputConfig) {
+	if (typeof config !== 'object') {
+		throw new Error(`No valid configuration object provided`)
+	}
+
+	config = { ...config, }
+
+	const module = await getAudioOutputAddonForCurrentPlatform()
+
+	validateAudioOutputConfig(config, module)
+
+	if (config.mode === 'offline' && config.backend !== 'file') {
+		throw new Error(`Offline streams and clips can only be rendered to a file`)
+	}
+
+	const { sampleRate, channelCount } = config
+
+	let appendedSampleCount = 0
+	let isEnded = false
+
+	const nativeConfig: NativeAudioOutputConfig = { ...config, useStream: true, statusBuffer: createStatusBuffer() }
+
+	const nativeResult = await module.createAudioOutput(nativeConfig, () => {}, (eventName, ...args) => {
+		wrappedResult.onNativeEvent(eventName, ...args)
+	})
+
+	if (!nativeResult.append) {
+		nativeResult.dispose()
+
+		throw new Error(`Audio streams are not supported by the audio output addon for this platform`)
+	}
+
+	const wrappedResult = new class extends AudioOutputBase implements AudioStream {
+		append(samples: Int16Array) {
+			if (!(samples instanceof Int16Array)) {
+				throw new Error(`Samples must be given as an Int16Array`)
+			}
+
+			if (samples.length % channelCount !== 0) {
+				throw new Error(`Sample count ${samples.length} is not a multiple of the channel count (${channelCount})`)
+			}
+
+			if (isEnded) {
+				throw new Error(`Can't append samples to a stream that has been ended`)
+			}
+
+			if (this.isDisposed) {
+				throw new Error(`Can't append samples to a disposed stream`)
+			}
+
+			nativeResult.append!(samples)
+
+			appendedSampleCount += samples.length
+		}
+
+		end() {
+			if (!isEnded && !this.isDisposed) {
+				isEnded = true
+
+				nativeResult.end!()
+			}
+
+			return this.ended
+		}
+
+		get appendedSampleCount() { return appendedSampleCount }
+		get queuedSampleCount() { return this.isDisposed ? 0 : nativeResult.getQueuedSampleCount!() }
+		get sampleRate() { return sampleRate }
+		get channelCount() { return channelCount }
+	}(nativeResult, nativeConfig)
+
+	return wrappedResult as AudioStream
+}
+
+export async function createAudioClip(int16Samples: Int16Array, config: AudioOutputConfig) {
+	if (!(int16Samples instanceof Int16Array)) {
+		throw new Error(`Samples must be given as an Int16Array`)
+	}
+
+	if (typeof config !== 'object') {
+		throw new Error(`No valid configuration object provided`)
+	}
+
+	config = { ...config, }
+
+	const module = await getAudioOutputAddonForCurrentPlatform()
+
+	validateAudioOutputConfig(config, module)
+
+	if (config.mode === 'offline' && config.backend !== 'file') {
+		throw new Error(`Offline streams and clips can only be rendered to a file`)
+	}
+
+	const { sampleRate, channelCount } = config
+
+	if (int16Samples.length % channelCount !== 0) {
+		throw new Error(`Sample count ${int16Samples.length} is not a multiple of the channel count (${channelCount})`)
+	}
+
+	const frameCount = int16Samples.length / channelCount
+
+	const nativeConfig: NativeAudioOutputConfig = { ...config, clipSamples: int16Samples, statusBuffer: createStatusBuffer() }
+
+	const nativeResult = await module.createAudioOutput(nativeConfig, () => {}, (eventName, ...args) => {
+		wrappedResult.onNativeEvent(eventName, ...args)
+	})
+
+	if (!nativeResult.seek) {
+		nativeResult.dispose()
+
+		throw new Error(`Audio clips are not supported by the audio output addon for this platform`)
+	}
+
+	const wrappedResult = new class extends AudioOutputBase implements AudioClip {
+		seek(frameIndex: number) {
+			if (typeof frameIndex !== 'number' || Math.floor(frameIndex) !== frameIndex || frameIndex < 0) {
+				throw new Error(`Frame index ${frameIndex} is invalid. It must be a non-negative integer`)
+			}
+
+			if (this.isDisposed) {
+				return
+			}
+
+			nativeResult.seek!(Math.min(frameIndex, frameCount))
+		}
+
+		seekToTime(time: number) {
+			this.seek(Math.floor(time * sampleRate))
+		}
+
+		get frameCount() { return frameCount }
+		get duration() { return frameCount / sampleRate }
+		get sampleRate() { return sampleRate }
+		get channelCount() { return channelCount }
+	}(nativeResult, nativeConfig)
+
+	return wrappedResult as AudioClip
+}
+
+export async function createAudioMixer(config: AudioMixerConfig) {
+	if (typeof config !== 'object') {
+		throw new Error(`No valid configuration object provided`)
+	}
+
+	config = { ...config, }
+
+	const module = await getAudioOutputAddonForCurrentPlatform()
+
+	validateAudioOutputConfig(config, module)
+
+	if (config.mode === 'offline') {
+		throw new Error(`Mixers can't be rendered offline`)
+	}
+
+	const maxSourceCount = config.maxSourceCount ?? 256
+
+	if (typeof maxSourceCount !== 'number' || Math.floor(maxSourceCount) !== maxSourceCount || maxSourceCount < 1 || maxSourceCount > 65536) {
+		throw new Error(`Maximum source count ${maxSourceCount} is invalid. It must be an integer between 1 and 65536`)
+	}
+
+	const threadCount = config.threadCount ?? 1
+
+	if (typeof threadCount !== 'number' || Math.floor(threadCount) !== threadCount || threadCount < 1 || threadCount > 64) {
+		throw new Error(`Thread count ${threadCount} is invalid. It must be an integer between 1 and 64`)
+	}
+
+	const { sampleRate, channelCount } = config
+
+	if (channelCount > 8) {
+		throw new Error(`Mixers support up to 8 channels`)
+	}
+
+	let ducking = { ...defaultDuckingOptions, ...config.ducking }
+
+	validateDuckingOptions(ducking)
+
+	let isMixerDisposed = false
+
+	// Sources that haven't ended yet, by identifier
+	const liveSources = new Map<number, { endedOpenPromise: OpenPromise, onEnded?: () => void }>()
+
+	const nativeConfig: NativeAudioOutputConfig = { ...config, useMixer: true, maxMixerSourceCount: maxSourceCount, mixerThreadCount: threadCount, statusBuffer: createStatusBuffer() }
+
+	delete (nativeConfig as AudioMixerConfig).maxSourceCount
+	delete (nativeConfig as AudioMixerConfig).threadCount
+	delete (nativeConfig as AudioMixerConfig).ducking
+
+	const nativeResult = await module.createAudioOutput(nativeConfig, () => {}, (eventName, ...args) => {
+		if (eventName === 'sourceEnded') {
+			// The `sourceEnded` event is sent when a source has played all of its samples, or was removed,
+			// and its native resources were freed
+			endSource(args[0] as number)
+		} else {
+			wrappedResult.onNativeEvent(eventName, ...args)
+		}
+	})
+
+	if (!nativeResult.addSource) {
+		nativeResult.dispose()
+
+		throw new Error(`Audio mixers are not supported by the audio output addon for this platform`)
+	}
+
+	nativeResult.setDucking!(ducking.attack, ducking.release, ducking.depth)
+
+	function endSource(id: number) {
+		const liveSource = liveSources.get(id)
+
+		if (!liveSource) {
+			return
+		}
+
+		liveSources.delete(id)
+
+		liveSource.onEnded?.()
+		liveSource.endedOpenPromise.resolve()
+	}
+
+	function addSource(samples: Int16Array | null, options: MixerSourceOptions | undefined, onEnded?: () => void) {
+		const sourceOptions = { sampleRate, channelCount, gain: 1.0, pan: 0.0, priority: 0, ...options }
+
+		validateMixerSourceOptions(sourceOptions, channelCount)
+
+		if (samples && samples.length % sourceOptions.channelCount !== 0) {
+			throw new Error(`Sample count ${samples.length} is not a multiple of the channel count (${sourceOptions.channelCount})`)
+		}
+
+		if (isMixerDisposed) {
+			throw new Error(`Can't add a source to a disposed mixer`)
+		}
+
+		const id = nativeResult.addSource!(samples, sourceOptions.channelCount, sourceOptions.sampleRate, sourceOptions.gain, sourceOptions.pan, sourceOptions.priority)
+
+		if (id < 0) {
+			throw new Error(`The mixer already plays its maximum of ${maxSourceCount} sources`)
+		}
+
+		const endedOpenPromise = new OpenPromise()
+
+		liveSources.set(id, { endedOpenPromise, onEnded })
+
+		let gain = sourceOptions.gain
+		let pan = sourceOptions.pan
+		let priority = sourceOptions.priority
+
+		const source: MixerSource = {
+			get id() { return id },
+			get isEnded() { return !liveSources.has(id) || isMixerDisposed },
+			get ended() { return endedOpenPromise.promise },
+
+			get gain() { return gain },
+			set gain(value: number) {
+				validateMixerSourceOptions({ gain: value }, channelCount)
+
+				gain = value
+
+				if (liveSources.has(id) && !isMixerDisposed) {
+					nativeResult.setSourceGain!(id, value)
+				}
+			},
+
+			get pan() { return pan },
+			set pan(value: number) {
+				validateMixerSourceOptions({ pan: value }, channelCount)
+
+				pan = value
+
+				if (liveSources.has(id) && !isMixerDisposed) {
+					nativeResult.setSourcePan!(id, value)
+				}
+			},
+
+			get priority() { return priority },
+			set priority(value: number) {
+				validateMixerSourceOptions({ priority: value }, channelCount)
+
+				priority = value
+
+				if (liveSources.has(id) && !isMixerDisposed) {
+					nativeResult.setSourcePriority!(id, value)
+				}
+			},
+
+			remove() {
+				if (liveSources.has(id) && !isMixerDisposed) {
+					nativeResult.removeSource!(id)
+				}
+
+				return endedOpenPromise.promise
+			},
+		}
+
+		return { source, sourceOptions }
+	}
+
+	const wrappedResult = new class extends AudioOutputBase implements AudioMixer {
+		protected onDisposed() {
+			isMixerDisposed = true
+
+			super.onDisposed()
+		}
+
+		addBuffer(samples: Int16Array, options?: MixerSourceOptions) {
+			if (!(samples instanceof Int16Array)) {
+				throw new Error(`Samples must be given as an Int16Array`)
+			}
+
+			return addSource(samples, options).source
+		}
+
+		addWaveData(waveData: Uint8Array, options?: MixerSourceOptions) {
+			const { audioChannels, sampleRate: waveSampleRate } = decodeWaveToFloat32Channels(waveData)
+
+			const sampleBuffer = float32ChannelsToBuffer(audioChannels, 16)
+			const samples = new Int16Array(sampleBuffer.buffer, sampleBuffer.byteOffset, sampleBuffer.length / 2)
+
+			return this.addBuffer(samples, { sampleRate: waveSampleRate, channelCount: audioChannels.length, ...options })
+		}
+
+		addStream(options?: MixerSourceOptions) {
+			const { source, sourceOptions } = addSource(null, options)
+
+			let isEnded = false
+
+			// Descriptors are copied rather than values, so the getter stays live
+			const streamSource = Object.defineProperties(source, Object.getOwnPropertyDescriptors({
+				append(samples: Int16Array) {
+					if (!(samples instanceof Int16Array)) {
+						throw new Error(`Samples must be given as an Int16Array`)
+					}
+
+					if (samples.length % sourceOptions.channelCount !== 0) {
+						throw new Error(`Sample count ${samples.length} is not a multiple of the channel count (${sourceOptions.channelCount})`)
+					}
+
+					if (isEnded || source.isEnded) {
+						throw new Error(`Can't append samples to a source that has ended`)
+					}
+
+					nativeResult.appendToSource!(source.id, samples)
+				},
+
+				end() {
+					if (!isEnded && !source.isEnded) {
+						isEnded = true
+
+						nativeResult.endSource!(source.id)
+					}
+
+					return source.ended
+				},
+
+				get queuedSampleCount() { return source.isEnded ? 0 : nativeResult.getSourceQueuedSampleCount!(source.id) },
+			}))
+
+			return streamSource as MixerStreamSource
+		}
+
+		addHandler(handler: MixerSourceHandler, options?: MixerSourceOptions) {
+			if (typeof handler !== 'function') {
+				throw new Error(`Handler is not a function`)
+			}
+
+			// The handler is called from a timer, and fills chunks of a native stream, keeping at least two buffer
+			// durations queued ahead of the mixer
+			const streamSource = this.addStream(options)
+
+			const sourceSampleRate = options?.sampleRate ?? sampleRate
+			const sourceChannelCount = options?.channelCount ?? channelCount
+
+			const bufferDuration = config.bufferDuration ?? 100
+			const chunkFrameCount = Math.max(Math.round((bufferDuration / 1000) * sourceSampleRate), 1)
+			const targetQueuedSampleCount = chunkFrameCount * sourceChannelCount * 2
+
+			const fill = () => {
+				if (streamSource.isEnded || this.isDisposed) {
+					clearInterval(timer)
+
+					return
+				}
+
+				while (streamSource.queuedSampleCount < targetQueuedSampleCount) {
+					const chunk = new Int16Array(chunkFrameCount * sourceChannelCount)
+
+					if (handler(chunk) === false) {
+						clearInterval(timer)
+
+						streamSource.end()
+
+						return
+					}
+
+					streamSource.append(chunk)
+				}
+			}
+
+			const timer = setInterval(fill, Math.max(bufferDuration / 4, 1))
+
+			fill()
+
+			streamSource.ended.then(() => clearInterval(timer))
+
+			return streamSource as MixerSource
+		}
+
+		setDucking(options: DuckingOptions) {
+			const newDucking = { ...ducking, ...options }
+
+			validateDuckingOptions(newDucking)
+
+			ducking = newDucking
+
+			if (!this.isDisposed) {
+				nativeResult.setDucking!(ducking.attack, ducking.release, ducking.depth)
+			}
+		}
+
+		get ducking() { return { ...ducking } }
+		get sourceCount() { return this.isDisposed ? 0 : nativeResult.getSourceCount!() }
+		get maxSourceCount() { return maxSourceCount }
+		get sampleRate() { return sampleRate }
+		get channelCount() { return channelCount }
+	}(nativeResult, nativeConfig)
+
+	// Sources still playing when the mixer has ended were freed with it
+	wrappedResult.ended.then(() => {
+		for (const id of [...liveSources.keys()]) {
+			endSource(id)
+		}
+	})
+
+	return wrappedResult as AudioMixer
+}
+
+function validateMixerSourceOptions(options: MixerSourceOptions, outputChannelCount: number) {
+	const { sampleRate, channelCount, gain, pan, priority } = options
+
+	if (sampleRate !== undefined && (typeof sampleRate !== 'number' || Math.floor(sampleRate) !== sampleRate || sampleRate < 1000 || sampleRate > 768000)) {
+		throw new Error(`Source sample rate ${sampleRate} is invalid. It must be an integer between 1000 and 768000`)
+	}
+
+	if (channelCount !== undefined && channelCount !== 1 && channelCount !== outputChannelCount) {
+		throw new Error(`Source channel count ${channelCount} is invalid. It must be 1, or the mixer's channel count (${outputChannelCount})`)
+	}
+
+	if (gain !== undefined && (typeof gain !== 'number' || !isFinite(gain) || gain < 0)) {
+		throw new Error(`Gain ${gain} is invalid. It must be a non-negative number`)
+	}
+
+	if (pan !== undefined && (typeof pan !== 'number' || !(pan >= -1 && pan <= 1))) {
+		throw new Error(`Pan ${pan} is invalid. It must be between -1 and 1`)
+	}
+
+	if (priority !== undefined && (typeof priority !== 'number' || Math.floor(priority) !== priority || Math.abs(priority) > 1000000)) {
+		throw new Error(`Priority ${priority} is invalid. It must be an integer`)
+	}
+}
+
+function validateDuckingOptions(options: Required<DuckingOptions>) {
+	const { attack, release, depth } = options
+
+	if (typeof attack !== 'number' || !(attack >= 0 && attack <= 60000)) {
+		throw new Error(`Ducking attack time ${attack} is invalid. It must be between 0 and 60000 milliseconds`)
+	}
+
+	if (typeof release !== 'number' || !(release >= 0 && release <= 60000)) {
+		throw new Error(`Ducking release time ${release} is invalid. It must be between 0 and 60000 milliseconds`)
+	}
+
+	if (typeof depth !== 'number' || !(depth <= 0 && depth >= -120)) {
+		throw new Error(`Ducking depth ${depth} is invalid. It must be between -120 and 0 decibels`)
+	}
+}
+
+const defaultDuckingOptions: Required<DuckingOptions> = {
+	attack: 20,
+	release: 300,
+	depth: -12,
+}
+
+function validateAudioOutputConfig(config: AudioOutputConfig, module: AudioOutputAddon) {
+	const sampleRate = config.sampleRate
+
+	if (typeof sampleRate !== 'number' || Math.floor(sampleRate) !== sampleRate || sampleRate < 1) {
+		throw new Error(`Sample rate ${sampleRate} is invalid. It must be a positive integer greater than 0`)
+	}
+
+	const channelCount = config.channelCount
+
+	if (typeof channelCount !== 'number' || Math.floor(channelCount) !== channelCount || channelCount < 1) {
+		throw new Error(`Channel count of ${channelCount} is invalid. It must be a positive integer greater than 0`)
+	}
+
+	const mode = config.mode ?? 'realtime'
+
+	if (mode !== 'realtime' && mode !== 'offline') {
+		throw new Error(`Mode '${mode}' is invalid. It must be 'realtime' or 'offline'`)
+	}
+
+	// Offline outputs render through an unpaced simulated device: to a file when a path is given,
+	// or otherwise, to memory
+	if (mode === 'offline') {
+		if (config.backend != null && config.backend !== 'file' && config.backend !== 'null') {
+			throw new Error(`Offline outputs can only use the 'file' or 'null' backends`)
+		}
+
+		if (config.paced === true) {
+			throw new Error(`Offline outputs can't be paced`)
+		}
+
+		config.backend = config.backend ?? (config.filePath != null ? 'file' : 'null')
+		config.paced = false
+	}
+
+	// Offline, larger buffers mean fewer handler calls, and latency doesn't matter
+	const defaultBufferDuration = mode === 'offline' ? 500 : 100
+
+	if (config.bufferDuration == null) {
+		config.bufferDuration = defaultBufferDuration
+	}
+
+	let bufferDuration = config.bufferDuration
+
+	if (bufferDuration == null) {
+		config.bufferDuration = defaultBufferDuration
+	} else if (typeof bufferDuration !== 'number' || bufferDuration <= 0) {
+		throw new Error(`Buffer duration of ${bufferDuration} is invalid. It must be a floating point value greater than 0 (representing milliseconds)`)
+	}
+
+	if (config.autoStart != null && typeof config.autoStart !== 'boolean') {
+		throw new Error(`autoStart must be a boolean`)
+	}
+
+	const backend = config.backend ?? 'device'
+
+	if (!['device', 'null', 'file', 'virtual'].includes(backend)) {
+		throw new Error(`Backend '${backend}' is invalid. It must be 'device', 'null', 'file' or 'virtual'`)
+	}
+
+	if (backend !== 'device' && !module.backends?.includes(backend)) {
+		throw new Error(`Backend '${backend}' is not supported by the audio output addon for this platform`)
+	}
+
+	if (config.paced != null && typeof config.paced !== 'boolean') {
+		throw new Error(`paced must be a boolean`)
+	}
+
+	if (backend === 'file') {
+		if (typeof config.filePath !== 'string' || config.filePath.length === 0) {
+			throw new Error(`A file path must be given when using the 'file' backend`)
+		}
+
+		if (config.fileFormat != null && config.fileFormat !== 'wav' && config.fileFormat !== 'raw') {
+			throw new Error(`File format '${config.fileFormat}' is invalid. It must be 'wav' or 'raw'`)
+		}
+	}
+
+	if (config.deviceName != null && (typeof config.deviceName !== 'string' || config.deviceName.length === 0)) {
+		throw new Error(`Device name must be a non-empty string`)
+	}
+
+	if (config.latencyOffset != null && (typeof config.latencyOffset !== 'number' || !isFinite(config.latencyOffset))) {
+		throw new Error(`Latency offset of ${config.latencyOffset} is invalid. It must be a number of milliseconds`)
+	}
+
+	if (config.concealUnderruns != null && typeof config.concealUnderruns !== 'boolean') {
+		throw new Error(`concealUnderruns must be a boolean`)
+	}
+
+	if (backend === 'virtual' && config.virtualDevice != null) {
+		validateVirtualDeviceConfig(config.virtualDevice)
+	}
+}
+
+function validateVirtualDeviceConfig(config: VirtualDeviceConfig) {
+	for (const key of ['periodFrameCount', 'bufferFrameCount'] as const) {
+		const value = config[key]
+
+		if (value != null && (typeof value !== 'number' || !Number.isInteger(value) || value <= 0)) {
+			throw new Error(`Virtual device ${key} of ${value} is invalid. It must be a positive integer`)
+		}
+	}
+
+	if (config.clockRate != null && (typeof config.clockRate !== 'number' || config.clockRate <= 0)) {
+		throw new Error(`Virtual device clock rate of ${config.clockRate} is invalid. It must be a number greater than 0`)
+	}
+
+	for (const stall of config.stalls ?? []) {
+		if (typeof stall.time !== 'number' || stall.time < 0 || typeof stall.duration !== 'number' || stall.duration < 0) {
+			throw new Error(`Virtual device stalls must have a non-negative time and duration`)
+		}
+	}
+
+	for (const xrunTime of config.xruns ?? []) {
+		if (typeof xrunTime !== 'number' || xrunTime < 0) {
+			throw new Error(`Virtual device xrun times must be non-negative numbers`)
+		}
+	}
+
+	if (config.recordBuffer != null && !(config.recordBuffer instanceof Int16Array)) {
+		throw new Error(`Virtual device record buffer must be an Int16Array`)
+	}
+}
+
+// Reads the status published by the audio output addon to a shared buffer, without calling into the addon.
+//
+// The buffer is a `SharedArrayBuffer`, so the reader can also be created in a worker thread,
+// by passing it the `statusBuffer` of an output.
+export class AudioOutputStatusReader {
+	private readonly int32View: Int32Array
+	private readonly float64View: Float64Array
+
+	constructor(statusBuffer: SharedArrayBuffer) {
+		if (!(statusBuffer instanceof SharedArrayBuffer) || statusBuffer.byteLength < statusBufferByteLength) {
+			throw new Error(`Status buffer must be a SharedArrayBuffer of at least ${statusBufferByteLength} bytes`)
+		}
+
+		this.int32View = new Int32Array(statusBuffer, 0, 2)
+		this.float64View = new Float64Array(statusBuffer, 0, statusBufferSlotCount)
+	}
+
+	// Reads the current status. To avoid allocating, an existing status object can be passed, and is updated in place.
+	read(target?: AudioOutputStatus): AudioOutputStatus {
+		const status = target ?? createEmptyStatus()
+
+		const int32View = this.int32View
+		const float64View = this.float64View
+
+		// The native output thread increments the sequence number before and after updating the slots.
+		// Retry if it was updating them while they were read.
+		while (true) {
+			const sequenceBefore = Atomics.load(int32View, 0)
+
+			if ((sequenceBefore & 1) !== 0) {
+				continue
+			}
+
+			const state = Atomics.load(int32View, 1)
+
+			status.framesWritten = float64View[StatusSlot.FramesWritten]
+			status.playedFrame = float64View[StatusSlot.PlayedFrame]
+			status.delay = float64View[StatusSlot.DelayFrameCount]
+			status.playedContentFrame = float64View[StatusSlot.PlayedContentFrame]
+			status.monotonicTime = float64View[StatusSlot.Timestamp]
+			status.underrunCount = float64View[StatusSlot.UnderrunCount]
+			status.deviceSampleRate = float64View[StatusSlot.DeviceSampleRate]
+
+			if (Atomics.load(int32View, 0) === sequenceBefore) {
+				status.state = outputStates[state] ?? 'notStarted'
+
+				return status
+			}
+		}
+	}
+}
+
+function convertNativeStats(nativeStats: NativeAudioOutputStats): AudioOutputStats {
+	return {
+		underrunCount: nativeStats.underrunCount,
+		recoveryCount: nativeStats.recoveryCount,
+		recoveryFailureCount: nativeStats.recoveryFailureCount,
+		deadlineMissCount: nativeStats.deadlineMissCount,
+		concealedPeriodCount: nativeStats.concealedPeriodCount,
+
+		handlerLatency: summarizeHistogram(nativeStats.handlerLatency),
+		handlerDuration: summarizeHistogram(nativeStats.handlerDuration),
+		handlerRoundTrip: summarizeHistogram(nativeStats.handlerRoundTrip),
+		writeDuration: summarizeHistogram(nativeStats.writeDuration),
+		wakeupJitter: summarizeHistogram(nativeStats.wakeupJitter),
+		slack: summarizeHistogram(nativeStats.slack),
+		bufferFill: summarizeHistogram(nativeStats.bufferFill),
+		mixDuration: summarizeHistogram(nativeStats.mixDuration),
+	}
+}
+
+// Summarizes a native histogram. Bucket 0 counts values of 0, and bucket i counts values in the range [2^(i-1), 2^i),
+// so percentiles are estimated as the upper bound of the bucket they fall in, but never more than the maximum.
+function summarizeHistogram(histogram: NativeHistogram): HistogramSummary {
+	const { count, sum, max, buckets } = histogram
+
+	function getPercentile(percentile: number) {
+		if (count === 0) {
+			return 0
+		}
+
+		const targetRank = Math.ceil((percentile / 100) * count)
+
+		let cumulativeCount = 0
+
+		for (let i = 0; i < buckets.length; i++) {
+			cumulativeCount += buckets[i]
+
+			if (cumulativeCount >= targetRank) {
+				return i === 0 ? 0 : Math.min((2 ** i) - 1, max)
+			}
+		}
+
+		return max
+	}
+
+	return {
+		count,
+		mean: count > 0 ? sum / count : 0,
+		max,
+		p50: getPercentile(50),
+		p90: getPercentile(90),
+		p99: getPercentile(99),
+		buckets,
+	}
+}
+
+function createStatusBuffer() {
+	return new Float64Array(new SharedArrayBuffer(statusBufferByteLength))
+}
+
+function createEmptyStatus(): AudioOutputStatus {
+	return {
+		state: 'notStarted',
+		framesWritten: 0,
+		playedFrame: 0,
+		delay: 0,
+		playedContentFrame: 0,
+		monotonicTime: 0,
+		underrunCount: 0,
+		deviceSampleRate: 0,
+	}
+}
+
+// Slots of the status buffer. Must be kept in sync with the layout in `addons/include/SharedStatus.h`.
+const StatusSlot = {
+	SequenceAndState: 0,
+	FramesWritten: 1,
+	PlayedFrame: 2,
+	DelayFrameCount: 3,
+	PlayedContentFrame: 4,
+	Timestamp: 5,
+	UnderrunCount: 6,
+	DeviceSampleRate: 7,
+}
+
+const statusBufferSlotCount = 8
+const statusBufferByteLength = statusBufferSlotCount * 8
+
+const outputStates: AudioOutputState[] = ['notStarted', 'playing', 'paused', 'stopped', 'ended']
+
+class AudioOutputBase {
+	protected readonly nativeOutput: NativeAudioOutput
+	protected isDisposed = false
+	private isStarted: boolean
+	private isPausedFlag = false
+
+	private readonly sampleRateValue: number
+	private deviceSampleRate: number
+	private lastPlaybackPosition: PlaybackPosition
+
+	private readonly endedOpenPromise = new OpenPromise()
+	private readonly disposedOpenPromise = new OpenPromise()
+
+	private readonly statusBufferValue?: SharedArrayBuffer
+	private readonly statusReader?: AudioOutputStatusReader
+
+	private lastStats?: AudioOutputStats
+	private lastResourceUsage?: ResourceUsage
+	private lastVirtualDeviceStats?: VirtualDeviceStats
+	private isNativeOutputFreed = false
+
+	// Pending markers, sorted by frame
+	private markers: Marker[] = []
+	private nextMarkerId = 0
+
+	constructor(nativeOutput: NativeAudioOutput, config: NativeAudioOutputConfig) {
+		if (config.autoStart === false && !nativeOutput.start) {
+			nativeOutput.dispose()
+
+			throw new Error(`Disabling 'autoStart' is not supported by the audio output addon for this platform`)
+		}
+
+		this.nativeOutput = nativeOutput
+		this.isStarted = config.autoStart !== false
+
+		this.sampleRateValue = config.sampleRate
+		this.deviceSampleRate = config.sampleRate
+
+		this.lastPlaybackPosition = {
+			frame: 0,
+			contentFrame: 0,
+			time: 0,
+			delay: 0,
+			framesWritten: 0,
+			isRunning: false,
+			monotonicTime: process.hrtime.bigint(),
+		}
+
+		// The addon resolves its `disposed` promise once the output thread has been joined, and all of its resources freed
+		if (nativeOutput.disposed) {
+			nativeOutput.disposed.then((finalResult) => {
+				this.isDisposed = true
+				this.isNativeOutputFreed = true
+
+				if (finalResult) {
+					this.lastStats = convertNativeStats(finalResult.stats)
+					this.lastResourceUsage = finalResult.resourceUsage
+					this.lastVirtualDeviceStats = finalResult.virtualDevice
+				}
+
+				this.endedOpenPromise.resolve()
+				this.disposedOpenPromise.resolve()
+			})
+		}
+
+		// The addon publishes an initial status before returning, so if the device sample rate is still 0,
+		// the addon doesn't support publishing to the status buffer
+		if (config.statusBuffer) {
+			const statusReader = new AudioOutputStatusReader(config.statusBuffer.buffer as SharedArrayBuffer)
+
+			if (statusReader.read().deviceSampleRate > 0) {
+				this.statusBufferValue = config.statusBuffer.buffer as SharedArrayBuffer
+				this.statusReader = statusReader
+			}
+		}
+	}
+
+	get hasPlaybackPosition() { return this.nativeOutput.getPlaybackPosition != null }
+
+	// Shared buffer the addon publishes the output status to, after every write to the device.
+	// Can be passed to an `AudioOutputStatusReader`, in any thread.
+	get statusBuffer() { return this.statusBufferValue }
+
+	getStatus(target?: AudioOutputStatus) {
+		if (!this.statusReader) {
+			throw new Error(`Method 'getStatus' is not supported by the audio output addon for this platform`)
+		}
+
+		return this.statusReader.read(target)
+	}
+
+	// Resolves when the final frame has played, or was dropped, and the output has stopped
+	get ended() { return this.endedOpenPromise.promise }
+
+	// Resolves when the output has been fully disposed, and all of its native resources freed
+	get disposed() { return this.disposedOpenPromise.promise }
+
+	// Gets statistics collected by the output thread. Durations are given in microseconds.
+	getStats(): AudioOutputStats {
+		if (!this.nativeOutput.getStats) {
+			throw new Error(`Method 'getStats' is not supported by the audio output addon for this platform`)
+		}
+
+		// Once the native output has been freed, return the final statistics it resolved `disposed` with
+		if (this.isNativeOutputFreed) {
+			return this.lastStats!
+		}
+
+		this.lastStats = convertNativeStats(this.nativeOutput.getStats())
+
+		return this.lastStats
+	}
+
+	// Gets the CPU time and context switches of the output thread, and the native memory held by the output.
+	// The handler is called on the JavaScript thread, so the time spent in it isn't included.
+	getResourceUsage(): ResourceUsage {
+		if (!this.nativeOutput.getResourceUsage) {
+			throw new Error(`Method 'getResourceUsage' is not supported by the audio output addon for this platform`)
+		}
+
+		if (this.isNativeOutputFreed) {
+			return this.lastResourceUsage!
+		}
+
+		this.lastResourceUsage = this.nativeOutput.getResourceUsage()
+
+		return this.lastResourceUsage
+	}
+
+	// Gets statistics of the virtual device, when the output plays through the 'virtual' backend
+	getVirtualDeviceStats(): VirtualDeviceStats {
+		if (this.isNativeOutputFreed && this.lastVirtualDeviceStats) {
+			return this.lastVirtualDeviceStats
+		}
+
+		if (!this.nativeOutput.getVirtualDeviceStats) {
+			throw new Error(`Method 'getVirtualDeviceStats' is only supported by outputs using the 'virtual' backend`)
+		}
+
+		this.lastVirtualDeviceStats = this.nativeOutput.getVirtualDeviceStats()
+
+		return this.lastVirtualDeviceStats
+	}
+
+	dispose() {
+		return new Promise<void>((resolve, reject) => {
+			if (this.isDisposed) {
+				this.disposed.then(resolve)
+
+				return
+			}
+
+			process.nextTick(() => {
+				try {
+					this.nativeOutput.dispose()
+					this.disposed.then(resolve)
+				} catch (e) {
+					reject(e)
+				}
+
+				this.onDisposed()
+			})
+		})
+	}
+
+	stop(options?: StopOptions) {
+		options = { ...defaultStopOptions, ...options }
+
+		const mode = options.mode!
+
+		if (mode !== 'drain' && mode !== 'drop' && mode !== 'fade') {
+			throw new Error(`Stop mode '${mode}' is invalid. It must be either 'drain', 'drop' or 'fade'`)
+		}
+
+		if (!this.nativeOutput.stop && mode !== 'drain') {
+			throw new Error(`Stop mode '${mode}' is not supported by the audio output addon for this platform`)
+		}
+
+		return new Promise<void>((resolve, reject) => {
+			if (this.isDisposed) {
+				this.disposed.then(resolve)
+
+				return
+			}
+
+			// Stopping in 'drop' or 'fade' modes should take effect as early as possible,
+			// so unlike `dispose`, the native method is called synchronously
+			try {
+				if (this.nativeOutput.stop) {
+					this.nativeOutput.stop(mode)
+				} else {
+					this.nativeOutput.dispose()
+				}
+
+				this.disposed.then(resolve)
+			} catch (e) {
+				reject(e)
+			}
+
+			this.onDisposed()
+		})
+	}
+
+	start(options?: StartOptions) {
+		if (!this.nativeOutput.start) {
+			throw new Error(`Method 'start' is not supported by the audio output addon for this platform`)
+		}
+
+		options = { ...options }
+
+		const atFrame = options.atFrame
+		const atMonotonicTime = options.atMonotonicTime
+
+		if (atFrame != null && atMonotonicTime != null) {
+			throw new Error(`Only one of 'atFrame' or 'atMonotonicTime' can be specified`)
+		}
+
+		if (atFrame != null && (typeof atFrame !== 'number' || Math.floor(atFrame) !== atFrame || atFrame < 0)) {
+			throw new Error(`Start frame ${atFrame} is invalid. It must be a non-negative integer`)
+		}
+
+		if (atMonotonicTime != null && typeof atMonotonicTime !== 'bigint') {
+			throw new Error(`Start time ${atMonotonicTime} is invalid. It must be a bigint, in nanoseconds, like returned by process.hrtime.bigint()`)
+		}
+
+		if (this.isStarted) {
+			throw new Error(`Output has already been started`)
+		}
+
+		if (this.isDisposed) {
+			return
+		}
+
+		this.nativeOutput.start(atFrame ?? -1, atMonotonicTime ?? -1n)
+
+		this.isStarted = true
+	}
+
+	getPlaybackPosition(): PlaybackPosition {
+		if (!this.nativeOutput.getPlaybackPosition) {
+			throw new Error(`Method 'getPlaybackPosition' is not supported by the audio output addon for this platform`)
+		}
+
+		if (this.isDisposed) {
+			return this.lastPlaybackPosition
+		}
+
+		const nativePosition = this.nativeOutput.getPlaybackPosition()
+
+		this.deviceSampleRate = nativePosition.deviceSampleRate
+
+		this.lastPlaybackPosition = {
+			frame: nativePosition.frame,
+			contentFrame: nativePosition.contentFrame,
+			time: nativePosition.contentFrame / this.sampleRateValue,
+			delay: nativePosition.delay,
+			framesWritten: nativePosition.framesWritten,
+			isRunning: nativePosition.isRunning,
+			monotonicTime: nativePosition.monotonicTime,
+		}
+
+		return this.lastPlaybackPosition
+	}
+
+	// Estimates the monotonic time, in nanoseconds, at which the given frame, in the output's timeline, has played,
+	// or would play, assuming playback continues uninterrupted
+	getMonotonicTimeOfFrame(frame: number) {
+		const position = this.getPlaybackPosition()
+
+		const frameOffset = frame - position.frame
+
+		return position.monotonicTime + BigInt(Math.round((frameOffset / this.deviceSampleRate) * 1e9))
+	}
+
+	flush() {
+		this.callNativeControlMethod('flush')
+	}
+
+	pause() {
+		this.callNativeControlMethod('pause')
+
+		this.isPausedFlag = true
+	}
+
+	resume() {
+		this.callNativeControlMethod('resume')
+
+		this.isPausedFlag = false
+	}
+
+	get isPaused() { return this.isPausedFlag }
+
+	// Adds a marker at the given content frame. The callback is called once the frame has actually been played
+	// by the device. Returns an identifier that can be passed to `removeMarker`.
+	addMarker(frame: number, callback: MarkerCallback) {
+		if (!this.nativeOutput.setNextMarkerFrame) {
+			throw new Error(`Method 'addMarker' is not supported by the audio output addon for this platform`)
+		}
+
+		if (typeof frame !== 'number' || Math.floor(frame) !== frame || frame < 0) {
+			throw new Error(`Marker frame ${frame} is invalid. It must be a non-negative integer`)
+		}
+
+		if (typeof callback !== 'function') {
+			throw new Error(`Marker callback is not a function`)
+		}
+
+		const id = this.nextMarkerId++
+
+		// Insert after any markers with the same or an earlier frame
+		let low = 0
+		let high = this.markers.length
+
+		while (low < high) {
+			const middle = (low + high) >>> 1
+
+			if (this.markers[middle].frame <= frame) {
+				low = middle + 1
+			} else {
+				high = middle
+			}
+		}
+
+		this.markers.splice(low, 0, { id, frame, callback })
+
+		this.updateNextMarkerFrame()
+
+		return id
+	}
+
+	addMarkerAtTime(time: number, callback: MarkerCallback) {
+		return this.addMarker(Math.floor(time * this.sampleRateValue), callback)
+	}
+
+	removeMarker(id: number) {
+		const index = this.markers.findIndex(marker => marker.id === id)
+
+		if (index >= 0) {
+			this.markers.splice(index, 1)
+
+			this.updateNextMarkerFrame()
+		}
+	}
+
+	onNativeEvent(eventName: string, ...args: any[]) {
+		if (eventName === 'ended') {
+			// The `ended` event is sent when the output has stopped, after the final frame has played, or was dropped.
+			// Its argument is true if a native source has ended, and all of its samples have played.
+			// The native output is disposed right after.
+			this.onDisposed()
+
+			this.endedOpenPromise.resolve()
+		} else if (eventName === 'error') {
+			// The `error` event is sent when writing to the device failed, and the output is stopping.
+			// It's thrown as an uncaught exception, like an exception thrown by the handler.
+			throw new Error(args[0] as string)
+		} else if (eventName === 'markers') {
+			// The `markers` event is sent, at most once per wait of the output thread, when the content frame
+			// playing reaches the next marker frame. It gives the content frame playing, and the time it was measured at.
+			this.fireMarkers(args[0] as number, args[1] as bigint)
+		}
+	}
+
+	private fireMarkers(playedContentFrame: number, measurementTime: bigint) {
+		const dispatchTime = process.hrtime.bigint()
+
+		let firedCount = 0
+
+		while (firedCount < this.markers.length && this.markers[firedCount].frame <= playedContentFrame) {
+			firedCount++
+		}
+
+		const firedMarkers = this.markers.splice(0, firedCount)
+
+		this.updateNextMarkerFrame()
+
+		for (const marker of firedMarkers) {
+			// Estimate the time the marker frame started playing, from the time the played frame was measured
+			const frameOffset = playedContentFrame - marker.frame
+			const playTime = measurementTime - BigInt(Math.round((frameOffset / this.deviceSampleRate) * 1e9))
+
+			marker.callback({
+				id: marker.id,
+				frame: marker.frame,
+				monotonicTime: playTime,
+				latency: Number(dispatchTime - playTime) / 1e6,
+			})
+		}
+	}
+
+	private updateNextMarkerFrame() {
+		if (this.isDisposed || !this.nativeOutput.setNextMarkerFrame) {
+			return
+		}
+
+		this.nativeOutput.setNextMarkerFrame(this.markers.length > 0 ? this.markers[0].frame : -1)
+	}
+
+	protected onDisposed() {
+		this.isDisposed = true
+
+		// If the addon doesn't report when the output has actually ended, or has been disposed,
+		// resolve right away
+		if (!this.nativeOutput.disposed) {
+			this.endedOpenPromise.resolve()
+			this.disposedOpenPromise.resolve()
+		}
+	}
+
+	private callNativeControlMethod(methodName: 'flush' | 'pause' | 'resume') {
+		const nativeMethod = this.nativeOutput[methodName]
+
+		if (!nativeMethod) {
+			throw new Error(`Method '${methodName}' is not supported by the audio output addon for this platform`)
+		}
+
+		if (this.isDisposed) {
+			return
+		}
+
+		nativeMethod()
+	}
+}
+
+// Gets the total resource usage of all live outputs in the process, for capacity planning
+export async function getProcessResourceUsage() {
+	const module = await getAudioOutputAddonForCurrentPlatform()
 
-let audioOutputAddon: AudioOutputAddon | undefined
+	if (!module.getProcessResourceUsage) {
+		throw new Error(`Resource usage is not supported by the audio output addon for this platform`)
+	}
 
-export async function createAudioOutput(config: AudioOutputConfig, handler: AudioOutputHandler) {
-	if (typeof config !== 'object') {
-		throw new Error(`No valid configuration object provided`)
+	return module.getProcessResourceUsage()
+}
+
+// Gets the number of native objects currently allocated by outputs. Once all outputs are disposed, and
+// their `disposed` promises have resolved, all counts should return to 0.
+export async function getNativeObjectCounts(): Promise<NativeObjectCounts> {
+	const module = await getAudioOutputAddonForCurrentPlatform()
+
+	if (!module.getNativeObjectCounts) {
+		throw new Error(`Native object counts are not supported by the audio output addon for this platform`)
 	}
 
-	if (typeof handler !== 'function') {
-		throw new Error(`No valid handler function provided`)
+	return module.getNativeObjectCounts()
+}
+
+// Gets the number of allocations, deallocations and lock operations made by output threads, while in their realtime
+// sections, since the process started. Returns undefined unless the realtime guard library is preloaded
+// (see `docs/Building.md`).
+export async function getRealtimeGuardViolations(): Promise<RealtimeGuardViolations | undefined> {
+	const module = await getAudioOutputAddonForCurrentPlatform()
+
+	if (!module.getRealtimeGuardViolations) {
+		throw new Error(`The realtime guard is not supported by the audio output addon for this platform`)
 	}
 
-	config = { ...config, }
+	return module.getRealtimeGuardViolations() ?? undefined
+}
 
+// Generates a mono test signal: a maximum length sequence ('mls'), or an impulse train ('impulses')
+export async function generateTestSignal(type: TestSignalType, options: TestSignalOptions): Promise<Int16Array> {
 	const module = await getAudioOutputAddonForCurrentPlatform()
 
-	const sampleRate = config.sampleRate
+	if (!module.generateTestSignal) {
+		throw new Error(`Test signals are not supported by the audio output addon for this platform`)
+	}
 
-	if (typeof sampleRate !== 'number' || Math.floor(sampleRate) !== sampleRate || sampleRate < 1) {
-		throw new Error(`Sample rate ${sampleRate} is invalid. It must be a positive integer greater than 0`)
+	const amplitude = options.amplitude ?? 16384
+
+	if (type === 'mls') {
+		const order = options.order ?? 14
+
+		if (Math.floor(order) !== order || order < 2 || order > 20) {
+			throw new Error(`MLS order of ${order} is invalid. It must be an integer between 2 and 20`)
+		}
+
+		return module.generateTestSignal('mls', { order, amplitude })
+	} else if (type === 'impulses') {
+		const length = options.length ?? 1
+		const interval = options.interval ?? length
+
+		if (Math.floor(length) !== length || length < 1 || Math.floor(interval) !== interval || interval < 1) {
+			throw new Error(`Impulse train length and interval must be positive integers`)
+		}
+
+		return module.generateTestSignal('impulses', { length, interval, amplitude })
+	} else {
+		throw new Error(`Test signal type '${type}' is invalid. It must be 'mls' or 'impulses'`)
 	}
+}
 
-	const channelCount = config.channelCount
+// Cross-correlates a mono signal with a shorter reference, for every offset at which the reference fits
+// within the signal. Computed natively, using an FFT.
+export async function crossCorrelate(signal: Int16Array, reference: Int16Array): Promise<Float64Array> {
+	const module = await getAudioOutputAddonForCurrentPlatform()
 
-	if (typeof channelCount !== 'number' || Math.floor(channelCount) !== channelCount || channelCount < 1) {
-		throw new Error(`Channel count of ${channelCount} is invalid. It must be a positive integer greater than 0`)
+	if (!module.crossCorrelate) {
+		throw new Error(`Cross-correlation is not supported by the audio output addon for this platform`)
+	}
+
+	if (reference.length === 0 || reference.length > signal.length) {
+		throw new Error(`Reference must be non-empty, and no longer than the signal`)
 	}
 
-	const defaultBufferDuration = 100
+	return module.crossCorrelate(signal, reference)
+}
 
-	if (config.bufferDuration == null) {
-		config.bufferDuration = defaultBufferDuration
+// Records interleaved frames from a capture device, on a worker thread
+export async function captureAudio(options: CaptureOptions): Promise<CaptureResult> {
+	const module = await getAudioOutputAddonForCurrentPlatform()
+
+	if (!module.captureAudio) {
+		throw new Error(`Capturing audio is not supported by the audio output addon for this platform`)
 	}
 
-	let bufferDuration = config.bufferDuration
+	const { deviceName, sampleRate, channelCount, frameCount } = options
 
-	if (bufferDuration == null) {
-		config.bufferDuration = defaultBufferDuration
-	} else if (typeof bufferDuration !== 'number' || bufferDuration <= 0) {
-		throw new Error(`Buffer duration of ${bufferDuration} is invalid. It must be a floating point value greater than 0 (representing milliseconds)`)
+	if (typeof deviceName !== 'string' || deviceName.length === 0) {
+		throw new Error(`A capture device name must be given`)
 	}
 
-	if (typeof handler !== 'function') {
-		throw new Error(`Handler is not a function`)
+	for (const [name, value] of [['Sample rate', sampleRate], ['Channel count', channelCount], ['Frame count', frameCount]] as const) {
+		if (typeof value !== 'number' || Math.floor(value) !== value || value < 1) {
+			throw new Error(`${name} of ${value} is invalid. It must be a positive integer`)
+		}
 	}
 
-	let wrappedHandler: AudioOutputHandler
+	return module.captureAudio({ deviceName, sampleRate, channelCount, frameCount })
+}
 
-	let sampleOffset = 0
-	let timePosition = 0
+// Enables or disables recording of trace events by all output threads, at any time.
+// Recorded events are kept in a fixed-size ring per output thread, so they should be drained regularly
+// with `drainTraceEvents`, otherwise new events are dropped.
+export async function setTracingEnabled(enabled: boolean) {
+	const module = await getAudioOutputAddonForCurrentPlatform()
 
-	wrappedHandler = (audioBuffer: Int16Array) => {
-		timePosition = sampleOffset / sampleRate / channelCount
+	if (!module.setTracingEnabled) {
+		throw new Error(`Tracing is not supported by the audio output addon for this platform`)
+	}
 
-		handler(audioBuffer)
+	module.setTracingEnabled(enabled)
+}
 
-		sampleOffset += audioBuffer.length
+// Drains the trace events recorded by all output threads since the last call, sorted by start time
+export async function drainTraceEvents(): Promise<AudioTraceEvent[]> {
+	const module = await getAudioOutputAddonForCurrentPlatform()
+
+	if (!module.drainTraceEvents) {
+		throw new Error(`Tracing is not supported by the audio output addon for this platform`)
 	}
 
-	const nativeResult = await module.createAudioOutput(config, wrappedHandler)
+	const packedEvents = module.drainTraceEvents()
+
+	const events: AudioTraceEvent[] = []
 
-	const nativeDisposeMethod = nativeResult.dispose
+	for (let offset = 0; offset < packedEvents.length; offset += traceEventFieldCount) {
+		const duration = packedEvents[offset + 3]
 
-	let isDisposed = false
+		events.push({
+			name: traceEventNames[packedEvents[offset]] ?? 'unknown',
+			threadId: packedEvents[offset + 1],
+			startTime: packedEvents[offset + 2],
+			duration: duration >= 0 ? duration : undefined,
+			argument: packedEvents[offset + 4],
+		})
+	}
 
-	const wrappedResult: AudioOutput = new class {
-		dispose() {
-			return new Promise<void>((resolve, reject) => {
-				if (isDisposed) {
-					resolve()
+	return events
+}
 
-					return
-				}
+// Gets the number of trace events dropped so far, because a ring was full when they were recorded
+export async function getDroppedTraceEventCount() {
+	const module = await getAudioOutputAddonForCurrentPlatform()
 
-				process.nextTick(() => {
-					try {
-						nativeDisposeMethod()
-						resolve()
-					} catch (e) {
-						reject(e)
-					}
+	if (!module.getDroppedTraceEventCount) {
+		throw new Error(`Tracing is not supported by the audio output addon for this platform`)
+	}
 
-					isDisposed = true
-				})
-			})
+	return module.getDroppedTraceEventCount()
+}
+
+// Converts trace events to the Chrome trace event JSON format, which can be loaded in Perfetto (ui.perfetto.dev)
+// or in chrome://tracing
+export function traceEventsToChromeTraceJson(events: AudioTraceEvent[]) {
+	const chromeTraceEvents = events.map(event => {
+		const chromeTraceEvent: any = {
+			name: event.name,
+			cat: 'audio-io',
+			ph: event.duration != null ? 'X' : 'i',
+			ts: event.startTime / 1000,
+			pid: process.pid,
+			tid: event.threadId,
+			args: { argument: event.argument },
 		}
 
-		get sampleOffset() { return sampleOffset }
-		get timePosition() { return timePosition }
-	}
+		if (event.duration != null) {
+			chromeTraceEvent.dur = event.duration / 1000
+		} else {
+			chromeTraceEvent.s = 't'
+		}
 
-	return wrappedResult
+		return chromeTraceEvent
+	})
+
+	return JSON.stringify({ traceEvents: chromeTraceEvents, displayTimeUnit: 'ms' })
 }
 
+// Must be kept in sync with `traceEventNames` and `traceEventFieldCount` in `addons/include/TraceRing.h`
+const traceEventNames = ['wait', 'handlerDispatch', 'handler', 'write', 'underrun', 'recover', 'flush', 'pause', 'resume', 'seek', 'drain', 'handlerRoundTrip', 'conceal']
+const traceEventFieldCount = 5
+
 async function getAudioOutputAddonForCurrentPlatform() {
 	if (audioOutputAddon) {
 		return audioOutputAddon
@@ -144,23 +1510,622 @@ export function isPlatformSupported() {
 
 export interface AudioOutput {
 	dispose(): Promise<void>
+	start(options?: StartOptions): void
+	stop(options?: StopOptions): Promise<void>
+	flush(): void
+	pause(): void
+	resume(): void
+
+	getPlaybackPosition(): PlaybackPosition
+	getMonotonicTimeOfFrame(frame: number): bigint
+	getStatus(target?: AudioOutputStatus): AudioOutputStatus
+	getStats(): AudioOutputStats
+	getResourceUsage(): ResourceUsage
+	getVirtualDeviceStats(): VirtualDeviceStats
+	getRenderedSamples(): Int16Array
+
+	addMarker(frame: number, callback: MarkerCallback): number
+	addMarkerAtTime(time: number, callback: MarkerCallback): number
+	removeMarker(id: number): void
 
+	isPaused: boolean
+	statusBuffer: SharedArrayBuffer | undefined
+	ended: Promise<void>
+	disposed: Promise<void>
 	sampleOffset: number
 	timePosition: number
 }
 
+export interface AudioStream {
+	append(samples: Int16Array): void
+	end(): Promise<void>
+	dispose(): Promise<void>
+	start(options?: StartOptions): void
+	stop(options?: StopOptions): Promise<void>
+	flush(): void
+	pause(): void
+	resume(): void
+
+	getPlaybackPosition(): PlaybackPosition
+	getMonotonicTimeOfFrame(frame: number): bigint
+	getStatus(target?: AudioOutputStatus): AudioOutputStatus
+	getStats(): AudioOutputStats
+	getResourceUsage(): ResourceUsage
+	getVirtualDeviceStats(): VirtualDeviceStats
+
+	addMarker(frame: number, callback: MarkerCallback): number
+	addMarkerAtTime(time: number, callback: MarkerCallback): number
+	removeMarker(id: number): void
+
+	isPaused: boolean
+	statusBuffer: SharedArrayBuffer | undefined
+	ended: Promise<void>
+	disposed: Promise<void>
+	appendedSampleCount: number
+	queuedSampleCount: number
+	sampleRate: number
+	channelCount: number
+}
+
+export interface AudioClip {
+	seek(frameIndex: number): void
+	seekToTime(time: number): void
+	dispose(): Promise<void>
+	start(options?: StartOptions): void
+	stop(options?: StopOptions): Promise<void>
+	pause(): void
+	resume(): void
+
+	getPlaybackPosition(): PlaybackPosition
+	getMonotonicTimeOfFrame(frame: number): bigint
+	getStatus(target?: AudioOutputStatus): AudioOutputStatus
+	getStats(): AudioOutputStats
+	getResourceUsage(): ResourceUsage
+	getVirtualDeviceStats(): VirtualDeviceStats
+
+	addMarker(frame: number, callback: MarkerCallback): number
+	addMarkerAtTime(time: number, callback: MarkerCallback): number
+	removeMarker(id: number): void
+
+	isPaused: boolean
+	statusBuffer: SharedArrayBuffer | undefined
+	ended: Promise<void>
+	disposed: Promise<void>
+	frameCount: number
+	duration: number
+	sampleRate: number
+	channelCount: number
+}
+
+export interface AudioMixer {
+	addBuffer(samples: Int16Array, options?: MixerSourceOptions): MixerSource
+	addWaveData(waveData: Uint8Array, options?: MixerSourceOptions): MixerSource
+	addStream(options?: MixerSourceOptions): MixerStreamSource
+	addHandler(handler: MixerSourceHandler, options?: MixerSourceOptions): MixerSource
+	setDucking(options: DuckingOptions): void
+	dispose(): Promise<void>
+	start(options?: StartOptions): void
+	stop(options?: StopOptions): Promise<void>
+	flush(): void
+	pause(): void
+	resume(): void
+
+	getPlaybackPosition(): PlaybackPosition
+	getMonotonicTimeOfFrame(frame: number): bigint
+	getStatus(target?: AudioOutputStatus): AudioOutputStatus
+	getStats(): AudioOutputStats
+	getResourceUsage(): ResourceUsage
+	getVirtualDeviceStats(): VirtualDeviceStats
+
+	addMarker(frame: number, callback: MarkerCallback): number
+	addMarkerAtTime(time: number, callback: MarkerCallback): number
+	removeMarker(id: number): void
+
+	isPaused: boolean
+	statusBuffer: SharedArrayBuffer | undefined
+	ended: Promise<void>
+	disposed: Promise<void>
+	ducking: Required<DuckingOptions>
+	sourceCount: number
+	maxSourceCount: number
+	sampleRate: number
+	channelCount: number
+}
+
+export interface AudioMixerConfig extends AudioOutputConfig {
+	// Maximum number of sources playing at the same time. Defaults to 256.
+	maxSourceCount?: number
+
+	// Maximum number of threads mixing sources in parallel, including the output thread, and up to the number of
+	// cores. Only loads of at least 16 sources per thread are split. Defaults to 1.
+	threadCount?: number
+
+	// How sources are ducked while a source of higher priority plays
+	ducking?: DuckingOptions
+}
+
+export interface DuckingOptions {
+	// Time to reach the full depth once a higher priority source starts, in milliseconds. Defaults to 20.
+	attack?: number
+
+	// Time to recover from the full depth once no higher priority source plays, in milliseconds. Defaults to 300.
+	release?: number
+
+	// Attenuation of ducked sources, in decibels. 0 disables ducking. Defaults to -12.
+	depth?: number
+}
+
+export interface MixerSourceOptions {
+	// Sample rate of the source. Sources are resampled to the mixer's sample rate. Defaults to the mixer's sample rate.
+	sampleRate?: number
+
+	// Either 1, or the mixer's channel count. Defaults to the mixer's channel count.
+	channelCount?: number
+
+	// Linear gain. Defaults to 1.
+	gain?: number
+
+	// Position between the left (-1) and right (1) channels of a stereo mixer. Mono sources are panned
+	// with equal power, and stereo sources are balanced. Defaults to 0.
+	pan?: number
+
+	// While a source plays, the sources of lower priority are ducked. Defaults to 0.
+	priority?: number
+}
+
+export interface MixerSource {
+	// Ramps to a new value over the next buffer
+	gain: number
+	pan: number
+
+	priority: number
+
+	// Fades the source out over the next buffer, and resolves once it has been removed
+	remove(): Promise<void>
+
+	id: number
+	isEnded: boolean
+
+	// Resolves when the source has played all of its samples, or was removed, or the mixer has ended
+	ended: Promise<void>
+}
+
+export interface MixerStreamSource extends MixerSource {
+	append(samples: Int16Array): void
+	end(): Promise<void>
+
+	queuedSampleCount: number
+}
+
+// Fills a buffer for a source. Returning false ends the source, without playing the buffer.
+export type MixerSourceHandler = (buffer: Int16Array) => boolean | void
+
 export type AudioOutputHandler = (outputBuffer: Int16Array) => void
 
+export interface PlaybackPosition {
+	// Frame currently playing, in the output's timeline, which includes any silence written to the device.
+	// Interpolated from the device's delay, reported by ALSA, and the time elapsed since it was measured.
+	frame: number
+
+	// Frame of the content currently playing: the frames passed to the handler, the frames appended to a stream,
+	// or the frame within a clip
+	contentFrame: number
+
+	// Time of the content currently playing, in seconds
+	time: number
+
+	// Number of frames written to the device that haven't played yet
+	delay: number
+
+	// Total number of frames written to the device, in the output's timeline
+	framesWritten: number
+
+	// Whether the device is currently playing
+	isRunning: boolean
+
+	// Monotonic time, in nanoseconds, at which the position was computed, on the same clock as `process.hrtime.bigint()`
+	monotonicTime: bigint
+}
+
+export type MarkerCallback = (event: MarkerEvent) => void
+
+export interface MarkerEvent {
+	// Identifier returned by `addMarker`
+	id: number
+
+	// Content frame of the marker
+	frame: number
+
+	// Estimated monotonic time, in nanoseconds, at which the marker frame started playing
+	monotonicTime: bigint
+
+	// Time, in milliseconds, between the marker frame starting to play, and the callback being called
+	latency: number
+}
+
+interface Marker {
+	id: number
+	frame: number
+	callback: MarkerCallback
+}
+
+export interface AudioOutputStats {
+	// Number of buffer underruns
+	underrunCount: number
+
+	// Number of underruns the output successfully recovered from
+	recoveryCount: number
+
+	// Number of underruns the output failed to recover from
+	recoveryFailureCount: number
+
+	// Number of writes made when less than a device period of audio was left queued
+	deadlineMissCount: number
+
+	// Number of periods of silence written while waiting for a late handler, when `concealUnderruns` is set
+	concealedPeriodCount: number
+
+	// Time from requesting a handler call, to the handler being called, in microseconds
+	handlerLatency: HistogramSummary
+
+	// Time spent in the handler, in microseconds
+	handlerDuration: HistogramSummary
+
+	// Time from requesting a handler call, to the output thread resuming after it returned, in microseconds
+	handlerRoundTrip: HistogramSummary
+
+	// Time spent writing to the device, in microseconds
+	writeDuration: HistogramSummary
+
+	// Deviation of the interval between writes, from the duration of the frames written, in microseconds
+	wakeupJitter: HistogramSummary
+
+	// Duration of audio left queued in the device at each write, in microseconds
+	slack: HistogramSummary
+
+	// Frames left queued in the device at each write
+	bufferFill: HistogramSummary
+
+	// Time spent mixing each buffer, when playing through a mixer, in microseconds
+	mixDuration: HistogramSummary
+}
+
+export interface ResourceUsage {
+	// CPU time consumed by the output thread, in milliseconds
+	threadCpuTime: number
+
+	// Context switches of the output thread
+	voluntaryContextSwitchCount: number
+	involuntaryContextSwitchCount: number
+
+	// Bytes of native memory held, including buffers, rings, and native source samples
+	nativeByteCount: number
+}
+
+export interface VirtualDeviceStats {
+	// Frames written to the device, including frames that were later rewound or dropped
+	receivedFrameCount: number
+
+	// Frames stored in the record buffer
+	recordedFrameCount: number
+
+	// Number of times the device was started, initially, and after each recovery
+	startCount: number
+
+	// Injected stalls that have begun
+	stallCount: number
+
+	// Xruns reported at the injected times
+	injectedXrunCount: number
+
+	// Xruns caused by the device buffer running empty
+	underrunCount: number
+}
+
+export interface ProcessResourceUsage extends ResourceUsage {
+	// Number of live outputs included in the totals
+	outputCount: number
+}
+
+export interface NativeObjectCounts {
+	// Native output objects, including those still being initialized, and the references they hold
+	// to handlers and buffers
+	outputCount: number
+
+	// Outputs whose thread was started, and not yet joined
+	liveOutputCount: number
+
+	// Async handles used to call handlers, not yet closed
+	asyncHandleCount: number
+}
+
+export interface RealtimeGuardViolations {
+	// Calls to allocation functions (`malloc`, `calloc`, `realloc`, `posix_memalign`, `aligned_alloc`)
+	allocationCount: number
+
+	// Calls to `free`
+	deallocationCount: number
+
+	// Calls to mutex and read-write lock functions
+	lockCount: number
+}
+
+export interface HistogramSummary {
+	count: number
+	mean: number
+	max: number
+	p50: number
+	p90: number
+	p99: number
+
+	// Bucket 0 counts values of 0, and bucket i counts values in the range [2^(i-1), 2^i)
+	buckets: number[]
+}
+
+export interface AudioTraceEvent {
+	// One of 'wait', 'handlerDispatch', 'handler', 'handlerRoundTrip', 'write', 'underrun', 'recover', 'flush', 'pause', 'resume', 'seek', 'drain' or 'conceal'
+	name: string
+
+	// Operating system identifier of the output thread that recorded the event
+	threadId: number
+
+	// Monotonic time, in nanoseconds, on the same clock as `process.hrtime`
+	startTime: number
+
+	// Duration, in nanoseconds. Undefined for instant events, like 'underrun'
+	duration?: number
+
+	// Event specific argument, like the frame count or result of a write
+	argument: number
+}
+
+export type AudioOutputState = 'notStarted' | 'playing' | 'paused' | 'stopped' | 'ended'
+
+export interface AudioOutputStatus {
+	state: AudioOutputState
+
+	// Total number of frames written to the device, in the output's timeline
+	framesWritten: number
+
+	// Frame playing at `monotonicTime`, in the output's timeline. Not interpolated.
+	playedFrame: number
+
+	// Number of frames written to the device that hadn't played yet, at `monotonicTime`
+	delay: number
+
+	// Frame of the content playing at `monotonicTime`
+	playedContentFrame: number
+
+	// Monotonic time, in nanoseconds, at which the status was measured, on the same clock as `process.hrtime`
+	monotonicTime: number
+
+	// Number of buffer underruns since the output was created
+	underrunCount: number
+
+	deviceSampleRate: number
+}
+
+export interface StartOptions {
+	// Frame index, in the output's timeline, at which playback should begin.
+	// The output's timeline begins at frame 0 when it is started.
+	atFrame?: number
+
+	// Monotonic time, in nanoseconds, at which playback should begin, as returned by `process.hrtime.bigint()`
+	atMonotonicTime?: bigint
+}
+
+export type StopMode = 'drain' | 'drop' | 'fade'
+
+export interface StopOptions {
+	// 'drain': play all audio already queued in the device buffer, then stop (same as `dispose`)
+	// 'drop': discard queued audio immediately
+	// 'fade': discard queued audio after a short fade-out, to avoid an audible click
+	mode?: StopMode
+}
+
+const defaultStopOptions: StopOptions = {
+	mode: 'drain',
+}
+
 export interface AudioOutputConfig {
 	sampleRate: number
 	channelCount: number
 	bufferDuration?: number
+	autoStart?: boolean
+
+	// 'realtime' (the default) plays at the sample rate. 'offline' calls the handler as soon as each buffer
+	// was written, rendering faster than realtime, through an unpaced 'file' backend when `filePath` is given,
+	// or otherwise, to memory (see `getRenderedSamples`). Defaults the buffer duration to 500ms.
+	mode?: AudioOutputMode
+
+	// Device layer to play through. Defaults to 'device'.
+	backend?: AudioOutputBackend
+
+	// For the 'null' and 'file' backends: whether frames are consumed at the sample rate, as measured by
+	// the monotonic clock, like a real device, or as fast as they are produced. Defaults to true.
+	paced?: boolean
+
+	// For the 'file' backend: path of the file to write, and its format. The format defaults to 'wav'.
+	filePath?: string
+	fileFormat?: 'wav' | 'raw'
+
+	// For the 'virtual' backend: configuration of the virtual device
+	virtualDevice?: VirtualDeviceConfig
+
+	// For the 'device' backend: name of the ALSA device to play through, like 'hw:Loopback,0,0'.
+	// Defaults to 'default'.
+	deviceName?: string
+
+	// Latency not reported by the device, in milliseconds, added to the delay used for the playback position,
+	// for example, as measured by `calibrateLoopbackLatency`. Defaults to 0.
+	latencyOffset?: number
+
+	// When the handler is late, and the device is about to run empty, write silence to keep it running, rather than
+	// letting it underrun. The handler's buffer plays after the silence, once it returns. Defaults to false.
+	concealUnderruns?: boolean
+}
+
+export type TestSignalType = 'mls' | 'impulses'
+
+export interface TestSignalOptions {
+	// Peak sample value. Defaults to 16384.
+	amplitude?: number
+
+	// For 'mls': order of the sequence, which has 2^order - 1 samples. Defaults to 14.
+	order?: number
+
+	// For 'impulses': length of the signal, and the interval between impulses, in samples. The interval
+	// defaults to the length, giving a single impulse.
+	length?: number
+	interval?: number
+}
+
+export interface CaptureOptions {
+	deviceName: string
+	sampleRate: number
+	channelCount: number
+	frameCount: number
+}
+
+export interface CaptureResult {
+	// Interleaved samples
+	samples: Int16Array
+
+	// Monotonic time, in nanoseconds, at which the first frame was captured, on the same clock as `process.hrtime`
+	firstFrameTime: bigint
+}
+
+// Virtual sound card, implemented as an ALSA plugin within the process, for testing. Frames are played through
+// the same ALSA code paths used for a real device. Times are in milliseconds, from when the device first started.
+export interface VirtualDeviceConfig {
+	// Defaults to 10ms
+	periodFrameCount?: number
+
+	// Defaults to 4 periods, or 4 times the output's buffer, whichever is larger. Rounded up to whole periods.
+	bufferFrameCount?: number
+
+	// Rate of the device clock relative to the system's monotonic clock. Defaults to 1.
+	clockRate?: number
+
+	// Intervals during which the device stops consuming frames
+	stalls?: { time: number, duration: number }[]
+
+	// Times at which the device reports an xrun, regardless of how many frames are queued
+	xruns?: number[]
+
+	// Receives every frame written to the device, interleaved, in the order written. Should be backed by
+	// a SharedArrayBuffer if read while playing. Frames beyond its length are counted, but not recorded.
+	recordBuffer?: Int16Array
 }
 
+export type AudioOutputMode = 'realtime' | 'offline'
+
+// 'device': the default audio device of the platform
+// 'null': a simulated device, which discards all frames
+// 'file': a simulated device, which writes all frames it plays to a file
+// 'virtual': a virtual sound card, played through ALSA, for testing (Linux only)
+export type AudioOutputBackend = 'device' | 'null' | 'file' | 'virtual'
+
 interface AudioOutputAddon {
-	createAudioOutput(config: AudioOutputConfig, handler: AudioOutputHandler): Promise<NativeAudioOutput>
+	createAudioOutput(config: NativeAudioOutputConfig, handler: AudioOutputHandler, eventHandler?: NativeEventHandler): Promise<NativeAudioOutput>
+
+	// Backends supported in addition to 'device'
+	backends?: AudioOutputBackend[]
+
+	setTracingEnabled?(enabled: boolean): void
+	drainTraceEvents?(): Float64Array
+	getDroppedTraceEventCount?(): number
+	getProcessResourceUsage?(): ProcessResourceUsage
+	getNativeObjectCounts?(): NativeObjectCounts
+	getRealtimeGuardViolations?(): RealtimeGuardViolations | null
+
+	generateTestSignal?(type: TestSignalType, options: TestSignalOptions): Int16Array
+	crossCorrelate?(signal: Int16Array, reference: Int16Array): Float64Array
+	captureAudio?(options: CaptureOptions): Promise<CaptureResult>
+}
+
+interface NativeAudioOutputConfig extends AudioOutputConfig {
+	useStream?: boolean
+	clipSamples?: Int16Array
+	useMixer?: boolean
+	maxMixerSourceCount?: number
+	mixerThreadCount?: number
+	statusBuffer?: Float64Array
 }
 
+type NativeEventHandler = (eventName: string, ...args: any[]) => void
+
 interface NativeAudioOutput {
 	dispose(): void
+	disposed?: Promise<NativeDisposalResult | undefined>
+	start?(atFrame: number, atMonotonicTime: bigint): void
+	stop?(mode: StopMode): void
+	flush?(): void
+	pause?(): void
+	resume?(): void
+
+	append?(samples: Int16Array): void
+	end?(): void
+	getQueuedSampleCount?(): number
+
+	seek?(frameIndex: number): void
+
+	addSource?(samples: Int16Array | null, channelCount: number, sampleRate: number, gain: number, pan: number, priority: number): number
+	appendToSource?(sourceId: number, samples: Int16Array): void
+	endSource?(sourceId: number): void
+	getSourceQueuedSampleCount?(sourceId: number): number
+	setSourceGain?(sourceId: number, gain: number): void
+	setSourcePan?(sourceId: number, pan: number): void
+	setSourcePriority?(sourceId: number, priority: number): void
+	setDucking?(attack: number, release: number, depth: number): void
+	removeSource?(sourceId: number): void
+	getSourceCount?(): number
+
+	getPlaybackPosition?(): NativePlaybackPosition
+
+	setNextMarkerFrame?(frame: number): void
+
+	getStats?(): NativeAudioOutputStats
+	getResourceUsage?(): ResourceUsage
+	getVirtualDeviceStats?(): VirtualDeviceStats
+}
+
+interface NativeDisposalResult {
+	stats: NativeAudioOutputStats
+	resourceUsage: ResourceUsage
+	virtualDevice?: VirtualDeviceStats
+}
+
+interface NativeAudioOutputStats {
+	underrunCount: number
+	recoveryCount: number
+	recoveryFailureCount: number
+	deadlineMissCount: number
+	concealedPeriodCount: number
+
+	handlerLatency: NativeHistogram
+	handlerDuration: NativeHistogram
+	handlerRoundTrip: NativeHistogram
+	writeDuration: NativeHistogram
+	wakeupJitter: NativeHistogram
+	slack: NativeHistogram
+	bufferFill: NativeHistogram
+	mixDuration: NativeHistogram
+}
+
+interface NativeHistogram {
+	count: number
+	sum: number
+	max: number
+	buckets: number[]
+}
+
+interface NativePlaybackPosition {
+	frame: number
+	contentFrame: number
+	framesWritten: number
+	delay: number
+	deviceSampleRate: number
+	isRunning: boolean
+	monotonicTime: bigint
 }
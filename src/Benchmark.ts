@@ -0,0 +1,505 @@
+import { availableParallelism, tmpdir } from 'os'
+import { join } from 'path'
+import { rm } from 'fs/promises'
+import { AudioOutput, AudioOutputBackend, AudioOutputConfig, AudioTraceEvent, createAudioOutput, drainTraceEvents, setTracingEnabled } from './AudioIO.js'
+import { getSineWave } from './AudioUtilities.js'
+
+// Benchmarks an output backend end to end, and writes the results, as JSON, to stdout. Progress is logged to stderr.
+//
+// Usage: node dist/Benchmark.js [backend] [duration]
+//
+// `backend` is 'null' (the default), 'file', 'virtual' or 'device'. `duration` is the length of each
+// measured run, in seconds (defaults to 10).
+//
+// Durations are given in microseconds, as percentiles of all samples collected.
+//
+// Stall mode: node dist/Benchmark.js stalls [backend] [stallInterval] [stallCount]
+//
+// Blocks the event loop, `stallCount` times (defaults to 6), every `stallInterval` milliseconds (defaults to 500),
+// for increasing durations, while an output plays on the 'null' (the default) or 'virtual' backend. For each buffer
+// duration, with and without `concealUnderruns`, reports the underruns and concealed periods caused by each stall
+// duration, and the longest stall survived without either.
+
+const sampleRate = 48000
+const channelCount = 2
+const bufferDuration = 20
+
+// Number of outputs created and disposed to measure time-to-first-frame and dispose latency
+const lifecycleIterationCount = 20
+
+// Highest number of concurrent outputs tried when searching for the maximum sustainable count
+const maxOutputCountLimit = 512
+
+// Number of outputs created and disposed to measure create and dispose throughput
+const throughputOutputCount = 200
+
+// Lifetime of each output, in milliseconds, and duration of each rate tried, in seconds, when searching for the
+// maximum sustainable create rate
+const sustainedOutputLifetime = 200
+const sustainedRateDuration = 2
+const maxCreateRateLimit = 10240
+
+const log = (message: string) => process.stderr.write(`${message}\n`)
+
+// Buffer durations, in milliseconds, and stall durations, in milliseconds, tried in stall mode
+const stallBufferDurations = [10, 20, 50, 100, 200]
+const stallDurations = [2, 5, 10, 15, 20, 30, 40, 50, 75, 100, 150, 200, 300, 400, 500, 750, 1000]
+
+async function runBenchmarks() {
+	if (process.argv[2] === 'stalls') {
+		return runStallBenchmarks()
+	}
+
+	const backend = (process.argv[2] ?? 'null') as AudioOutputBackend
+	const duration = Number(process.argv[3] ?? 10)
+
+	if (!['null', 'file', 'virtual', 'device'].includes(backend)) {
+		throw new Error(`Backend '${backend}' is invalid. It must be 'null', 'file', 'virtual' or 'device'`)
+	}
+
+	if (!(duration > 0)) {
+		throw new Error(`Duration must be a positive number of seconds`)
+	}
+
+	log(`Measuring handler round trip and wakeup jitter, for ${duration}s..`)
+	const timing = await measureTiming(backend, duration)
+
+	log(`Measuring time to first frame and dispose latency, over ${lifecycleIterationCount} outputs..`)
+	const lifecycle = await measureLifecycle(backend)
+
+	log(`Searching for the maximum number of sustainable outputs..`)
+	const capacity = await measureCapacity(backend, Math.min(duration, 5))
+
+	log(`Measuring create and dispose throughput..`)
+	const throughput = await measureLifecycleThroughput(backend)
+
+	const report = {
+		backend,
+		sampleRate,
+		channelCount,
+		bufferDuration,
+		...getEnvironment(),
+
+		...timing,
+		...lifecycle,
+		...capacity,
+		...throughput,
+	}
+
+	process.stdout.write(`${JSON.stringify(report, undefined, 2)}\n`)
+}
+
+async function runStallBenchmarks() {
+	const backend = (process.argv[3] ?? 'null') as AudioOutputBackend
+	const stallInterval = Number(process.argv[4] ?? 500)
+	const stallCount = Number(process.argv[5] ?? 6)
+
+	if (!['null', 'virtual'].includes(backend)) {
+		throw new Error(`Backend '${backend}' is invalid for stall mode. It must be 'null' or 'virtual'`)
+	}
+
+	if (!(stallInterval > 0) || !(Math.floor(stallCount) === stallCount && stallCount > 0)) {
+		throw new Error(`Stall interval must be a positive number of milliseconds, and stall count a positive integer`)
+	}
+
+	const configurations = []
+
+	for (const bufferDuration of stallBufferDurations) {
+		for (const concealUnderruns of [false, true]) {
+			log(`Buffer duration of ${bufferDuration}ms, ${concealUnderruns ? 'with' : 'without'} concealment..`)
+
+			configurations.push(await measureStallResilience(backend, bufferDuration, concealUnderruns, stallInterval, stallCount))
+		}
+	}
+
+	const report = {
+		backend,
+		sampleRate,
+		channelCount,
+		stallInterval,
+		stallCount,
+		...getEnvironment(),
+
+		configurations,
+	}
+
+	process.stdout.write(`${JSON.stringify(report, undefined, 2)}\n`)
+}
+
+// Plays an output while blocking the event loop for increasing durations, until a stall duration causes an underrun
+// or a concealed period. Each stall duration is tried on a new output.
+async function measureStallResilience(backend: AudioOutputBackend, bufferDuration: number, concealUnderruns: boolean, stallInterval: number, stallCount: number) {
+	const stalls = []
+
+	let maxSurvivableStall = 0
+
+	for (const stallDuration of stallDurations) {
+		log(`  ${stallDuration}ms stalls..`)
+
+		const output = await createBenchmarkOutput(backend, 0, { bufferDuration, concealUnderruns })
+
+		// Let playback settle before the first stall
+		await sleep(Math.max(bufferDuration * 4, 100))
+
+		const statsBefore = output.getStats()
+
+		for (let i = 0; i < stallCount; i++) {
+			// Vary the phase of the stall relative to the handler calls
+			await sleep(stallInterval + (Math.random() * bufferDuration))
+
+			blockEventLoop(stallDuration)
+		}
+
+		// Let the effects of the last stall be recorded
+		await sleep(Math.max(bufferDuration * 4, 100))
+
+		const stats = output.getStats()
+
+		await output.stop({ mode: 'drop' })
+
+		const underrunCount = stats.underrunCount - statsBefore.underrunCount
+		const concealedPeriodCount = stats.concealedPeriodCount - statsBefore.concealedPeriodCount
+
+		stalls.push({ stallDuration, underrunCount, concealedPeriodCount })
+
+		if (underrunCount > 0 || concealedPeriodCount > 0) {
+			break
+		}
+
+		maxSurvivableStall = stallDuration
+	}
+
+	return {
+		bufferDuration,
+		concealUnderruns,
+		maxSurvivableStall,
+		stalls,
+	}
+}
+
+// Blocks the event loop, like a long garbage collection or synchronous computation would
+function blockEventLoop(duration: number) {
+	const endTime = performance.now() + duration
+
+	while (performance.now() < endTime) {
+	}
+}
+
+function getEnvironment() {
+	return {
+		platform: process.platform,
+		arch: process.arch,
+		nodeVersion: process.version,
+		cpuCount: availableParallelism(),
+		timestamp: new Date().toISOString(),
+	}
+}
+
+// Runs a single output, with tracing enabled, and computes exact percentiles from its trace events
+async function measureTiming(backend: AudioOutputBackend, duration: number) {
+	await setTracingEnabled(true)
+	await drainTraceEvents()
+
+	const events: AudioTraceEvent[] = []
+
+	// The trace ring has a fixed capacity, so it's drained periodically
+	const drainTimer = setInterval(async () => {
+		events.push(...await drainTraceEvents())
+	}, 100)
+
+	const output = await createBenchmarkOutput(backend, 0)
+
+	await sleep(duration * 1000)
+
+	await output.stop({ mode: 'drop' })
+
+	clearInterval(drainTimer)
+
+	events.push(...await drainTraceEvents())
+
+	await setTracingEnabled(false)
+
+	const stats = output.getStats()
+
+	const getDurations = (name: string) => events.filter(event => event.name === name).map(event => event.duration! / 1000)
+
+	// Jitter is the deviation of the interval between the starts of consecutive writes, from the duration of the
+	// frames written on each wakeup
+	const writeStartTimes = events.filter(event => event.name === 'write').map(event => event.startTime)
+	const idealInterval = bufferDuration * 1000
+
+	const wakeupJitter: number[] = []
+
+	for (let i = 1; i < writeStartTimes.length; i++) {
+		wakeupJitter.push(Math.abs(((writeStartTimes[i] - writeStartTimes[i - 1]) / 1000) - idealInterval))
+	}
+
+	return {
+		handlerRoundTrip: summarize(getDurations('handlerRoundTrip')),
+		handlerDispatch: summarize(getDurations('handlerDispatch')),
+		handlerDuration: summarize(getDurations('handler')),
+		writeDuration: summarize(getDurations('write')),
+		wakeupJitter: summarize(wakeupJitter),
+		underrunCount: stats.underrunCount,
+	}
+}
+
+// Measures the time from calling `createAudioOutput` to the end of the first write to the device, and from
+// stopping an output, in drop mode, to it being fully disposed
+async function measureLifecycle(backend: AudioOutputBackend) {
+	const timeToFirstFrame: number[] = []
+	const disposeLatency: number[] = []
+
+	await setTracingEnabled(true)
+
+	for (let i = 0; i < lifecycleIterationCount; i++) {
+		await drainTraceEvents()
+
+		const createTime = process.hrtime.bigint()
+
+		const output = await createBenchmarkOutput(backend, i)
+
+		let firstWriteEndTime: number | undefined
+
+		while (firstWriteEndTime == null) {
+			await sleep(1)
+
+			const firstWrite = (await drainTraceEvents()).find(event => event.name === 'write')
+
+			if (firstWrite) {
+				firstWriteEndTime = firstWrite.startTime + firstWrite.duration!
+			}
+		}
+
+		timeToFirstFrame.push((firstWriteEndTime - Number(createTime)) / 1000)
+
+		const stopTime = process.hrtime.bigint()
+
+		await output.stop({ mode: 'drop' })
+
+		disposeLatency.push(Number(process.hrtime.bigint() - stopTime) / 1000)
+	}
+
+	await setTracingEnabled(false)
+
+	return {
+		timeToFirstFrame: summarize(timeToFirstFrame),
+		disposeLatency: summarize(disposeLatency),
+	}
+}
+
+// Doubles the number of concurrent outputs until one of them underruns, then reports the largest count that
+// didn't, and the number of cores used by the process while running it
+async function measureCapacity(backend: AudioOutputBackend, duration: number) {
+	let sustainedOutputCount = 0
+	let coresUsed = 0
+
+	for (let outputCount = 1; outputCount <= maxOutputCountLimit; outputCount *= 2) {
+		log(`  ${outputCount} outputs..`)
+
+		const outputs: AudioOutput[] = []
+
+		let failed = false
+
+		try {
+			for (let i = 0; i < outputCount; i++) {
+				outputs.push(await createBenchmarkOutput(backend, i))
+			}
+		} catch (e) {
+			// The device may refuse additional streams
+			failed = true
+		}
+
+		const cpuUsageBefore = process.cpuUsage()
+		const startTime = process.hrtime.bigint()
+
+		if (!failed) {
+			await sleep(duration * 1000)
+		}
+
+		const cpuUsage = process.cpuUsage(cpuUsageBefore)
+		const elapsedTime = Number(process.hrtime.bigint() - startTime) / 1000
+
+		const underrunCount = outputs.reduce((count, output) => count + output.getStats().underrunCount, 0)
+
+		await Promise.all(outputs.map(output => output.stop({ mode: 'drop' })))
+
+		if (failed || underrunCount > 0) {
+			break
+		}
+
+		sustainedOutputCount = outputCount
+		coresUsed = (cpuUsage.user + cpuUsage.system) / elapsedTime
+	}
+
+	return {
+		maxSustainedOutputs: {
+			outputCount: sustainedOutputCount,
+			coresUsed,
+			outputsPerCore: coresUsed > 0 ? sustainedOutputCount / coresUsed : 0,
+		}
+	}
+}
+
+// Measures the rate, in outputs per second, at which outputs are created then disposed, one at a time, and created,
+// then disposed, all at once. Then searches for the highest rate at which outputs can be created, each playing for
+// a short time, while creation keeps up, and no output underruns.
+async function measureLifecycleThroughput(backend: AudioOutputBackend) {
+	let startTime = Date.now()
+
+	for (let i = 0; i < throughputOutputCount; i++) {
+		const output = await createBenchmarkOutput(backend, i)
+
+		await output.stop({ mode: 'drop' })
+	}
+
+	const sequentialRate = throughputOutputCount / ((Date.now() - startTime) / 1000)
+
+	startTime = Date.now()
+
+	const outputs = await Promise.all(Array.from({ length: throughputOutputCount }, (_, i) => createBenchmarkOutput(backend, i)))
+
+	const concurrentCreateRate = throughputOutputCount / ((Date.now() - startTime) / 1000)
+
+	startTime = Date.now()
+
+	await Promise.all(outputs.map(output => output.stop({ mode: 'drop' })))
+
+	const concurrentDisposeRate = throughputOutputCount / ((Date.now() - startTime) / 1000)
+
+	let maxSustainedCreateRate = 0
+
+	for (let rate = 10; rate <= maxCreateRateLimit; rate *= 2) {
+		log(`  ${rate} outputs per second..`)
+
+		if (!await isCreateRateSustainable(backend, rate)) {
+			break
+		}
+
+		maxSustainedCreateRate = rate
+	}
+
+	return {
+		lifecycleThroughput: {
+			sequentialRate,
+			concurrentCreateRate,
+			concurrentDisposeRate,
+			maxSustainedCreateRate,
+		}
+	}
+}
+
+// Creates outputs at the given rate, each stopped after playing for `sustainedOutputLifetime`. The rate is
+// sustainable if every output was created, within one lifetime of its scheduled time, and none underran.
+async function isCreateRateSustainable(backend: AudioOutputBackend, rate: number) {
+	const scheduledCount = Math.round(rate * sustainedRateDuration)
+	const startTime = performance.now()
+
+	const stopPromises: Promise<boolean>[] = []
+
+	let sustained = true
+
+	for (let i = 0; i < scheduledCount; i++) {
+		const scheduledTime = startTime + ((i / rate) * 1000)
+		const currentTime = performance.now()
+
+		if (currentTime - scheduledTime > sustainedOutputLifetime) {
+			sustained = false
+
+			break
+		}
+
+		if (scheduledTime > currentTime) {
+			await sleep(scheduledTime - currentTime)
+		}
+
+		let output: AudioOutput
+
+		try {
+			output = await createBenchmarkOutput(backend, i)
+		} catch (e) {
+			sustained = false
+
+			break
+		}
+
+		stopPromises.push(sleep(sustainedOutputLifetime).then(async () => {
+			const underrunCount = output.getStats().underrunCount
+
+			await output.stop({ mode: 'drop' })
+
+			return underrunCount === 0
+		}))
+	}
+
+	const results = await Promise.all(stopPromises)
+
+	return sustained && results.every(result => result)
+}
+
+// Creates an output playing a sine wave, on the given backend
+async function createBenchmarkOutput(backend: AudioOutputBackend, index: number, extraConfig?: Partial<AudioOutputConfig>) {
+	const sineWave = getSineWave(440, sampleRate, sampleRate)
+
+	let frameOffset = 0
+
+	const config: AudioOutputConfig = { sampleRate, channelCount, bufferDuration, backend, ...extraConfig }
+
+	let filePath: string | undefined
+
+	if (backend === 'file') {
+		filePath = join(tmpdir(), `audio-io-benchmark-${process.pid}-${index}.wav`)
+		config.filePath = filePath
+	}
+
+	const output = await createAudioOutput(config, (buffer) => {
+		for (let i = 0; i < buffer.length; i += channelCount) {
+			const sample = sineWave[frameOffset % sineWave.length] * 32767
+
+			buffer[i] = sample
+			buffer[i + 1] = sample
+
+			frameOffset += 1
+		}
+	})
+
+	if (filePath) {
+		output.disposed.then(() => rm(filePath!, { force: true }))
+	}
+
+	return output
+}
+
+function summarize(values: number[]) {
+	const sortedValues = [...values].sort((a, b) => a - b)
+
+	const getPercentile = (percentile: number) => {
+		if (sortedValues.length === 0) {
+			return 0
+		}
+
+		const rank = Math.ceil((percentile / 100) * sortedValues.length)
+
+		return sortedValues[Math.max(rank - 1, 0)]
+	}
+
+	return {
+		count: sortedValues.length,
+		mean: sortedValues.length > 0 ? sortedValues.reduce((sum, value) => sum + value, 0) / sortedValues.length : 0,
+		p50: getPercentile(50),
+		p90: getPercentile(90),
+		p99: getPercentile(99),
+		p999: getPercentile(99.9),
+		max: sortedValues.length > 0 ? sortedValues[sortedValues.length - 1] : 0,
+	}
+}
+
+function sleep(milliseconds: number) {
+	return new Promise<void>(resolve => setTimeout(resolve, milliseconds))
+}
+
+runBenchmarks().catch((e) => {
+	log(`${e}`)
+
+	process.exitCode = 1
+})
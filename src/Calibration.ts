@@ -0,0 +1,191 @@
+import { captureAudio, createAudioClip, crossCorrelate, generateTestSignal, PlaybackPosition, TestSignalType } from './AudioIO.js'
+
+// Measures the round-trip latency of an output, by playing a known signal, capturing it back through a loopback
+// (the ALSA `snd-aloop` card, or a cable from an output to an input), and finding it in the capture by
+// cross-correlation.
+//
+// The latency is measured from the time the output reports each burst of the signal as playing, to the time
+// it was captured, so it's the error of the output's position reporting, plus the latency of the capture path.
+// With `snd-aloop`, or when the capture path's latency is negligible, it can be passed to an output as
+// `latencyOffset`.
+export async function calibrateLoopbackLatency(userOptions?: LoopbackCalibrationOptions): Promise<LoopbackCalibrationResult> {
+	const options = { ...defaultLoopbackCalibrationOptions, ...userOptions }
+
+	const { sampleRate, channelCount, burstCount } = options
+
+	const burst = options.signal === 'mls' ?
+		await generateTestSignal('mls', { order: options.mlsOrder, amplitude: options.amplitude }) :
+		await generateTestSignal('impulses', { length: 1, amplitude: options.amplitude })
+
+	// Silence before the first burst, and between bursts, so each correlation peak is isolated
+	const leadInFrameCount = Math.round(sampleRate * 0.25)
+	const burstStride = burst.length + Math.round(sampleRate * 0.25)
+
+	const clipFrameCount = leadInFrameCount + (burstCount * burstStride)
+	const clipSamples = new Int16Array(clipFrameCount * channelCount)
+
+	for (let burstIndex = 0; burstIndex < burstCount; burstIndex++) {
+		const burstStartFrame = leadInFrameCount + (burstIndex * burstStride)
+
+		for (let i = 0; i < burst.length; i++) {
+			for (let channel = 0; channel < channelCount; channel++) {
+				clipSamples[((burstStartFrame + i) * channelCount) + channel] = burst[i]
+			}
+		}
+	}
+
+	// Capture for the duration of the clip, plus enough time for the latency, starting before playback
+	const captureFrameCount = clipFrameCount + Math.round(sampleRate * 1.0)
+
+	const capturePromise = captureAudio({ deviceName: options.captureDevice, sampleRate, channelCount, frameCount: captureFrameCount })
+
+	const clip = await createAudioClip(clipSamples, { sampleRate, channelCount, bufferDuration: 20, deviceName: options.playbackDevice })
+
+	// Take the playback position once the device is running. From then on, content frames play at
+	// the sample rate, so the time of each burst can be derived from it.
+	let position: PlaybackPosition = clip.getPlaybackPosition()
+
+	const positionDeadline = Date.now() + 2000
+
+	while (!(position.isRunning && position.contentFrame > 0)) {
+		if (Date.now() > positionDeadline) {
+			await clip.stop({ mode: 'drop' })
+
+			throw new Error(`Playback through '${options.playbackDevice}' didn't start`)
+		}
+
+		await sleep(5)
+
+		position = clip.getPlaybackPosition()
+	}
+
+	await clip.ended
+
+	const capture = await capturePromise
+
+	// Correlate the first channel with a single burst
+	const capturedChannel = new Int16Array(captureFrameCount)
+
+	for (let i = 0; i < captureFrameCount; i++) {
+		capturedChannel[i] = capture.samples[i * channelCount]
+	}
+
+	const correlation = await crossCorrelate(capturedChannel, burst)
+
+	let maxCorrelation = 0
+	let sumOfSquares = 0
+
+	for (let i = 0; i < correlation.length; i++) {
+		maxCorrelation = Math.max(maxCorrelation, correlation[i])
+		sumOfSquares += correlation[i] ** 2
+	}
+
+	const correlationRms = Math.sqrt(sumOfSquares / correlation.length)
+
+	if (maxCorrelation === 0 || maxCorrelation < correlationRms * minimumPeakToRmsRatio) {
+		throw new Error(`The signal wasn't found in the capture. Check that '${options.playbackDevice}' is looped back to '${options.captureDevice}'`)
+	}
+
+	// The first burst is the first peak reaching half the maximum, and the next ones are searched for
+	// near their expected offset from it
+	let firstPeakIndex = correlation.findIndex(value => value >= maxCorrelation * 0.5)
+
+	const latencies: number[] = []
+	const peakToRmsRatios: number[] = []
+
+	for (let burstIndex = 0; burstIndex < burstCount; burstIndex++) {
+		const expectedPeakIndex = firstPeakIndex + (burstIndex * burstStride)
+		const searchRadius = Math.floor(burstStride / 4)
+
+		let peakIndex = -1
+
+		for (let i = Math.max(expectedPeakIndex - searchRadius, 0); i <= Math.min(expectedPeakIndex + searchRadius, correlation.length - 1); i++) {
+			if (peakIndex < 0 || correlation[i] > correlation[peakIndex]) {
+				peakIndex = i
+			}
+		}
+
+		if (peakIndex < 0) {
+			break
+		}
+
+		if (burstIndex === 0) {
+			firstPeakIndex = peakIndex
+		}
+
+		// Time the output reported the burst as playing, and the time it was captured
+		const burstContentFrame = leadInFrameCount + (burstIndex * burstStride)
+		const reportedTime = Number(position.monotonicTime) + (((burstContentFrame - position.contentFrame) / sampleRate) * 1e9)
+		const capturedTime = Number(capture.firstFrameTime) + ((peakIndex / sampleRate) * 1e9)
+
+		latencies.push((capturedTime - reportedTime) / 1e6)
+		peakToRmsRatios.push(correlation[peakIndex] / correlationRms)
+	}
+
+	const sortedLatencies = [...latencies].sort((a, b) => a - b)
+	const latency = sortedLatencies[Math.floor(sortedLatencies.length / 2)]
+
+	return {
+		latency,
+		latencyFrameCount: Math.round((latency / 1000) * sampleRate),
+		measurements: latencies,
+		spread: sortedLatencies[sortedLatencies.length - 1] - sortedLatencies[0],
+		peakToRmsRatio: Math.min(...peakToRmsRatios),
+	}
+}
+
+// Minimum ratio of the highest correlation to its RMS, for the signal to be considered found
+const minimumPeakToRmsRatio = 8
+
+export interface LoopbackCalibrationOptions {
+	// ALSA device the signal is played through, and the device it's captured back from.
+	// Default to the two ends of the first `snd-aloop` substream.
+	playbackDevice?: string
+	captureDevice?: string
+
+	sampleRate?: number
+	channelCount?: number
+
+	// 'mls' (the default) plays maximum length sequences, which are robust to noise. 'impulses' plays single
+	// sample impulses, which only suit a clean, digital loopback.
+	signal?: TestSignalType
+
+	// Order of the MLS. Defaults to 14 (16383 samples).
+	mlsOrder?: number
+
+	// Peak sample value. Defaults to 16384.
+	amplitude?: number
+
+	// Number of bursts played. The reported latency is their median. Defaults to 5.
+	burstCount?: number
+}
+
+export interface LoopbackCalibrationResult {
+	// Median latency, in milliseconds, and in frames
+	latency: number
+	latencyFrameCount: number
+
+	// Latency measured for each burst, in milliseconds
+	measurements: number[]
+
+	// Difference between the highest and lowest measurement, in milliseconds
+	spread: number
+
+	// Lowest ratio of a burst's correlation peak to the correlation's RMS. Higher is more reliable.
+	peakToRmsRatio: number
+}
+
+const defaultLoopbackCalibrationOptions: Required<LoopbackCalibrationOptions> = {
+	playbackDevice: 'hw:Loopback,0,0',
+	captureDevice: 'hw:Loopback,1,0',
+	sampleRate: 48000,
+	channelCount: 2,
+	signal: 'mls',
+	mlsOrder: 14,
+	amplitude: 16384,
+	burstCount: 5,
+}
+
+function sleep(milliseconds: number) {
+	return new Promise<void>(resolve => setTimeout(resolve, milliseconds))
+}
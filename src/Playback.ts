@@ -95,11 +95,11 @@ export async function playInt16Samples(
 			})
 		}
 
+		// Resolve once the remaining audio has been heard, and the output disposed
 		if (samplesToOutput.length < sampleCount) {
 			ended = true
 
-			audioOutput.dispose()
-			openPromise.resolve()
+			audioOutput.dispose().then(() => openPromise.resolve(), (e) => openPromise.reject(e))
 		}
 
 		offset += sampleCount
@@ -124,6 +124,25 @@ export async function playInt16Samples(
 	return openPromise.promise
 }
 
+export async function createAudioClipFromWaveData(waveData: Uint8Array, options?: PlaybackOptions) {
+	options = { ...defaultPlaybackOptions, ...options }
+
+	const { audioChannels, sampleRate } = decodeWaveToFloat32Channels(waveData)
+
+	const channelCount = audioChannels.length
+
+	const sampleBuffer = float32ChannelsToBuffer(audioChannels, 16)
+	const int16Samples = new Int16Array(sampleBuffer.buffer, sampleBuffer.byteOffset, sampleBuffer.length / 2)
+
+	const AudioIO = await import('./AudioIO.js')
+
+	return AudioIO.createAudioClip(int16Samples, {
+		sampleRate,
+		channelCount,
+		bufferDuration: options.bufferDuration,
+	})
+}
+
 export type PositionCallback = (playbackData: PositionCallbackData) => void
 
 export type PositionCallbackData = {
@@ -0,0 +1,189 @@
+import { availableParallelism } from 'os'
+import { pathToFileURL } from 'url'
+import { Worker } from 'worker_threads'
+import { AudioOutputConfig } from './AudioIO.js'
+import { OpenPromise } from './OpenPromise.js'
+
+// Renders offline outputs in worker threads, so their handlers run in parallel, on separate cores.
+//
+// Handlers can't be passed to a worker, so each job names a module, which the worker imports. The module must
+// export a `createRenderHandler(args, control)` function, returning the handler for the job. The handler calls
+// `control.end()` once it has filled its final buffer.
+export class RenderPool {
+	private readonly concurrency: number
+
+	private readonly idleWorkers: Worker[] = []
+	private workerCount = 0
+
+	private readonly pendingJobs: PendingRenderJob[] = []
+	private readonly activeJobs = new Map<Worker, PendingRenderJob>()
+
+	private isDisposed = false
+
+	constructor(options?: RenderPoolOptions) {
+		const concurrency = options?.concurrency ?? availableParallelism()
+
+		if (typeof concurrency !== 'number' || Math.floor(concurrency) !== concurrency || concurrency < 1) {
+			throw new Error(`Concurrency of ${concurrency} is invalid. It must be a positive integer`)
+		}
+
+		this.concurrency = concurrency
+	}
+
+	// Renders the job once a worker is available. Resolves when its output has been disposed.
+	render(job: RenderJob): Promise<RenderResult> {
+		if (this.isDisposed) {
+			throw new Error(`Can't render with a disposed render pool`)
+		}
+
+		if (typeof job.module !== 'string' && !(job.module instanceof URL)) {
+			throw new Error(`A render job must name the module creating its handler, as a path or a URL`)
+		}
+
+		const pendingJob: PendingRenderJob = { job, openPromise: new OpenPromise<RenderResult>() }
+
+		this.pendingJobs.push(pendingJob)
+		this.startPendingJobs()
+
+		return pendingJob.openPromise.promise
+	}
+
+	// Terminates all workers. Jobs that haven't completed are rejected.
+	async dispose() {
+		this.isDisposed = true
+
+		for (const pendingJob of this.pendingJobs) {
+			pendingJob.openPromise.reject(new Error(`Render pool was disposed`))
+		}
+
+		this.pendingJobs.length = 0
+
+		const workers = [...this.idleWorkers, ...this.activeJobs.keys()]
+
+		for (const pendingJob of this.activeJobs.values()) {
+			pendingJob.openPromise.reject(new Error(`Render pool was disposed`))
+		}
+
+		this.idleWorkers.length = 0
+		this.activeJobs.clear()
+
+		await Promise.all(workers.map(worker => worker.terminate()))
+	}
+
+	get activeJobCount() { return this.activeJobs.size }
+	get pendingJobCount() { return this.pendingJobs.length }
+
+	private startPendingJobs() {
+		while (this.pendingJobs.length > 0) {
+			let worker = this.idleWorkers.pop()
+
+			if (!worker) {
+				if (this.workerCount >= this.concurrency) {
+					return
+				}
+
+				worker = this.createWorker()
+			}
+
+			const pendingJob = this.pendingJobs.shift()!
+			const { module, args, config } = pendingJob.job
+
+			const moduleUrl = module instanceof URL || /^[a-z]+:/i.test(module) ? module.toString() : pathToFileURL(module).href
+
+			this.activeJobs.set(worker, pendingJob)
+
+			worker.postMessage({ moduleUrl, args, config } as RenderWorkerRequest)
+		}
+	}
+
+	private createWorker() {
+		const worker = new Worker(new URL('./RenderWorker.js', import.meta.url))
+
+		this.workerCount += 1
+
+		worker.on('message', (response: RenderWorkerResponse) => {
+			const pendingJob = this.activeJobs.get(worker)
+
+			this.activeJobs.delete(worker)
+
+			if (pendingJob) {
+				if (response.error != null) {
+					pendingJob.openPromise.reject(new Error(response.error))
+				} else {
+					pendingJob.openPromise.resolve(response.result!)
+				}
+			}
+
+			if (!this.isDisposed) {
+				this.idleWorkers.push(worker)
+				this.startPendingJobs()
+			}
+		})
+
+		// A worker that failed outside of a job (for example, while loading) is replaced on the next job
+		worker.on('error', (error) => {
+			const pendingJob = this.activeJobs.get(worker)
+
+			this.activeJobs.delete(worker)
+			this.workerCount -= 1
+
+			pendingJob?.openPromise.reject(error)
+
+			if (!this.isDisposed) {
+				this.startPendingJobs()
+			}
+		})
+
+		return worker
+	}
+}
+
+export interface RenderPoolOptions {
+	// Maximum number of jobs rendered at the same time, each in its own worker. Defaults to the number of cores.
+	concurrency?: number
+}
+
+export interface RenderJob {
+	// Path or URL of the module exporting `createRenderHandler`
+	module: string | URL
+
+	// Passed to `createRenderHandler`. Must be transferable to a worker by structured cloning.
+	args?: any
+
+	// Configuration of the output. The mode is always 'offline'. When `filePath` is given, the output is written
+	// to that file. Otherwise, the rendered samples are returned.
+	config: AudioOutputConfig
+}
+
+export interface RenderResult {
+	// Rendered samples, when no file path was given
+	samples?: Int16Array
+
+	// Number of frames rendered
+	frameCount: number
+
+	// Time taken to render, in milliseconds, including creating and disposing the output
+	renderTime: number
+}
+
+// Passed to `createRenderHandler`
+export interface RenderControl {
+	// Ends the render, once all buffers filled so far were written
+	end(): void
+}
+
+interface PendingRenderJob {
+	job: RenderJob
+	openPromise: OpenPromise<RenderResult>
+}
+
+export interface RenderWorkerRequest {
+	moduleUrl: string
+	args?: any
+	config: AudioOutputConfig
+}
+
+export interface RenderWorkerResponse {
+	result?: RenderResult
+	error?: string
+}
@@ -0,0 +1,59 @@
+import { parentPort } from 'worker_threads'
+import { AudioOutput, createAudioOutput } from './AudioIO.js'
+import { RenderControl, RenderWorkerRequest, RenderWorkerResponse } from './RenderPool.js'
+
+// Worker of a `RenderPool`. Renders one job at a time, and responds with its result.
+parentPort!.on('message', async (request: RenderWorkerRequest) => {
+	try {
+		const startTime = performance.now()
+
+		const handlerModule = await import(request.moduleUrl)
+
+		if (typeof handlerModule.createRenderHandler !== 'function') {
+			throw new Error(`Module '${request.moduleUrl}' doesn't export a 'createRenderHandler' function`)
+		}
+
+		let output: AudioOutput | undefined
+		let endRequested = false
+
+		const control: RenderControl = {
+			end() {
+				if (!endRequested) {
+					endRequested = true
+
+					output?.stop()
+				}
+			}
+		}
+
+		const handler = handlerModule.createRenderHandler(request.args, control)
+
+		let renderedSampleCount = 0
+
+		output = await createAudioOutput({ ...request.config, mode: 'offline' }, (buffer) => {
+			handler(buffer)
+
+			renderedSampleCount += buffer.length
+		})
+
+		// The handler may have ended the render before the output was returned
+		if (endRequested) {
+			output.stop()
+		}
+
+		await output.disposed
+
+		const samples = request.config.filePath == null ? output.getRenderedSamples() : undefined
+		const frameCount = renderedSampleCount / request.config.channelCount
+
+		const response: RenderWorkerResponse = {
+			result: { samples, frameCount, renderTime: performance.now() - startTime }
+		}
+
+		parentPort!.postMessage(response, samples ? [samples.buffer as ArrayBuffer] : [])
+	} catch (e: any) {
+		const response: RenderWorkerResponse = { error: e?.message ?? String(e) }
+
+		parentPort!.postMessage(response)
+	}
+})
@@ -1,4 +1,9 @@
 import { playTestTone, playWaveData } from './Playback.js'
+import { AudioOutput, AudioOutputBackend, AudioOutputStatusReader, createAudioClip, createAudioMixer, createAudioOutput, createAudioStream, crossCorrelate, drainTraceEvents, generateTestSignal, getNativeObjectCounts, getRealtimeGuardViolations, MarkerEvent, RealtimeGuardViolations, setTracingEnabled } from './AudioIO.js'
+import { getSineWave } from './AudioUtilities.js'
+import { RenderPool } from './RenderPool.js'
+import { calibrateLoopbackLatency } from './Calibration.js'
+import { createRenderHandler, TestRenderJobArgs } from './TestRenderJob.js'
 
 const log = console.log
 
@@ -33,4 +38,1188 @@ async function testAllWaveFiles() {
 	}
 }
 
-testAllWaveFiles()
+// Plays through each kind of output, on the null backend, with markers and tracing enabled, and checks that
+// no output thread allocated or locked within its realtime section.
+//
+// Must be run with the realtime guard library preloaded: `npm run test-realtime-guard`
+async function testRealtimeGuard() {
+	const initialViolations = await getRealtimeGuardViolations()
+
+	if (!initialViolations) {
+		log(`Realtime guard library isn't preloaded. Build it with 'npm run build-realtime-guard-linux' in 'addons', then run 'npm run test-realtime-guard'.`)
+
+		process.exitCode = 1
+
+		return
+	}
+
+	const sampleRate = 48000
+	const channelCount = 2
+	const duration = 2
+
+	const sineWave = getSineWave(440, sampleRate * duration, sampleRate)
+	const samples = new Int16Array(sineWave.length * channelCount)
+
+	for (let i = 0; i < sineWave.length; i++) {
+		samples[i * channelCount] = sineWave[i] * 32767
+		samples[(i * channelCount) + 1] = sineWave[i] * 32767
+	}
+
+	const addMarkers = (output: { addMarker(frame: number, callback: () => void): number }) => {
+		for (let frame = 0; frame < sampleRate * duration; frame += sampleRate / 4) {
+			output.addMarker(frame, () => {})
+		}
+	}
+
+	let failed = false
+
+	const runTest = async (name: string, play: () => Promise<void>) => {
+		const before = (await getRealtimeGuardViolations())!
+
+		await play()
+
+		const after = (await getRealtimeGuardViolations())!
+		const violations = subtractViolations(after, before)
+
+		const passed = violations.allocationCount === 0 && violations.deallocationCount === 0 && violations.lockCount === 0
+
+		log(`${passed ? 'PASS' : 'FAIL'} ${name}: ${violations.allocationCount} allocations, ${violations.deallocationCount} deallocations, ${violations.lockCount} locks`)
+
+		if (!passed) {
+			failed = true
+		}
+	}
+
+	await setTracingEnabled(true)
+
+	await runTest('handler', async () => {
+		let offset = 0
+
+		const output = await createAudioOutput({ sampleRate, channelCount, bufferDuration: 20, backend: 'null' }, (buffer) => {
+			const remaining = Math.min(buffer.length, samples.length - offset)
+
+			buffer.set(samples.subarray(offset, offset + remaining))
+			offset += remaining
+		})
+
+		addMarkers(output)
+
+		await new Promise(resolve => setTimeout(resolve, duration * 1000))
+
+		await output.dispose()
+	})
+
+	await runTest('stream', async () => {
+		const stream = await createAudioStream({ sampleRate, channelCount, bufferDuration: 20, backend: 'null' })
+
+		addMarkers(stream)
+
+		// Append in chunks while playing, so nodes are freed by the JavaScript thread during playback
+		const chunkSampleCount = (sampleRate / 10) * channelCount
+
+		for (let offset = 0; offset < samples.length; offset += chunkSampleCount) {
+			stream.append(samples.subarray(offset, offset + chunkSampleCount))
+
+			await new Promise(resolve => setTimeout(resolve, 50))
+		}
+
+		await stream.end()
+		await stream.disposed
+	})
+
+	await runTest('clip', async () => {
+		const clip = await createAudioClip(samples, { sampleRate, channelCount, bufferDuration: 20, backend: 'null' })
+
+		addMarkers(clip)
+
+		await clip.ended
+		await clip.disposed
+	})
+
+	await setTracingEnabled(false)
+	await drainTraceEvents()
+
+	if (failed) {
+		process.exitCode = 1
+	}
+}
+
+// Renders a tone through the handler, on the unpaced file backend, and checks the resulting WAV file
+// holds all frames the handler produced
+async function testFileBackend() {
+	const { readFile, rm } = await import('fs/promises')
+	const { tmpdir } = await import('os')
+	const { join } = await import('path')
+
+	const sampleRate = 48000
+	const channelCount = 2
+	const frameCount = sampleRate * 60
+
+	const filePath = join(tmpdir(), `audio-io-test-${process.pid}.wav`)
+	const sineWave = getSineWave(440, frameCount, sampleRate)
+
+	let framesProduced = 0
+
+	const startTime = Date.now()
+
+	const output = await createAudioOutput({ sampleRate, channelCount, bufferDuration: 20, backend: 'file', paced: false, filePath }, (buffer) => {
+		const bufferFrameCount = buffer.length / channelCount
+		const framesToProduce = Math.min(bufferFrameCount, frameCount - framesProduced)
+
+		for (let i = 0; i < framesToProduce; i++) {
+			const sample = sineWave[framesProduced + i] * 32767
+
+			buffer[i * channelCount] = sample
+			buffer[(i * channelCount) + 1] = sample
+		}
+
+		framesProduced += bufferFrameCount
+
+		if (framesProduced >= frameCount) {
+			output.stop()
+		}
+	})
+
+	await output.disposed
+
+	const elapsedTime = Date.now() - startTime
+
+	const fileData = await readFile(filePath)
+	const fileFrameCount = (fileData.length - 44) / (channelCount * 2)
+
+	await rm(filePath)
+
+	const passed = fileFrameCount === framesProduced
+
+	log(`${passed ? 'PASS' : 'FAIL'} file backend: rendered ${frameCount / sampleRate}s in ${elapsedTime}ms, ${fileFrameCount} frames in file, ${framesProduced} frames produced`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Lets a stream run out of samples, and checks that once its content has played, the silence written after it
+// doesn't hold back the reported content frame
+async function testStreamUnderflowPosition() {
+	const sampleRate = 48000
+	const channelCount = 2
+	const frameCount = sampleRate / 5
+
+	const stream = await createAudioStream({ sampleRate, channelCount, bufferDuration: 20, backend: 'null' })
+
+	stream.append(new Int16Array(frameCount * channelCount).fill(1000))
+
+	await new Promise(resolve => setTimeout(resolve, 500))
+
+	const position = stream.getPlaybackPosition()
+
+	await stream.dispose()
+
+	const passed = position.contentFrame === frameCount
+
+	log(`${passed ? 'PASS' : 'FAIL'} stream underflow position: content frame ${position.contentFrame} after ${frameCount} frames played, with ${position.frame - frameCount} frames of silence`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Plays a counter through the paced file backend, flushes it while playing, then stops it in fade mode, and checks
+// the file: the flushed frames were faded out and discarded, the counter then continued, and the output ended with
+// a fade-out to silence, rather than a hard cut
+async function testFlushAndFadeStop() {
+	const { readFile, rm } = await import('fs/promises')
+	const { tmpdir } = await import('os')
+	const { join } = await import('path')
+
+	const sampleRate = 48000
+	const channelCount = 2
+
+	const filePath = join(tmpdir(), `audio-io-flush-test-${process.pid}.wav`)
+
+	let handlerFrameOffset = 0
+
+	const output = await createAudioOutput({ sampleRate, channelCount, bufferDuration: 100, backend: 'file', filePath }, (buffer) => {
+		fillCounter(buffer, handlerFrameOffset, channelCount)
+
+		handlerFrameOffset += buffer.length / channelCount
+	})
+
+	await sleep(500)
+
+	output.flush()
+
+	await sleep(500)
+
+	await output.stop({ mode: 'fade' })
+
+	const fileData = await readFile(filePath)
+	const samples = new Int16Array(fileData.buffer, fileData.byteOffset + 44, (fileData.length - 44) / 2)
+
+	await rm(filePath)
+
+	const frameCount = samples.length / channelCount
+	const leftAt = (frame: number) => samples[frame * channelCount]
+
+	// The counter plays from the start, until the flush
+	let flushFrame = 0
+
+	while (flushFrame < frameCount && leftAt(flushFrame) === getCounterSample(flushFrame)) {
+		flushFrame++
+	}
+
+	// The first of the flushed frames are faded out, then the counter continues after the discarded frames
+	const isFadedOut = (startFrame: number, firstCounterFrame: number) => {
+		for (let i = 0; i < addonFadeFrameCount; i++) {
+			if (Math.abs(leftAt(startFrame + i) - getFadeOutSample(getCounterSample(firstCounterFrame + i), i)) > 1) {
+				return false
+			}
+		}
+
+		return leftAt(startFrame + addonFadeFrameCount - 1) === 0
+	}
+
+	const flushFadedOut = isFadedOut(flushFrame, flushFrame)
+
+	// Frames flushed after those faded out
+	const resumeFrame = flushFrame + addonFadeFrameCount
+	const discardedFrameCount = (leftAt(resumeFrame) - getCounterSample(resumeFrame) + counterPeriod) % counterPeriod
+
+	// The counter continues until the final fade-out
+	const finalFadeFrame = frameCount - addonFadeFrameCount
+
+	let continuedFrame = resumeFrame
+
+	while (continuedFrame < finalFadeFrame && leftAt(continuedFrame) === getCounterSample(continuedFrame + discardedFrameCount)) {
+		continuedFrame++
+	}
+
+	const finalFadedOut = isFadedOut(finalFadeFrame, finalFadeFrame + discardedFrameCount)
+
+	const passed =
+		flushFrame > 0 && flushFrame < finalFadeFrame &&
+		flushFadedOut &&
+		discardedFrameCount > 0 &&
+		continuedFrame === finalFadeFrame &&
+		finalFadedOut
+
+	log(`${passed ? 'PASS' : 'FAIL'} flush and fade stop: flushed at frame ${flushFrame} (${flushFadedOut ? 'faded out' : 'not faded out'}), ${discardedFrameCount} frames discarded, counter continued until frame ${continuedFrame} of ${finalFadeFrame}, ${finalFadedOut ? 'faded out' : 'not faded out'} when stopped`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Pauses a handler output on the paced null backend, and checks that its position holds while paused, then continues
+// from the same frame once resumed, without an underrun
+async function testPauseResume() {
+	const sampleRate = 48000
+	const channelCount = 2
+	const tolerance = sampleRate / 20 // 50ms, for timer and scheduling delays
+
+	const output = await createAudioOutput({ sampleRate, channelCount, bufferDuration: 50, backend: 'null', paced: true }, () => {})
+
+	await sleep(300)
+
+	output.pause()
+
+	// Let the output thread handle the request
+	await sleep(50)
+
+	const pausedPosition = output.getPlaybackPosition()
+	const pausedState = output.getStatus().state
+
+	await sleep(300)
+
+	const laterPausedPosition = output.getPlaybackPosition()
+
+	output.resume()
+
+	await sleep(300)
+
+	const resumedPosition = output.getPlaybackPosition()
+	const resumedState = output.getStatus().state
+
+	// Once resumed, the position advances from the paused frame, by the time elapsed since
+	const expectedAdvance = (Number(resumedPosition.monotonicTime - laterPausedPosition.monotonicTime) / 1e9) * sampleRate
+	const advance = resumedPosition.frame - pausedPosition.frame
+
+	await output.dispose()
+
+	const underrunCount = output.getStats().underrunCount
+
+	const passed =
+		pausedPosition.frame > 0 &&
+		!pausedPosition.isRunning &&
+		laterPausedPosition.frame === pausedPosition.frame &&
+		laterPausedPosition.contentFrame === pausedPosition.contentFrame &&
+		pausedState === 'paused' &&
+		resumedPosition.isRunning &&
+		resumedState === 'playing' &&
+		advance <= expectedAdvance && advance >= expectedAdvance - tolerance &&
+		resumedPosition.contentFrame - pausedPosition.contentFrame === advance &&
+		underrunCount === 0
+
+	log(`${passed ? 'PASS' : 'FAIL'} pause and resume: paused at frame ${pausedPosition.frame} (state '${pausedState}'), at frame ${laterPausedPosition.frame} 300ms later, advanced ${advance} frames in the ${Math.round(expectedAdvance)} frames since resuming (state '${resumedState}'), ${underrunCount} underruns`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Seeks a clip of a counter, played through the file backend, and checks that the frames written after the seek are
+// exactly the clip's frames from the seek target on, once the crossfade to them has ended. Seeks once before starting,
+// on the unpaced backend, so the clip fades in from silence, and once while playing, on the paced backend, so the
+// queued frames are rewound, and crossfaded from.
+async function testSeek() {
+	const { tmpdir } = await import('os')
+	const { join } = await import('path')
+
+	const sampleRate = 48000
+	const channelCount = 2
+	const clipFrameCount = sampleRate * 2
+	const seekFrame = 30011
+
+	const filePath = join(tmpdir(), `audio-io-seek-test-${process.pid}.wav`)
+
+	const clipSamples = new Int16Array(clipFrameCount * channelCount)
+
+	fillCounter(clipSamples, 0, channelCount)
+
+	const testSeekWhile = async (name: string, paced: boolean) => {
+		const clip = await createAudioClip(clipSamples, { sampleRate, channelCount, bufferDuration: 100, backend: 'file', filePath, paced, autoStart: false })
+
+		if (paced) {
+			clip.start()
+
+			await sleep(300)
+
+			clip.seek(seekFrame)
+		} else {
+			clip.seek(seekFrame)
+			clip.start()
+		}
+
+		await clip.ended
+		await clip.disposed
+
+		const samples = await readAndRemoveWaveFile(filePath)
+		const frameCount = samples.length / channelCount
+		const leftAt = (frame: number) => samples[frame * channelCount]
+		const rightAt = (frame: number) => samples[(frame * channelCount) + 1]
+
+		// The clip plays from the start, until the seek
+		let seekStartFrame = 0
+
+		while (seekStartFrame < frameCount && leftAt(seekStartFrame) === getCounterSample(seekStartFrame)) {
+			seekStartFrame++
+		}
+
+		// The frames that were queued, or silence if none were, are crossfaded to the frames at the seek target
+		let crossfadeMatches = true
+
+		for (let i = 0; i < addonFadeFrameCount; i++) {
+			const fadingOut = paced ? getCounterSample(seekStartFrame + i) : 0
+			const fadingIn = getCounterSample(seekFrame + i)
+
+			if (Math.abs(leftAt(seekStartFrame + i) - getCrossfadeSample(fadingOut, fadingIn, i)) > 1) {
+				crossfadeMatches = false
+			}
+		}
+
+		// Then the clip continues exactly from the end of the crossfade
+		const continueFrame = seekStartFrame + addonFadeFrameCount
+
+		let mismatchFrame = -1
+
+		for (let frame = continueFrame; frame < frameCount; frame++) {
+			const expected = getCounterSample(seekFrame + (frame - seekStartFrame))
+
+			if (leftAt(frame) !== expected || rightAt(frame) !== -expected) {
+				mismatchFrame = frame
+
+				break
+			}
+		}
+
+		const expectedFrameCount = seekStartFrame + (clipFrameCount - seekFrame)
+
+		const passed =
+			(paced ? seekStartFrame > 0 : seekStartFrame === 0) &&
+			crossfadeMatches &&
+			mismatchFrame === -1 &&
+			frameCount === expectedFrameCount
+
+		log(`${passed ? 'PASS' : 'FAIL'} seek ${name}: seeked at frame ${seekStartFrame}, crossfade ${crossfadeMatches ? 'matches' : `doesn't match`}, ${mismatchFrame === -1 ? 'all frames after it match the clip' : `mismatch at frame ${mismatchFrame}`}, ${frameCount} frames written (expected ${expectedFrameCount})`)
+
+		if (!passed) {
+			process.exitCode = 1
+		}
+	}
+
+	await testSeekWhile('before starting', false)
+	await testSeekWhile('while playing', true)
+}
+
+// Starts a clip of a counter at a later frame, through the unpaced file backend, and checks that silence is written
+// until exactly that frame, followed by exactly the clip's frames.
+async function testScheduledStart() {
+	const { tmpdir } = await import('os')
+	const { join } = await import('path')
+
+	const sampleRate = 48000
+	const channelCount = 2
+	const clipFrameCount = sampleRate / 2
+	const startFrame = 12345
+
+	const filePath = join(tmpdir(), `audio-io-scheduled-start-test-${process.pid}.wav`)
+
+	const clipSamples = new Int16Array(clipFrameCount * channelCount)
+
+	fillCounter(clipSamples, 0, channelCount)
+
+	const clip = await createAudioClip(clipSamples, { sampleRate, channelCount, backend: 'file', filePath, paced: false, autoStart: false })
+
+	clip.start({ atFrame: startFrame })
+
+	await clip.ended
+	await clip.disposed
+
+	const samples = await readAndRemoveWaveFile(filePath)
+	const frameCount = samples.length / channelCount
+
+	let firstNonSilentFrame = 0
+
+	while (firstNonSilentFrame < frameCount && samples[firstNonSilentFrame * channelCount] === 0 && samples[(firstNonSilentFrame * channelCount) + 1] === 0) {
+		firstNonSilentFrame++
+	}
+
+	let mismatchFrame = -1
+
+	for (let frame = startFrame; frame < frameCount; frame++) {
+		const expected = getCounterSample(frame - startFrame)
+
+		if (samples[frame * channelCount] !== expected || samples[(frame * channelCount) + 1] !== -expected) {
+			mismatchFrame = frame
+
+			break
+		}
+	}
+
+	const expectedFrameCount = startFrame + clipFrameCount
+
+	const passed = firstNonSilentFrame === startFrame && mismatchFrame === -1 && frameCount === expectedFrameCount
+
+	log(`${passed ? 'PASS' : 'FAIL'} scheduled start: silent until frame ${firstNonSilentFrame} (expected ${startFrame}), ${mismatchFrame === -1 ? 'all frames after it match the clip' : `mismatch at frame ${mismatchFrame}`}, ${frameCount} frames written (expected ${expectedFrameCount})`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Polls the status a clip publishes to its shared buffer while it plays through the paced null backend, and checks that
+// the frames never go back, the played frame never passes the written frames, and the state only moves forward, from
+// not started to playing to ended. Once disposed, the final status must match the clip's length and its stats.
+async function testStatus() {
+	const sampleRate = 48000
+	const channelCount = 2
+	const clipFrameCount = sampleRate
+
+	const clipSamples = new Int16Array(clipFrameCount * channelCount)
+
+	fillCounter(clipSamples, 0, channelCount)
+
+	const clip = await createAudioClip(clipSamples, { sampleRate, channelCount, bufferDuration: 50, backend: 'null', autoStart: false })
+
+	const statusReader = new AudioOutputStatusReader(clip.statusBuffer!)
+	const stateOrder = ['notStarted', 'playing', 'ended']
+
+	const observedStates: string[] = []
+	const problems: string[] = []
+
+	let previousStatus = statusReader.read()
+
+	const checkStatus = () => {
+		const status = statusReader.read()
+
+		if (observedStates[observedStates.length - 1] !== status.state) {
+			observedStates.push(status.state)
+		}
+
+		if (status.framesWritten < previousStatus.framesWritten || status.playedFrame < previousStatus.playedFrame) {
+			problems.push(`frames went back from ${previousStatus.playedFrame}/${previousStatus.framesWritten} to ${status.playedFrame}/${status.framesWritten}`)
+		}
+
+		if (status.playedFrame < 0 || status.playedFrame > status.framesWritten) {
+			problems.push(`played frame ${status.playedFrame} is outside of [0, ${status.framesWritten}]`)
+		}
+
+		if (status.state !== 'notStarted' && status.deviceSampleRate !== sampleRate) {
+			problems.push(`device sample rate is ${status.deviceSampleRate}`)
+		}
+
+		previousStatus = status
+	}
+
+	let isEnded = false
+
+	clip.ended.then(() => { isEnded = true })
+
+	checkStatus()
+
+	clip.start()
+
+	while (!isEnded) {
+		checkStatus()
+
+		await sleep(5)
+	}
+
+	await clip.disposed
+
+	checkStatus()
+
+	const stateIndexes = observedStates.map(state => stateOrder.indexOf(state))
+
+	if (stateIndexes.some((stateIndex, i) => stateIndex < 0 || (i > 0 && stateIndex <= stateIndexes[i - 1])) || !observedStates.includes('playing')) {
+		problems.push(`states went ${observedStates.join(' -> ')}`)
+	}
+
+	const finalStatus = statusReader.read()
+	const underrunCount = clip.getStats().underrunCount
+
+	if (finalStatus.state !== 'ended' ||
+		finalStatus.framesWritten !== clipFrameCount ||
+		finalStatus.playedFrame !== clipFrameCount ||
+		finalStatus.playedContentFrame !== clipFrameCount ||
+		finalStatus.delay !== 0 ||
+		finalStatus.underrunCount !== underrunCount) {
+		problems.push(`final status is ${finalStatus.state}, ${finalStatus.playedFrame}/${finalStatus.framesWritten} frames played, content frame ${finalStatus.playedContentFrame}, delay ${finalStatus.delay}, ${finalStatus.underrunCount} underruns (expected ended, ${clipFrameCount} frames, ${underrunCount} underruns)`)
+	}
+
+	const passed = problems.length === 0
+
+	log(`${passed ? 'PASS' : 'FAIL'} status: states went ${observedStates.join(' -> ')}${passed ? '' : `, ${problems.slice(0, 5).join(', ')}`}`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Adds markers, out of order, to a handler output playing through the paced null backend, and checks that each one
+// is called exactly once, in frame order, after the playback position has reached its frame. A marker beyond the
+// frames played before stopping must not be called.
+async function testMarkers() {
+	const sampleRate = 48000
+	const channelCount = 2
+
+	let handlerFrameOffset = 0
+
+	const output = await createAudioOutput({ sampleRate, channelCount, bufferDuration: 50, backend: 'null' }, (buffer) => {
+		fillCounter(buffer, handlerFrameOffset, channelCount)
+
+		handlerFrameOffset += buffer.length / channelCount
+	})
+
+	const markerFrames = [24000, 4800, 43210, 100, 12000, 36000, 4801, 30000]
+	const lateMarkerFrame = sampleRate * 10
+
+	const expectedMarkers: { id: number, frame: number }[] = []
+	const calledMarkers: { id: number, frame: number, contentFrame: number }[] = []
+
+	const onMarker = (event: MarkerEvent) => {
+		calledMarkers.push({ id: event.id, frame: event.frame, contentFrame: output.getPlaybackPosition().contentFrame })
+	}
+
+	for (const frame of markerFrames) {
+		expectedMarkers.push({ id: output.addMarker(frame, onMarker), frame })
+	}
+
+	const lateMarkerId = output.addMarker(lateMarkerFrame, onMarker)
+
+	expectedMarkers.sort((a, b) => a.frame - b.frame)
+
+	await sleep(1500)
+
+	const calledMarkersWhilePlaying = calledMarkers.slice()
+
+	await output.dispose()
+
+	const calledInOrder =
+		calledMarkersWhilePlaying.length === expectedMarkers.length &&
+		expectedMarkers.every((marker, i) => calledMarkersWhilePlaying[i].id === marker.id && calledMarkersWhilePlaying[i].frame === marker.frame)
+
+	const calledLate = calledMarkersWhilePlaying.filter(marker => marker.contentFrame < marker.frame)
+	const lateMarkerCalled = calledMarkers.some(marker => marker.id === lateMarkerId)
+
+	// No marker may be called again, or at all, once disposed
+	const passed = calledInOrder && calledLate.length === 0 && !lateMarkerCalled && calledMarkers.length === expectedMarkers.length
+
+	log(`${passed ? 'PASS' : 'FAIL'} markers: called at frames ${calledMarkersWhilePlaying.map(marker => `${marker.frame} (position ${marker.contentFrame})`).join(', ')}, expected ${expectedMarkers.map(marker => marker.frame).join(', ')}${lateMarkerCalled ? `, marker at frame ${lateMarkerFrame} was called` : ''}`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Plays a counter through the virtual device, with an injected xrun, a device stall, and a handler stall longer than
+// the device buffer, and checks that the output recovered, and that the device received every frame once, in order
+async function testVirtualDevice() {
+	const sampleRate = 48000
+	const channelCount = 1
+	const frameCount = sampleRate * 2
+
+	const recordBuffer = new Int16Array(new SharedArrayBuffer(sampleRate * 4 * channelCount * 2))
+
+	let framesProduced = 0
+	let handlerStalled = false
+
+	const output = await createAudioOutput({
+		sampleRate,
+		channelCount,
+		bufferDuration: 20,
+		backend: 'virtual',
+		virtualDevice: {
+			periodFrameCount: 480,
+			bufferFrameCount: 480 * 8,
+			xruns: [500],
+			stalls: [{ time: 1000, duration: 200 }],
+			recordBuffer,
+		}
+	}, (buffer) => {
+		// Each frame holds its index, wrapped to the range [1, 32767], so silence can be told apart
+		for (let i = 0; i < buffer.length; i++) {
+			buffer[i] = ((framesProduced + i) % 32767) + 1
+		}
+
+		framesProduced += buffer.length
+
+		// Block the handler for longer than the device buffer, causing an underrun
+		if (!handlerStalled && framesProduced >= sampleRate * 1.5) {
+			handlerStalled = true
+
+			const stallEndTime = Date.now() + 200
+
+			while (Date.now() < stallEndTime) { }
+		}
+
+		if (framesProduced >= frameCount) {
+			output.stop()
+		}
+	})
+
+	await output.disposed
+
+	const stats = output.getStats()
+	const deviceStats = output.getVirtualDeviceStats()
+
+	// Silence may be written while recovering, but content frames must be contiguous
+	let expectedValue = 1
+	let discontinuityCount = 0
+
+	for (let i = 0; i < deviceStats.recordedFrameCount; i++) {
+		const value = recordBuffer[i]
+
+		if (value === 0) {
+			continue
+		}
+
+		if (value !== expectedValue) {
+			discontinuityCount += 1
+		}
+
+		expectedValue = (value % 32767) + 1
+	}
+
+	const passed =
+		deviceStats.injectedXrunCount === 1 &&
+		deviceStats.stallCount === 1 &&
+		deviceStats.underrunCount >= 1 &&
+		stats.underrunCount >= 2 &&
+		stats.recoveryFailureCount === 0 &&
+		discontinuityCount === 0
+
+	log(`${passed ? 'PASS' : 'FAIL'} virtual device: ${deviceStats.injectedXrunCount} injected xruns, ${deviceStats.underrunCount} underruns, ${deviceStats.startCount} starts, ${stats.underrunCount} underruns seen by the output, ${stats.recoveryCount} recoveries, ${deviceStats.recordedFrameCount} frames recorded, ${discontinuityCount} discontinuities`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Renders 10 minutes offline, in-process, to memory, then several jobs in parallel with a render pool
+async function testOfflineRender() {
+	const sampleRate = 48000
+	const channelCount = 2
+	const duration = 10 * 60
+
+	const args: TestRenderJobArgs = { frequency: 440, duration, sampleRate, channelCount }
+
+	{
+		const startTime = Date.now()
+
+		let output: AudioOutput | undefined
+		let endRequested = false
+
+		const handler = createRenderHandler(args, { end() { endRequested = true; output?.stop() } })
+
+		output = await createAudioOutput({ sampleRate, channelCount, mode: 'offline' }, handler)
+
+		if (endRequested) {
+			output.stop()
+		}
+
+		await output.disposed
+
+		const elapsedTime = Date.now() - startTime
+		const renderedFrameCount = output.getRenderedSamples().length / channelCount
+
+		const passed = renderedFrameCount >= duration * sampleRate
+
+		log(`${passed ? 'PASS' : 'FAIL'} offline render: rendered ${duration}s in ${elapsedTime}ms, ${renderedFrameCount} frames`)
+
+		if (!passed) {
+			process.exitCode = 1
+		}
+	}
+
+	{
+		const jobCount = 8
+		const pool = new RenderPool({ concurrency: 4 })
+
+		const startTime = Date.now()
+
+		const results = await Promise.all(Array.from({ length: jobCount }, (_, i) => pool.render({
+			module: new URL('./TestRenderJob.js', import.meta.url),
+			args: { ...args, frequency: 220 * (i + 1) },
+			config: { sampleRate, channelCount },
+		})))
+
+		const elapsedTime = Date.now() - startTime
+
+		await pool.dispose()
+
+		const passed = results.every(result => result.samples != null && result.samples.length === result.frameCount * channelCount && result.frameCount >= duration * sampleRate)
+
+		log(`${passed ? 'PASS' : 'FAIL'} render pool: rendered ${jobCount} jobs of ${duration}s in ${elapsedTime}ms, with a concurrency of 4`)
+
+		if (!passed) {
+			process.exitCode = 1
+		}
+	}
+
+	// A render to a file that can't be written (every write to `/dev/full` fails with ENOSPC) is rejected,
+	// rather than ending as if it had completed
+	{
+		const pool = new RenderPool({ concurrency: 1 })
+
+		let error: any
+
+		try {
+			await pool.render({
+				module: new URL('./TestRenderJob.js', import.meta.url),
+				args: { ...args, duration: 1 },
+				config: { sampleRate, channelCount, filePath: '/dev/full', fileFormat: 'raw' },
+			})
+		} catch (e) {
+			error = e
+		}
+
+		await pool.dispose()
+
+		const passed = error != null
+
+		log(`${passed ? 'PASS' : 'FAIL'} render pool: a render to a full disk was ${passed ? `rejected (${error.message})` : 'resolved'}`)
+
+		if (!passed) {
+			process.exitCode = 1
+		}
+	}
+}
+
+// Checks that an MLS is found at a known offset by cross-correlation, then measures the latency of the
+// `snd-aloop` loopback. Requires `sudo modprobe snd-aloop`.
+async function testLatencyCalibration() {
+	const sequence = await generateTestSignal('mls', { order: 12 })
+	const offset = 1234
+
+	const signal = new Int16Array(sequence.length * 3)
+	signal.set(sequence, offset)
+
+	const correlation = await crossCorrelate(signal, sequence)
+
+	let peakIndex = 0
+
+	for (let i = 1; i < correlation.length; i++) {
+		if (correlation[i] > correlation[peakIndex]) {
+			peakIndex = i
+		}
+	}
+
+	const passed = peakIndex === offset
+
+	log(`${passed ? 'PASS' : 'FAIL'} cross-correlation: found the sequence at offset ${peakIndex}, expected ${offset}`)
+
+	if (!passed) {
+		process.exitCode = 1
+
+		return
+	}
+
+	try {
+		const result = await calibrateLoopbackLatency()
+
+		log(`PASS loopback calibration: ${JSON.stringify(result, undefined, 2)}`)
+	} catch (e) {
+		log(`FAIL loopback calibration: ${e}`)
+
+		process.exitCode = 1
+	}
+}
+
+// Creates and disposes thousands of outputs, sequentially and concurrently, on the null and virtual backends, stopping
+// them at different points of their lifecycle. Then checks that every native output, async handle, thread and file
+// descriptor was released.
+async function testCreateDisposeStress() {
+	const { readdirSync } = await import('fs')
+
+	const sampleRate = 48000
+	const channelCount = 2
+
+	const getThreadCount = () => readdirSync('/proc/self/task').length
+	const getFileDescriptorCount = () => readdirSync('/proc/self/fd').length
+
+	const stopModes = ['drop', 'drain', 'fade'] as const
+
+	// Stops the output right away, after its first handler call, or after a few, in drop, drain or fade mode,
+	// sometimes flushing it first
+	const createAndDispose = async (backend: AudioOutputBackend, index: number) => {
+		let handlerCallCount = 0
+
+		const output = await createAudioOutput({ sampleRate, channelCount, bufferDuration: 10, backend }, () => {
+			handlerCallCount += 1
+		})
+
+		const stopAfterCallCount = index % 3
+
+		while (handlerCallCount < stopAfterCallCount) {
+			await sleep(2)
+		}
+
+		if (index % 5 === 4) {
+			output.flush()
+		}
+
+		await output.stop({ mode: stopModes[Math.floor(index / 3) % 3] })
+		await output.disposed
+	}
+
+	// Disposes a mixer with a pool of mixing threads right after creating it, possibly before its threads
+	// have started, or after a few buffers
+	const createAndDisposeMixer = async (backend: AudioOutputBackend, index: number) => {
+		const mixer = await createAudioMixer({ sampleRate, channelCount, bufferDuration: 10, backend, threadCount: 4 })
+
+		if (index % 2 === 1) {
+			mixer.addBuffer(new Int16Array(480 * channelCount))
+
+			await sleep(index % 20)
+		}
+
+		await mixer.dispose()
+		await mixer.disposed
+	}
+
+	// Warm up, so lazily created threads and descriptors are included in the baseline
+	await createAndDispose('null', 0)
+	await createAndDispose('virtual', 0)
+	await sleep(100)
+
+	const threadCountBefore = getThreadCount()
+	const fileDescriptorCountBefore = getFileDescriptorCount()
+
+	const runs = [
+		{ name: 'sequential, null backend', backend: 'null', count: 2000, concurrency: 1 },
+		{ name: 'concurrent, null backend', backend: 'null', count: 2000, concurrency: 100 },
+		{ name: 'sequential, virtual backend', backend: 'virtual', count: 500, concurrency: 1 },
+		{ name: 'concurrent, virtual backend', backend: 'virtual', count: 500, concurrency: 50 },
+		{ name: 'sequential, mixers with 4 threads', backend: 'null', count: 500, concurrency: 1, isMixer: true },
+		{ name: 'concurrent, mixers with 4 threads', backend: 'null', count: 500, concurrency: 50, isMixer: true },
+	] as const
+
+	for (const run of runs) {
+		const startTime = Date.now()
+
+		for (let i = 0; i < run.count; i += run.concurrency) {
+			const createAndDisposeOutput = 'isMixer' in run ? createAndDisposeMixer : createAndDispose
+			const batch = Array.from({ length: Math.min(run.concurrency, run.count - i) }, (_, j) => createAndDisposeOutput(run.backend, i + j))
+
+			await Promise.all(batch)
+		}
+
+		const elapsedTime = Date.now() - startTime
+
+		log(`${run.name}: created and disposed ${run.count} outputs in ${elapsedTime}ms (${Math.round(run.count / (elapsedTime / 1000))} per second)`)
+	}
+
+	// Let the async handle close callbacks run
+	await sleep(100)
+
+	const counts = await getNativeObjectCounts()
+	const threadCount = getThreadCount()
+	const fileDescriptorCount = getFileDescriptorCount()
+
+	const passed =
+		counts.outputCount === 0 &&
+		counts.liveOutputCount === 0 &&
+		counts.asyncHandleCount === 0 &&
+		threadCount === threadCountBefore &&
+		fileDescriptorCount === fileDescriptorCountBefore
+
+	log(`${passed ? 'PASS' : 'FAIL'} create/dispose stress: ${counts.outputCount} native outputs, ${counts.liveOutputCount} live outputs and ${counts.asyncHandleCount} async handles left, ${threadCount - threadCountBefore} threads and ${fileDescriptorCount - fileDescriptorCountBefore} file descriptors leaked`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Plays hundreds of overlapping sources through a mixer on the null backend, with a mix of sample rates, channel counts,
+// streams, handlers and removals, and checks that every source ended, and that the output never underran.
+// Runs on the output thread alone, then with parallel mixing.
+async function testMixer() {
+	for (const threadCount of [1, 4]) {
+		await testMixerWithThreadCount(threadCount)
+	}
+}
+
+async function testMixerWithThreadCount(threadCount: number) {
+	const sampleRate = 48000
+	const channelCount = 2
+	const sourceCount = 600
+	const maxSourceCount = 256
+
+	const mixer = await createAudioMixer({ sampleRate, channelCount, bufferDuration: 20, backend: 'null', maxSourceCount, threadCount })
+
+	const sourceSampleRates = [48000, 44100, 22050, 16000]
+	const endedPromises: Promise<void>[] = []
+
+	let maxConcurrentSourceCount = 0
+	let rejectedCount = 0
+
+	const startTime = Date.now()
+
+	for (let i = 0; i < sourceCount; i++) {
+		const sourceSampleRate = sourceSampleRates[i % sourceSampleRates.length]
+		const sourceChannelCount = i % 2 === 0 ? 1 : channelCount
+		const frameCount = Math.round(sourceSampleRate * (0.2 + ((i % 7) * 0.05)))
+
+		const samples = new Int16Array(frameCount * sourceChannelCount)
+		const sineWave = getSineWave(200 + (i % 50) * 20, frameCount, sourceSampleRate)
+
+		for (let j = 0; j < samples.length; j++) {
+			samples[j] = sineWave[Math.floor(j / sourceChannelCount)] * 100
+		}
+
+		const options = { sampleRate: sourceSampleRate, channelCount: sourceChannelCount, gain: 0.5, pan: ((i % 9) / 4) - 1 }
+
+		try {
+			if (i % 5 === 0) {
+				const stream = mixer.addStream(options)
+
+				stream.append(samples)
+				stream.end()
+
+				endedPromises.push(stream.ended)
+			} else if (i % 5 === 1) {
+				let offset = 0
+
+				const source = mixer.addHandler((buffer) => {
+					if (offset >= samples.length) {
+						return false
+					}
+
+					buffer.set(samples.subarray(offset, offset + buffer.length))
+					offset += buffer.length
+				}, options)
+
+				endedPromises.push(source.ended)
+			} else {
+				const source = mixer.addBuffer(samples, options)
+
+				if (i % 5 === 2) {
+					source.gain = 0.25
+					setTimeout(() => source.remove(), 50)
+				}
+
+				endedPromises.push(source.ended)
+			}
+		} catch {
+			rejectedCount += 1
+		}
+
+		maxConcurrentSourceCount = Math.max(maxConcurrentSourceCount, mixer.sourceCount)
+
+		// Add sources in bursts, a few milliseconds apart
+		if (i % 20 === 19) {
+			await sleep(5)
+		}
+	}
+
+	await Promise.all(endedPromises)
+
+	const elapsedTime = Date.now() - startTime
+	const remainingSourceCount = mixer.sourceCount
+	const stats = mixer.getStats()
+
+	await mixer.dispose()
+
+	const passed =
+		remainingSourceCount === 0 &&
+		maxConcurrentSourceCount <= maxSourceCount &&
+		stats.underrunCount === 0
+
+	log(`${passed ? 'PASS' : 'FAIL'} mixer (${threadCount} threads): ${endedPromises.length} sources ended in ${elapsedTime}ms (${rejectedCount} rejected over the maximum), up to ${maxConcurrentSourceCount} at a time, ${remainingSourceCount} left, ${stats.underrunCount} underruns, mix time ${stats.mixDuration.p99}us (p99)`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Plays a constant background source, panned left, and a higher priority alert over it, panned right, through a mixer
+// on the file backend, and checks that the background was ducked to the full depth within one buffer of the
+// alert starting, and recovered after it ended
+async function testMixerDucking() {
+	const { readFile, rm } = await import('fs/promises')
+	const { tmpdir } = await import('os')
+	const { join } = await import('path')
+
+	const sampleRate = 48000
+	const channelCount = 2
+	const bufferDuration = 20
+	const bufferFrameCount = (bufferDuration / 1000) * sampleRate
+	const ducking = { attack: 20, release: 100, depth: -12 }
+
+	const filePath = join(tmpdir(), `audio-io-ducking-test-${process.pid}.wav`)
+
+	const mixer = await createAudioMixer({ sampleRate, channelCount, bufferDuration, backend: 'file', filePath, ducking })
+
+	const background = mixer.addBuffer(new Int16Array(sampleRate * 2).fill(10000), { channelCount: 1, pan: -1 })
+
+	await sleep(500)
+
+	const alert = mixer.addBuffer(new Int16Array(sampleRate / 2).fill(10000), { channelCount: 1, pan: 1, priority: 1 })
+
+	await alert.ended
+	await background.ended
+	await mixer.stop()
+	await mixer.disposed
+
+	const fileData = await readFile(filePath)
+	const samples = new Int16Array(fileData.buffer, fileData.byteOffset + 44, (fileData.length - 44) / 2)
+
+	await rm(filePath)
+
+	const frameCount = samples.length / channelCount
+	const leftAt = (frame: number) => samples[frame * channelCount]
+	const rightAt = (frame: number) => samples[(frame * channelCount) + 1]
+
+	let alertStartFrame = 0
+	let alertEndFrame = 0
+
+	for (let i = 0; i < frameCount; i++) {
+		if (rightAt(i) !== 0) {
+			alertStartFrame = alertStartFrame || i
+			alertEndFrame = i + 1
+		}
+	}
+
+	const duckedLevel = 10000 * (10 ** (ducking.depth / 20))
+	const levelAfterOneBuffer = leftAt(alertStartFrame + bufferFrameCount)
+	const levelAfterRelease = leftAt(alertEndFrame + (((ducking.release / 1000) * sampleRate) + (bufferFrameCount * 2)))
+
+	const passed =
+		alertStartFrame > 0 &&
+		Math.abs(levelAfterOneBuffer - duckedLevel) < duckedLevel * 0.02 &&
+		levelAfterRelease === 10000
+
+	log(`${passed ? 'PASS' : 'FAIL'} mixer ducking: background level ${leftAt(alertStartFrame - 1)} before the alert, ${levelAfterOneBuffer} one buffer after it started (expected ${Math.round(duckedLevel)}), ${levelAfterRelease} after the release`)
+
+	if (!passed) {
+		process.exitCode = 1
+	}
+}
+
+// Length of the fades the addon writes when flushing, stopping in fade mode, or seeking, at 48000 Hz
+const addonFadeFrameCount = 480
+
+// A counter that never plays 0, so it can be told apart from silence. Channels after the first are negated.
+const counterPeriod = 32767
+
+function getCounterSample(frame: number) {
+	return 1 + (frame % counterPeriod)
+}
+
+function fillCounter(buffer: Int16Array, startFrame: number, channelCount: number) {
+	for (let i = 0; i < buffer.length / channelCount; i++) {
+		const sample = getCounterSample(startFrame + i)
+
+		buffer[i * channelCount] = sample
+
+		for (let channel = 1; channel < channelCount; channel++) {
+			buffer[(i * channelCount) + channel] = -sample
+		}
+	}
+}
+
+// Sample `index` of a crossfade of the addon, as computed by `CrossfadeInt16`. It computes in single precision,
+// so the result may differ by 1 if the compiler fuses the multiplies and add.
+function getCrossfadeSample(fadingOut: number, fadingIn: number, index: number) {
+	const gain = (index + 1) / addonFadeFrameCount
+
+	return Math.trunc((fadingOut * (1 - gain)) + (fadingIn * gain))
+}
+
+function getFadeOutSample(sample: number, index: number) {
+	return getCrossfadeSample(sample, 0, index)
+}
+
+// Reads the samples of a 16-bit WAV file written by the file backend, then removes it
+async function readAndRemoveWaveFile(filePath: string) {
+	const { readFile, rm } = await import('fs/promises')
+
+	const fileData = await readFile(filePath)
+
+	await rm(filePath)
+
+	return new Int16Array(fileData.buffer, fileData.byteOffset + 44, (fileData.length - 44) / 2)
+}
+
+function sleep(milliseconds: number) {
+	return new Promise<void>(resolve => setTimeout(resolve, milliseconds))
+}
+
+function subtractViolations(a: RealtimeGuardViolations, b: RealtimeGuardViolations): RealtimeGuardViolations {
+	return {
+		allocationCount: a.allocationCount - b.allocationCount,
+		deallocationCount: a.deallocationCount - b.deallocationCount,
+		lockCount: a.lockCount - b.lockCount,
+	}
+}
+
+if (process.argv[2] === 'realtime-guard') {
+	testRealtimeGuard()
+} else if (process.argv[2] === 'file-backend') {
+	testFileBackend().then(testStreamUnderflowPosition)
+} else if (process.argv[2] === 'virtual-device') {
+	testVirtualDevice()
+} else if (process.argv[2] === 'offline') {
+	testOfflineRender()
+} else if (process.argv[2] === 'stress') {
+	testCreateDisposeStress()
+} else if (process.argv[2] === 'controls') {
+	testFlushAndFadeStop().then(testPauseResume).then(testSeek).then(testScheduledStart).then(testStatus).then(testMarkers)
+} else if (process.argv[2] === 'mixer') {
+	testMixer().then(testMixerDucking)
+} else if (process.argv[2] === 'latency-calibration') {
+	testLatencyCalibration()
+} else {
+	testAllWaveFiles()
+}
@@ -0,0 +1,37 @@
+import { AudioOutputHandler } from './AudioIO.js'
+import { RenderControl } from './RenderPool.js'
+import { getSineWave } from './AudioUtilities.js'
+
+// Render job used by the offline test: a sine wave of the given frequency and duration, on all channels
+export function createRenderHandler(args: TestRenderJobArgs, control: RenderControl): AudioOutputHandler {
+	const frameCount = Math.floor(args.duration * args.sampleRate)
+	const sineWave = getSineWave(args.frequency, frameCount, args.sampleRate)
+
+	let framesProduced = 0
+
+	return (buffer) => {
+		const bufferFrameCount = buffer.length / args.channelCount
+		const framesToProduce = Math.min(bufferFrameCount, frameCount - framesProduced)
+
+		for (let i = 0; i < framesToProduce; i++) {
+			const sample = sineWave[framesProduced + i] * 32767
+
+			for (let channel = 0; channel < args.channelCount; channel++) {
+				buffer[(i * args.channelCount) + channel] = sample
+			}
+		}
+
+		framesProduced += bufferFrameCount
+
+		if (framesProduced >= frameCount) {
+			control.end()
+		}
+	}
+}
+
+export interface TestRenderJobArgs {
+	frequency: number
+	duration: number
+	sampleRate: number
+	channelCount: number
+}